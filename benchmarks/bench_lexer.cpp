@@ -0,0 +1,172 @@
+#include "bench_util.hpp"
+#include "json_parser.hpp"
+#include "json_utf8.hpp"
+#include <benchmark/benchmark.h>
+
+/*
+ * Microbenchmarks for the individual stages of the lexer and for the token stack of the parser.
+ * Every benchmark runs a single stage over input which contains only the kind of token that stage
+ * handles, so that a change to one stage shows up in its own numbers.
+ */
+
+struct JSONLexerBench
+{
+    static void rewind(JSONLexer &lexer) { lexer.idx = 0; }
+
+    static bool available(JSONLexer &lexer) { return lexer.available(); }
+
+    static void skip_whitespace(JSONLexer &lexer) { lexer.skip_whitespace(); }
+
+    static void advance(JSONLexer &lexer) { lexer.advance(); }
+
+    static Token lex_string(JSONLexer &lexer) { return lexer.lex_string(); }
+
+    static Token lex_number(JSONLexer &lexer) { return lexer.lex_number(); }
+
+    static Token lex_literal(JSONLexer &lexer) { return lexer.lex_literal(); }
+};
+
+struct JSONParserBench
+{
+    static void load(JSONParser &parser, const std::string &buffer)
+    {
+        parser.lexer.load(buffer);
+        parser.tokens.clear();
+    }
+
+    static Token peek(JSONParser &parser) { return parser.peek(); }
+
+    static Token next(JSONParser &parser) { return parser.next(); }
+};
+
+static void BM_SkipWhitespace(benchmark::State &state)
+{
+    auto input = bench_whitespace(static_cast<size_t>(state.range(0)));
+    JSONLexer lexer(input);
+    for (auto _ : state)
+    {
+        JSONLexerBench::rewind(lexer);
+        JSONLexerBench::skip_whitespace(lexer);
+        benchmark::DoNotOptimize(JSONLexerBench::available(lexer));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_SkipWhitespace)->RangeMultiplier(8)->Range(8, 1 << 15);
+
+// range(0) is the length of the string, range(1) the number of escapes per 100 characters
+static void BM_LexString(benchmark::State &state)
+{
+    auto input = bench_string(static_cast<size_t>(state.range(0)),
+                              static_cast<size_t>(state.range(1)));
+    JSONLexer lexer(input);
+    for (auto _ : state)
+    {
+        JSONLexerBench::rewind(lexer);
+        auto token = JSONLexerBench::lex_string(lexer);
+        benchmark::DoNotOptimize(token);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_LexString)
+    ->ArgsProduct({{16, 256, 4096}, {0, 5, 50}})
+    ->ArgNames({"length", "escapes"});
+
+// Lexes every number of the input, range(0) selects the kind of number
+static void BM_LexNumber(benchmark::State &state)
+{
+    auto kind = static_cast<BenchNumberKind>(state.range(0));
+    auto input = bench_numbers(1024, kind);
+    JSONLexer lexer(input);
+    for (auto _ : state)
+    {
+        JSONLexerBench::rewind(lexer);
+        while (JSONLexerBench::available(lexer))
+        {
+            auto token = JSONLexerBench::lex_number(lexer);
+            benchmark::DoNotOptimize(token);
+            JSONLexerBench::skip_whitespace(lexer);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 1024));
+}
+BENCHMARK(BM_LexNumber)
+    ->Arg(static_cast<int64_t>(BenchNumberKind::INTEGER))
+    ->Arg(static_cast<int64_t>(BenchNumberKind::SHORT_REAL))
+    ->Arg(static_cast<int64_t>(BenchNumberKind::LONG_EXPONENT))
+    ->ArgName("kind");
+
+static void BM_LexLiteral(benchmark::State &state)
+{
+    auto input = bench_literals(1024);
+    JSONLexer lexer(input);
+    for (auto _ : state)
+    {
+        JSONLexerBench::rewind(lexer);
+        while (JSONLexerBench::available(lexer))
+        {
+            auto token = JSONLexerBench::lex_literal(lexer);
+            benchmark::DoNotOptimize(token);
+            // Skip the comma which stopped the literal
+            if (JSONLexerBench::available(lexer))
+                JSONLexerBench::advance(lexer);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 1024));
+}
+BENCHMARK(BM_LexLiteral);
+
+// Validation of a whole input, range(0) is the number of non ASCII characters per 100
+static void BM_ValidateUTF8(benchmark::State &state)
+{
+    auto input = bench_utf8(1 << 20, static_cast<size_t>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(json_validate_utf8(input.data(), input.size()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_ValidateUTF8)->Arg(0)->Arg(1)->Arg(20)->ArgName("non_ascii");
+
+// Complete lexer, including the dispatch between stages done by next()
+static void BM_LexerNext(benchmark::State &state)
+{
+    auto input = bench_records(static_cast<size_t>(state.range(0)));
+    JSONLexer lexer;
+    for (auto _ : state)
+    {
+        lexer.load(input);
+        while (lexer.is_next())
+        {
+            auto token = lexer.next();
+            benchmark::DoNotOptimize(token);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_LexerNext)->Arg(16)->Arg(1024);
+
+// peek() followed by next(), which is how the parser looks ahead for commas and closing brackets.
+// range(0) is the number of peeks per token
+static void BM_ParserPeekNext(benchmark::State &state)
+{
+    auto input = bench_literals(1024);
+    JSONParser parser;
+    for (auto _ : state)
+    {
+        JSONParserBench::load(parser, input);
+        for (int i = 0; i < 2 * 1024 - 1; i++)
+        {
+            for (int64_t j = 0; j < state.range(0); j++)
+            {
+                auto peeked = JSONParserBench::peek(parser);
+                benchmark::DoNotOptimize(peeked);
+            }
+            auto token = JSONParserBench::next(parser);
+            benchmark::DoNotOptimize(token);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (2 * 1024 - 1)));
+}
+BENCHMARK(BM_ParserPeekNext)->Arg(0)->Arg(1)->Arg(2)->ArgName("peeks");
+
+BENCHMARK_MAIN();
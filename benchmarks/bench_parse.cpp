@@ -0,0 +1,407 @@
+#include "bench_util.hpp"
+#include "json_allocations.hpp"
+#include "json_batch.hpp"
+#include "json_bind.hpp"
+#include "json_columns.hpp"
+#include "json_parser.hpp"
+#include "json_path.hpp"
+#include "json_writer.hpp"
+#include <cstring>
+#include <iostream>
+#include <optional>
+
+/*
+ * End to end throughput of the parser over a generated corpus.
+ * For every input, the time to parse, to look up every key of the resulting trees and to destroy
+ * the trees is measured, along with the memory of each phase: the heap allocations made while
+ * parsing and while looking up keys, the heap memory held by the trees and the blocks freed while
+ * destroying them.
+ * The same is measured with deduplication of repeated objects and arrays enabled, and with arrays
+ * of numbers and booleans packed, and the time to only validate each input is measured as well.
+ * For the records, a compiled JSONPath query is run over the text of each document, which parses
+ * only the values it selects, and the scalar fields are read into columns, with one thread and
+ * with four. The small documents are also parsed as one batch by a pool of one thread and of four.
+ * Each measurement is repeated and the fastest run is reported. The results are printed as JSON.
+ *
+ * Allocations are counted with JSONAllocationCounter, which only sees the calling thread, so they
+ * are reported as null for the modes which parse on several threads. A measurement which does not
+ * apply to a mode, such as the memory of the trees for a mode which builds none, is null as well.
+ *
+ * Usage: bench_parse [--scale S] [--iterations N] [--output FILE]
+ */
+
+struct Corpus
+{
+    std::string name;
+    std::vector<std::string> documents;
+};
+
+struct Result
+{
+    size_t bytes = 0;
+    size_t lookups = 0;
+    double parse_seconds = 1e300;
+    double lookup_seconds = 1e300;
+    double destroy_seconds = 1e300;
+
+    // Memory of the last run, when the buffers which the parser keeps have reached their size
+    std::optional<uint64_t> parse_allocations;
+    std::optional<uint64_t> parse_allocated_bytes;
+    std::optional<uint64_t> lookup_allocated_bytes;
+    // Heap memory held by the trees, as JSONObject::memory_usage() counts it
+    std::optional<uint64_t> tree_bytes;
+    std::optional<uint64_t> destroy_releases;
+};
+
+// Sums the heap memory held by trees
+template <typename Trees, typename Get> static uint64_t tree_bytes(const Trees &trees, Get get)
+{
+    uint64_t bytes = 0;
+    for (auto &tree : trees)
+        bytes += get(tree).memory_usage().total();
+    return bytes;
+}
+
+struct BenchRecord
+{
+    int64_t id = 0;
+    std::string name;
+    double price = 0;
+    int64_t quantity = 0;
+    bool active = false;
+    std::vector<std::string> tags;
+    std::map<std::string, std::string> address;
+};
+
+template <> struct json_fields<BenchRecord>
+{
+    static constexpr auto value = std::make_tuple(
+        JSON_FIELD(BenchRecord, id), JSON_FIELD(BenchRecord, name), JSON_FIELD(BenchRecord, price),
+        JSON_FIELD(BenchRecord, quantity), JSON_FIELD(BenchRecord, active),
+        JSON_FIELD(BenchRecord, tags), JSON_FIELD(BenchRecord, address));
+};
+
+// Looks up every key of every object in the tree, returns the number of lookups
+static size_t lookup_all(const JSONObject &ob)
+{
+    size_t lookups = 0;
+    if (ob.type == JSONObjectType::OBJECT)
+    {
+        for (auto &pair : ob.as_kv_pairs())
+        {
+            auto value = ob.find(pair.first);
+            lookups += 1 + lookup_all(*value);
+        }
+    }
+    else if (ob.type == JSONObjectType::ARRAY)
+    {
+        for (auto &element : ob.as_vector())
+            lookups += lookup_all(element);
+    }
+    return lookups;
+}
+
+static Result run_tree(const Corpus &corpus, int iterations, bool deduplicate, bool pack)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    JSONParser parser;
+    parser.set_deduplicate(deduplicate);
+    parser.set_pack_arrays(pack);
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<JSONObject> trees;
+        trees.reserve(corpus.documents.size());
+
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        for (auto &document : corpus.documents)
+        {
+            parser.parse(document);
+            trees.push_back(parser.take_tree());
+        }
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.parse_allocations = counter.count();
+        result.parse_allocated_bytes = counter.bytes();
+
+        counter.reset();
+        BenchTimer lookup_timer;
+        size_t lookups = 0;
+        for (auto &tree : trees)
+            lookups += lookup_all(tree);
+        result.lookup_seconds = std::min(result.lookup_seconds, lookup_timer.seconds());
+        result.lookups = lookups;
+        result.lookup_allocated_bytes = counter.bytes();
+        result.tree_bytes =
+            tree_bytes(trees, [](const JSONObject &tree) -> auto & { return tree; });
+
+        counter.reset();
+        BenchTimer destroy_timer;
+        trees.clear();
+        trees.shrink_to_fit();
+        result.destroy_seconds = std::min(result.destroy_seconds, destroy_timer.seconds());
+        result.destroy_releases = counter.releases();
+    }
+    return result;
+}
+
+// Only checks that every document is valid, without building anything
+static Result run_validate(const Corpus &corpus, int iterations)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    JSONParser parser;
+    for (int i = 0; i < iterations; i++)
+    {
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        size_t valid = 0;
+        for (auto &document : corpus.documents)
+            valid += parser.validate(document);
+        bench_keep(valid);
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.parse_allocations = counter.count();
+        result.parse_allocated_bytes = counter.bytes();
+    }
+    result.lookup_seconds = 0;
+    result.destroy_seconds = 0;
+    return result;
+}
+
+// Runs a query directly over the text, the query is compiled once for all documents
+static Result run_query(const Corpus &corpus, int iterations)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    JSONPath path("$[?(@.price > 500 && @.active == true)].address.city");
+    for (int i = 0; i < iterations; i++)
+    {
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        size_t matches = 0;
+        for (auto &document : corpus.documents)
+            matches += path.select_text(document).size();
+        bench_keep(matches);
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.parse_allocations = counter.count();
+        result.parse_allocated_bytes = counter.bytes();
+    }
+    result.lookup_seconds = 0;
+    result.destroy_seconds = 0;
+    return result;
+}
+
+// Reads an array of records directly into structs, for comparison with parsing into a tree
+static Result run_bound(const Corpus &corpus, int iterations)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<std::vector<BenchRecord>> records;
+
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        for (auto &document : corpus.documents)
+            records.push_back(from_json<std::vector<BenchRecord>>(document));
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.lookup_seconds = 0;
+        result.parse_allocations = counter.count();
+        result.parse_allocated_bytes = counter.bytes();
+
+        counter.reset();
+        BenchTimer destroy_timer;
+        records.clear();
+        records.shrink_to_fit();
+        result.destroy_seconds = std::min(result.destroy_seconds, destroy_timer.seconds());
+        result.destroy_releases = counter.releases();
+    }
+    return result;
+}
+
+// Reads the scalar fields of an array of records into columns
+static Result run_columns(const Corpus &corpus, int iterations, size_t threads)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    JSONColumnOptions options;
+    options.schema = {{"id", JSONColumnType::INTEGER},
+                      {"name", JSONColumnType::STRING},
+                      {"price", JSONColumnType::REAL},
+                      {"quantity", JSONColumnType::INTEGER},
+                      {"active", JSONColumnType::BOOLEAN}};
+    options.threads = threads;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<JSONTable> tables;
+
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        for (auto &document : corpus.documents)
+            tables.push_back(json_read_columns(document, options));
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.lookup_seconds = 0;
+        if (threads == 1)
+        {
+            result.parse_allocations = counter.count();
+            result.parse_allocated_bytes = counter.bytes();
+        }
+
+        counter.reset();
+        BenchTimer destroy_timer;
+        tables.clear();
+        tables.shrink_to_fit();
+        result.destroy_seconds = std::min(result.destroy_seconds, destroy_timer.seconds());
+        result.destroy_releases = counter.releases();
+    }
+    return result;
+}
+
+// Parses all documents as one batch on a pool of threads, which is started once
+static Result run_batch(const Corpus &corpus, int iterations, size_t threads)
+{
+    Result result;
+    for (auto &document : corpus.documents)
+        result.bytes += document.size();
+
+    std::vector<std::string_view> views(corpus.documents.begin(), corpus.documents.end());
+    JSONBatchParser batch(threads);
+    for (int i = 0; i < iterations; i++)
+    {
+        JSONAllocationCounter counter;
+        BenchTimer parse_timer;
+        auto results = batch.parse(views);
+        result.parse_seconds = std::min(result.parse_seconds, parse_timer.seconds());
+        result.lookup_seconds = 0;
+        if (threads == 1)
+        {
+            result.parse_allocations = counter.count();
+            result.parse_allocated_bytes = counter.bytes();
+        }
+        result.tree_bytes =
+            tree_bytes(results, [](const JSONBatchResult &entry) -> auto & { return entry.tree; });
+
+        counter.reset();
+        BenchTimer destroy_timer;
+        results.clear();
+        results.shrink_to_fit();
+        result.destroy_seconds = std::min(result.destroy_seconds, destroy_timer.seconds());
+        result.destroy_releases = counter.releases();
+    }
+    return result;
+}
+
+// A measurement as a JSON integer, or null if it was not taken
+static JSONObject measured(const std::optional<uint64_t> &value)
+{
+    if (!value)
+        return JSONObject(JSONObjectType::NULL_VALUE);
+    return JSONObject(static_cast<int64_t>(*value));
+}
+
+static JSONObject report(const Corpus &corpus, const std::string &mode, const Result &result)
+{
+    const double mb = static_cast<double>(result.bytes) / (1024.0 * 1024.0);
+    const double documents = static_cast<double>(corpus.documents.size());
+    JSONObject ob;
+    ob["corpus"] = JSONObject(corpus.name);
+    ob["mode"] = JSONObject(mode);
+    ob["bytes"] = JSONObject(static_cast<int64_t>(result.bytes));
+    ob["documents"] = JSONObject(static_cast<int64_t>(corpus.documents.size()));
+    ob["parse_seconds"] = JSONObject(static_cast<long double>(result.parse_seconds));
+    ob["parse_mb_per_s"] = JSONObject(static_cast<long double>(mb / result.parse_seconds));
+    ob["parse_documents_per_s"] =
+        JSONObject(static_cast<long double>(documents / result.parse_seconds));
+    ob["lookups"] = JSONObject(static_cast<int64_t>(result.lookups));
+    ob["lookup_seconds"] = JSONObject(static_cast<long double>(result.lookup_seconds));
+    ob["destroy_seconds"] = JSONObject(static_cast<long double>(result.destroy_seconds));
+    ob["destroy_mb_per_s"] = JSONObject(static_cast<long double>(mb / result.destroy_seconds));
+    ob["parse_allocations"] = measured(result.parse_allocations);
+    ob["parse_allocated_bytes"] = measured(result.parse_allocated_bytes);
+    ob["lookup_allocated_bytes"] = measured(result.lookup_allocated_bytes);
+    ob["tree_bytes"] = measured(result.tree_bytes);
+    ob["destroy_releases"] = measured(result.destroy_releases);
+    return ob;
+}
+
+int main(int argc, char *argv[])
+{
+    double scale = 1.0;
+    int iterations = 3;
+    std::string output;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            scale = std::stod(argv[++i]);
+        else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = std::max(1, std::stoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--scale S] [--iterations N] [--output FILE]\n";
+            return 1;
+        }
+    }
+    auto scaled = [scale](size_t n)
+    { return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(n) * scale)); };
+
+    std::vector<Corpus> corpora = {
+        {"tweets", {bench_tweets(scaled(5000))}},
+        {"coordinates", {bench_coordinates(scaled(200000))}},
+        {"nested", {bench_nested(std::min<size_t>(scaled(500), 2000))}},
+        {"small_documents", bench_small_documents(scaled(50000))},
+        {"records", {bench_records(scaled(50000))}},
+    };
+
+    JSONObject results(JSONObjectType::ARRAY);
+    for (auto &corpus : corpora)
+    {
+        results.as_vector().push_back(
+            report(corpus, "tree", run_tree(corpus, iterations, false, false)));
+        results.as_vector().push_back(
+            report(corpus, "tree_dedup", run_tree(corpus, iterations, true, false)));
+        results.as_vector().push_back(
+            report(corpus, "tree_packed", run_tree(corpus, iterations, false, true)));
+        results.as_vector().push_back(
+            report(corpus, "validate", run_validate(corpus, iterations)));
+    }
+    auto &small = corpora[3];
+    results.as_vector().push_back(report(small, "batch", run_batch(small, iterations, 1)));
+    results.as_vector().push_back(
+        report(small, "batch_4_threads", run_batch(small, iterations, 4)));
+    auto &records = corpora.back();
+    results.as_vector().push_back(report(records, "bind", run_bound(records, iterations)));
+    results.as_vector().push_back(report(records, "query_text", run_query(records, iterations)));
+    results.as_vector().push_back(report(records, "columns", run_columns(records, iterations, 1)));
+    results.as_vector().push_back(
+        report(records, "columns_4_threads", run_columns(records, iterations, 4)));
+
+    JSONObject root;
+    root["benchmark"] = JSONObject(std::string("bench_parse"));
+    root["scale"] = JSONObject(static_cast<long double>(scale));
+    root["iterations"] = JSONObject(static_cast<int64_t>(iterations));
+    root["results"] = results;
+
+    auto text = to_json(root);
+    if (output.empty())
+    {
+        std::cout << text << std::endl;
+    }
+    else
+    {
+        std::ofstream ofs(output);
+        ofs << text << std::endl;
+    }
+    return 0;
+}
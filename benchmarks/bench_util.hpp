@@ -0,0 +1,261 @@
+#pragma once
+#include <chrono>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Helpers shared by the benchmarks: timing and generators for the inputs.
+// All generated input is deterministic, so that results can be compared between runs.
+
+class BenchTimer
+{
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Prevents the compiler from optimizing away a value which is computed only for benchmarking
+template <typename T> inline void bench_keep(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+// xorshift64*, small and fast enough to not dominate the time spent generating inputs
+class BenchRng
+{
+    uint64_t state;
+
+  public:
+    BenchRng(uint64_t seed) : state(seed ? seed : 1) {}
+
+    uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Returns a value in [0, n)
+    uint64_t below(uint64_t n) { return next() % n; }
+
+    double real() { return static_cast<double>(next() >> 11) / static_cast<double>(1ULL << 53); }
+};
+
+inline std::string bench_word(BenchRng &rng)
+{
+    static const char *words[] = {"lorem", "ipsum", "dolor",  "sit",   "amet",   "json",
+                                  "parse", "quick", "brown",  "fox",   "jumps",  "over",
+                                  "lazy",  "dog",   "stream", "token", "buffer", "value"};
+    return words[rng.below(sizeof(words) / sizeof(words[0]))];
+}
+
+inline std::string bench_sentence(BenchRng &rng, size_t words)
+{
+    std::string s;
+    for (size_t i = 0; i < words; i++)
+    {
+        if (i)
+            s.push_back(' ');
+        s += bench_word(rng);
+    }
+    return s;
+}
+
+// String heavy input, shaped like a page of a social media API response
+inline std::string bench_tweets(size_t count)
+{
+    BenchRng rng(1);
+    std::string s = "{\"statuses\": [";
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            s += ",";
+        s += "\n  {\"id\": " + std::to_string(1000000000 + rng.below(1000000000)) +
+             ", \"text\": \"" + bench_sentence(rng, 8 + rng.below(20)) +
+             "\", \"lang\": \"en\", \"truncated\": false, \"user\": {\"name\": \"" +
+             bench_word(rng) + " " + bench_word(rng) + "\", \"screen_name\": \"" +
+             bench_word(rng) + std::to_string(rng.below(1000)) +
+             "\", \"description\": \"" + bench_sentence(rng, 12) +
+             "\", \"followers_count\": " + std::to_string(rng.below(100000)) +
+             ", \"verified\": " + (rng.below(10) ? "false" : "true") +
+             "}, \"entities\": {\"hashtags\": [\"" + bench_word(rng) + "\", \"" + bench_word(rng) +
+             "\"], \"urls\": []}, \"retweet_count\": " + std::to_string(rng.below(500)) +
+             ", \"in_reply_to\": null}";
+    }
+    s += "\n]}";
+    return s;
+}
+
+// Number heavy input, shaped like a GeoJSON polygon collection
+inline std::string bench_coordinates(size_t points)
+{
+    BenchRng rng(2);
+    std::string s = "{\"type\": \"FeatureCollection\", \"features\": [{\"type\": \"Feature\", "
+                     "\"geometry\": {\"type\": \"Polygon\", \"coordinates\": [[";
+    for (size_t i = 0; i < points; i++)
+    {
+        if (i)
+            s += ",";
+        if (i % 4 == 0)
+            s += "\n";
+        s += "[" + std::to_string(-180.0 + 360.0 * rng.real()) + "," +
+             std::to_string(-90.0 + 180.0 * rng.real()) + "]";
+    }
+    s += "]]}}]}";
+    return s;
+}
+
+// Alternating objects and arrays nested depth levels deep
+inline std::string bench_nested(size_t depth)
+{
+    std::string s;
+    for (size_t i = 0; i < depth; i++)
+        s += i % 2 ? "[1, " : "{\"a\": ";
+    s += "null";
+    for (size_t i = depth; i > 0; i--)
+        s += (i - 1) % 2 ? "]" : "}";
+    return s;
+}
+
+// A record of a large array, also used on its own as a small document
+inline std::string bench_record(BenchRng &rng, size_t id)
+{
+    return "{\"id\": " + std::to_string(id) + ", \"name\": \"" + bench_word(rng) + " " +
+           bench_word(rng) + "\", \"price\": " + std::to_string(rng.real() * 1000) +
+           ", \"quantity\": " + std::to_string(rng.below(100)) +
+           ", \"active\": " + (rng.below(2) ? "true" : "false") + ", \"tags\": [\"" +
+           bench_word(rng) + "\", \"" + bench_word(rng) + "\"], \"address\": {\"city\": \"" +
+           bench_word(rng) + "\", \"zip\": \"" + std::to_string(10000 + rng.below(90000)) +
+           "\"}}";
+}
+
+inline std::string bench_records(size_t count)
+{
+    BenchRng rng(3);
+    std::string s = "[";
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            s += ",\n";
+        s += bench_record(rng, i);
+    }
+    s += "]";
+    return s;
+}
+
+inline std::vector<std::string> bench_small_documents(size_t count)
+{
+    BenchRng rng(4);
+    std::vector<std::string> documents;
+    for (size_t i = 0; i < count; i++)
+        documents.push_back(bench_record(rng, i));
+    return documents;
+}
+
+/*
+ * Generators for the lexer microbenchmarks, each returns input made of a single kind of token
+ */
+
+inline std::string bench_whitespace(size_t length)
+{
+    static const char whitespace[] = {' ', '\n', '\t', '\r', ' ', ' ', ' ', ' '};
+    BenchRng rng(5);
+    std::string s;
+    for (size_t i = 0; i < length; i++)
+        s.push_back(whitespace[rng.below(sizeof(whitespace))]);
+    return s;
+}
+
+// A quoted string of about length characters, escapes_per_100 of which are escape sequences
+inline std::string bench_string(size_t length, size_t escapes_per_100)
+{
+    static const char *escapes[] = {"\\n", "\\t", "\\\"", "\\\\", "\\/"};
+    BenchRng rng(6);
+    std::string s = "\"";
+    for (size_t i = 0; i < length; i++)
+    {
+        if (rng.below(100) < escapes_per_100)
+            s += escapes[rng.below(5)];
+        else
+            s.push_back(static_cast<char>('a' + rng.below(26)));
+    }
+    s += "\"";
+    return s;
+}
+
+// About length bytes of text, non_ascii_per_100 of the characters being two to four byte UTF-8
+inline std::string bench_utf8(size_t length, size_t non_ascii_per_100)
+{
+    static const char *characters[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x81"};
+    BenchRng rng(9);
+    std::string s;
+    while (s.size() < length)
+    {
+        if (rng.below(100) < non_ascii_per_100)
+            s += characters[rng.below(3)];
+        else
+            s.push_back(static_cast<char>('a' + rng.below(26)));
+    }
+    return s;
+}
+
+enum class BenchNumberKind
+{
+    INTEGER,
+    SHORT_REAL,
+    LONG_EXPONENT,
+};
+
+// count numbers of the given kind, separated by spaces
+inline std::string bench_numbers(size_t count, BenchNumberKind kind)
+{
+    BenchRng rng(7);
+    std::string s;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            s.push_back(' ');
+        switch (kind)
+        {
+        case BenchNumberKind::INTEGER:
+            s += std::to_string(static_cast<int64_t>(rng.next() >> 20) - (1LL << 43));
+            break;
+        case BenchNumberKind::SHORT_REAL:
+            s += std::to_string(rng.below(1000)) + "." + std::to_string(rng.below(100));
+            break;
+        case BenchNumberKind::LONG_EXPONENT:
+            s += "-" + std::to_string(rng.below(10)) + "." + std::to_string(rng.next() >> 4) +
+                 "e-" + std::to_string(100 + rng.below(200));
+            break;
+        }
+    }
+    return s;
+}
+
+// count literals (true, false and null) separated by commas
+inline std::string bench_literals(size_t count)
+{
+    static const char *literals[] = {"true", "false", "null"};
+    BenchRng rng(8);
+    std::string s;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            s.push_back(',');
+        s += literals[rng.below(3)];
+    }
+    return s;
+}
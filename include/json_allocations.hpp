@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Counts the heap allocations made by the current thread while it is alive, for example to check
+ * that parsing a document allocates at most a given number of times:
+ *
+ *     JSONAllocationCounter counter;
+ *     parser.parse(buffer);
+ *     assert(counter.count() <= 100);
+ *
+ * Counting works by replacing the global operator new and operator delete, so it is not part of
+ * the parser library. Link the jsonparser_allocations library into the executable to use it, it
+ * replaces the operators of the whole program. Allocations made by other threads are not counted.
+ */
+class JSONAllocationCounter
+{
+    uint64_t start_count;
+    uint64_t start_bytes;
+    uint64_t start_releases;
+
+  public:
+    JSONAllocationCounter();
+
+    // Number of allocations made since the counter was created or reset
+    uint64_t count() const;
+
+    // Bytes requested by those allocations
+    uint64_t bytes() const;
+
+    // Number of blocks freed since the counter was created or reset, whichever thread allocated
+    // them. Equal to count() if everything allocated in between has been freed again
+    uint64_t releases() const;
+
+    void reset();
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include "json_parser.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Parses many small documents, such as the messages of a queue, on a pool of threads:
+ *
+ *   JSONBatchParser batch(8);
+ *   std::vector<std::string_view> messages = ...;
+ *   for (auto &result : batch.parse(messages))
+ *       if (result.ok())
+ *           handle(result.tree);
+ *
+ * The threads are started once and wait between batches. Every thread, including the one which
+ * calls parse(), has its own JSONParser, which keeps its buffers across documents and batches, see
+ * json_parser.hpp. The threads take the documents in small blocks from a shared counter, so that a
+ * thread which finishes early takes over the blocks that are left.
+ *
+ * A document which cannot be parsed does not stop the batch, its error is returned in its result.
+ * Limit errors are returned as json_parse_error, the message names the limit.
+ *
+ * A JSONBatchParser must be used by one thread at a time.
+ */
+
+struct JSONBatchResult
+{
+    // The tree of the document, an empty object if it could not be parsed
+    JSONObject tree;
+
+    // The error of a document which could not be parsed
+    std::optional<json_parse_error> error;
+
+    bool ok() const { return !error; }
+};
+
+class JSONBatchParser
+{
+    // One parser per thread, the first one is used by the thread which calls parse()
+    std::vector<std::unique_ptr<JSONParser>> parsers;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+
+    // Incremented for every batch, the workers wait for it to change
+    uint64_t generation;
+
+    // Workers which have not finished the current batch
+    size_t active;
+
+    bool stopping;
+
+    // The current batch
+    const std::string_view *documents;
+    size_t count;
+    size_t block;
+    const std::function<void(size_t, JSONBatchResult &)> *callback;
+
+    // Index of the first document which has not been taken by a thread
+    std::atomic<size_t> next;
+
+    // Set when the callback or a parser throws something other than a parse error, the first
+    // such exception is rethrown by parse()
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+
+    void work(size_t worker);
+
+    void run(size_t worker);
+
+  public:
+    explicit JSONBatchParser(size_t threads = std::thread::hardware_concurrency());
+
+    ~JSONBatchParser();
+
+    JSONBatchParser(const JSONBatchParser &) = delete;
+
+    JSONBatchParser &operator=(const JSONBatchParser &) = delete;
+
+    size_t threads() const;
+
+    // The settings are applied to the parser of every thread, see JSONParser
+    void set_limits(const ParseLimits &limits);
+
+    void set_validate_utf8(bool enabled);
+
+    void set_deduplicate(bool enabled);
+
+    void set_pack_arrays(bool enabled);
+
+    // Parses every document, returns the results in the order of the documents
+    std::vector<JSONBatchResult> parse(const std::vector<std::string_view> &documents);
+
+    // Parses every document and calls callback(index, result) for each one as soon as it is
+    // parsed, in no particular order. The callback is called from several threads at once, and
+    // may move the tree out of the result. If it throws, the documents which have not been taken
+    // yet are skipped and parse() rethrows the exception
+    void parse(const std::vector<std::string_view> &documents,
+               const std::function<void(size_t index, JSONBatchResult &result)> &callback);
+};
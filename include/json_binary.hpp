@@ -0,0 +1,102 @@
+#pragma once
+#include "json_object.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Encoders and decoders between JSONObject and the binary formats CBOR (RFC 8949) and MessagePack.
+ * Integers are encoded as integers and reals as floating point values, so the distinction between
+ * NUMBER_INT and NUMBER_REAL survives a round trip. Reals are stored as single precision floats
+ * when that is exact and as doubles otherwise, so long double values which are not exactly
+ * representable as a double lose their extra precision.
+ * Decoding errors and truncated input throw json_parse_error with the offset of the problem.
+ */
+
+enum class BinaryFormat : uint8_t
+{
+    CBOR,
+    MESSAGEPACK,
+};
+
+void to_cbor(const JSONObject &ob, std::vector<uint8_t> &out);
+
+std::vector<uint8_t> to_cbor(const JSONObject &ob);
+
+JSONObject from_cbor(const uint8_t *data, size_t size);
+
+JSONObject from_cbor(const std::vector<uint8_t> &data);
+
+void to_msgpack(const JSONObject &ob, std::vector<uint8_t> &out);
+
+std::vector<uint8_t> to_msgpack(const JSONObject &ob);
+
+JSONObject from_msgpack(const uint8_t *data, size_t size);
+
+JSONObject from_msgpack(const std::vector<uint8_t> &data);
+
+// An array or map which is being decoded, with the items decoded so far
+struct BinaryFrame
+{
+    bool is_map;
+
+    // A CBOR container of indefinite length ends with a break byte instead of a count
+    bool indefinite;
+
+    // Number of items, or of pairs for a map, which are still to be decoded
+    uint64_t remaining;
+
+    JSONObject::Elements elements;
+    JSONObject::Members pairs;
+
+    // The key of a map whose value is being decoded
+    std::string key;
+    bool has_key;
+};
+
+/*
+ * Decodes a sequence of items which arrive in arbitrary chunks, for example from a socket.
+ * Bytes are appended with feed(), and next() returns each item once all of its bytes are
+ * available. An incomplete item keeps the values decoded so far, and next() resumes after the
+ * last complete one, so every byte is decoded once however the input is split. A string or number
+ * is not decoded again until enough bytes for the part which was missing have been fed.
+ */
+class JSONStreamDecoder
+{
+    BinaryFormat format;
+
+    std::vector<uint8_t> buffer;
+
+    // Number of bytes of buffer which have been decoded, into returned items or into frames
+    size_t consumed;
+
+    // Size the buffer must reach before decoding the pending item is attempted again
+    size_t needed;
+
+    // Number of bytes dropped from the front of buffer, errors report offsets within the stream
+    size_t discarded;
+
+    // The containers of the pending item which are open, outermost first
+    std::vector<BinaryFrame> frames;
+
+    // Offset in the stream of the first byte of the pending item
+    size_t item_start;
+
+    size_t max_item;
+
+  public:
+    JSONStreamDecoder(BinaryFormat format);
+
+    // Rejects an item larger than bytes with json_limit_error, whose limit() is "max_item_size".
+    // A length or count which cannot fit is rejected as soon as it is read, so that a hostile
+    // length cannot make the decoder buffer input without bound. There is no limit by default
+    void set_max_item_size(size_t bytes);
+
+    void feed(const uint8_t *data, size_t size);
+
+    // Decodes the next complete item into out, returns false if more input is needed
+    bool next(JSONObject &out);
+
+    // Number of bytes which have been fed but not yet returned as items
+    size_t pending() const;
+};
@@ -0,0 +1,558 @@
+#pragma once
+#include "json_lexer.hpp"
+#include "json_object.hpp"
+#include "json_writer.hpp"
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Binding layer which reads JSON directly into C++ structs, without building a JSONObject tree.
+ * The fields of a struct are listed by specializing json_fields for it:
+ *
+ *   struct Record { int64_t id; std::string name; std::vector<double> values; };
+ *
+ *   template <> struct json_fields<Record>
+ *   {
+ *       static constexpr auto value = std::make_tuple(JSON_FIELD(Record, id),
+ *                                                     JSON_FIELD(Record, name),
+ *                                                     json_field("vals", &Record::values));
+ *   };
+ *
+ *   auto records = from_json<std::vector<Record>>(buffer);
+ *   std::string text = to_json(records);
+ *
+ * Keys of a bound struct are dispatched through a perfect hash table built at compile time, keys
+ * which are not listed are skipped and fields whose keys are missing keep their default value.
+ * Besides bound structs, bool, integral and floating point types, std::string, std::vector,
+ * std::optional, std::map<std::string, T> and JSONObject can be read. Numbers follow the same
+ * rules as json_converter: integers must fit in the target type and reals never become integers.
+ * The same types can be written back with to_json(), where the quoted and escaped form of each
+ * key of a bound struct is generated at compile time.
+ */
+
+// The key of a field as it is written to the output, i.e. "key": with the key escaped.
+// Every character escapes to at most six characters, which bounds the size of the array
+template <size_t N> struct json_quoted_key
+{
+    std::array<char, 6 * N + 3> data;
+    size_t length;
+};
+
+template <size_t N> constexpr json_quoted_key<N> json_quote_key(const char (&name)[N])
+{
+    const char hex[] = "0123456789abcdef";
+    json_quoted_key<N> key{{}, 0};
+    key.data[key.length++] = '"';
+    for (size_t i = 0; i + 1 < N; i++)
+    {
+        unsigned char ch = static_cast<unsigned char>(name[i]);
+        if (ch == '"' || ch == '\\')
+        {
+            key.data[key.length++] = '\\';
+            key.data[key.length++] = name[i];
+        }
+        else if (ch < 0x20)
+        {
+            key.data[key.length++] = '\\';
+            key.data[key.length++] = 'u';
+            key.data[key.length++] = '0';
+            key.data[key.length++] = '0';
+            key.data[key.length++] = hex[ch >> 4];
+            key.data[key.length++] = hex[ch & 0xF];
+        }
+        else
+        {
+            key.data[key.length++] = name[i];
+        }
+    }
+    key.data[key.length++] = '"';
+    key.data[key.length++] = ':';
+    return key;
+}
+
+template <typename Class, typename Member, size_t N> struct json_field_t
+{
+    std::string_view name;
+    Member Class::*pointer;
+    json_quoted_key<N> key;
+};
+
+template <typename Class, typename Member, size_t N>
+constexpr json_field_t<Class, Member, N> json_field(const char (&name)[N], Member Class::*pointer)
+{
+    return json_field_t<Class, Member, N>{std::string_view(name, N - 1), pointer,
+                                          json_quote_key(name)};
+}
+
+// Binds a member to a key with the same name as the member
+#define JSON_FIELD(Class, member) json_field(#member, &Class::member)
+
+// Specialize this with a static constexpr tuple of json_field() named value
+template <typename T> struct json_fields;
+
+template <typename T, typename Enable = void> struct has_json_fields : std::false_type
+{
+};
+
+template <typename T>
+struct has_json_fields<T, std::void_t<decltype(json_fields<T>::value)>> : std::true_type
+{
+};
+
+/*
+ * A thin wrapper around the lexer which provides a single token of lookahead, and helpers for
+ * the binding layer. It is not tied to any C++ type, so it is compiled into the library.
+ */
+class JSONTokenReader
+{
+    JSONLexer lexer;
+
+    Token lookahead;
+
+    bool has_lookahead;
+
+  public:
+    JSONTokenReader(const std::string &buffer);
+
+    Token next();
+
+    const Token &peek();
+
+    // Consumes the next token, and throws an error mentioning what if it is not of the given type
+    Token expect(Token::Type type, const char *what);
+
+    // Consumes a complete value, including nested objects and arrays, without storing it
+    void skip_value();
+
+    // Reads a complete value into a generic tree
+    JSONObject read_tree();
+
+    // Throws an error if there is any input left
+    void finish();
+
+    json_parse_error error(const std::string &message, const Token &tok) const;
+};
+
+// 32 bit FNV-1a, with the seed mixed into the offset basis and a final avalanche step so that
+// different seeds give unrelated hashes
+constexpr uint32_t json_key_hash(std::string_view key, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (char ch : key)
+    {
+        h ^= static_cast<uint8_t>(ch);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    return h;
+}
+
+// Perfect hash table over the keys of a bound struct. slots maps (hash & mask) to the index of a
+// field plus one, zero marks an empty slot
+template <size_t N> struct json_key_table
+{
+    uint32_t seed;
+    size_t mask;
+    std::array<uint16_t, N> slots;
+};
+
+template <typename T, size_t... I>
+constexpr std::array<std::string_view, sizeof...(I)> json_field_names(std::index_sequence<I...>)
+{
+    return {std::get<I>(json_fields<T>::value).name...};
+}
+
+// Searches for a seed which maps every key to a different slot of a table of size entries
+template <size_t K>
+constexpr bool json_try_seed(const std::array<std::string_view, K> &names, size_t size,
+                             uint32_t seed)
+{
+    std::array<bool, 16 * (K + 1)> used{};
+    for (size_t i = 0; i < K; i++)
+    {
+        size_t slot = json_key_hash(names[i], seed) & (size - 1);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+template <typename T> struct json_key_dispatch
+{
+    static constexpr size_t count =
+        std::tuple_size_v<std::decay_t<decltype(json_fields<T>::value)>>;
+
+    static constexpr std::array<std::string_view, count> names =
+        json_field_names<T>(std::make_index_sequence<count>());
+
+    // Largest table which is tried, the search starts at twice the number of keys
+    static constexpr size_t capacity = 16 * (count + 1);
+
+    static constexpr json_key_table<capacity> build()
+    {
+        json_key_table<capacity> table{0, 0, {}};
+        size_t size = 1;
+        while (size < 2 * count)
+            size *= 2;
+        for (; size <= capacity; size *= 2)
+        {
+            for (uint32_t seed = 1; seed <= 256; seed++)
+            {
+                if (!json_try_seed(names, size, seed))
+                    continue;
+                table.seed = seed;
+                table.mask = size - 1;
+                for (size_t i = 0; i < count; i++)
+                    table.slots[json_key_hash(names[i], seed) & table.mask] =
+                        static_cast<uint16_t>(i + 1);
+                return table;
+            }
+        }
+        // No perfect hash was found, lookup() falls back to comparing every key
+        return table;
+    }
+
+    static constexpr json_key_table<capacity> table = build();
+
+    // Returns the index of the field bound to key, or count if there is none
+    static size_t lookup(std::string_view key)
+    {
+        if constexpr (table.seed == 0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (names[i] == key)
+                    return i;
+            }
+            return count;
+        }
+        else
+        {
+            size_t slot = table.slots[json_key_hash(key, table.seed) & table.mask];
+            if (slot == 0 || names[slot - 1] != key)
+                return count;
+            return slot - 1;
+        }
+    }
+};
+
+// json_deserializer<T>::read(reader, out) reads the next value from the reader into out
+template <typename T, typename Enable = void> struct json_deserializer;
+
+template <> struct json_deserializer<bool>
+{
+    static void read(JSONTokenReader &reader, bool &out)
+    {
+        auto token = reader.next();
+        if (token.type == Token::Type::LITERAL_TRUE)
+            out = true;
+        else if (token.type == Token::Type::LITERAL_FALSE)
+            out = false;
+        else
+            throw reader.error("Expected boolean, found ", token);
+    }
+};
+
+template <typename T>
+struct json_deserializer<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    static void read(JSONTokenReader &reader, T &out)
+    {
+        auto token = reader.expect(Token::Type::NUMBER_INTEGER, "integer");
+        JSONObject value(token.as_integer());
+        if (!json_converter<T>::convert(value, out))
+            throw reader.error("Integer out of range, found ", token);
+    }
+};
+
+template <typename T> struct json_deserializer<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static void read(JSONTokenReader &reader, T &out)
+    {
+        auto token = reader.next();
+        if (token.type == Token::Type::NUMBER_REAL)
+        {
+            JSONObject value(token.as_real());
+            if (!json_converter<T>::convert(value, out))
+                throw reader.error("Number out of range, found ", token);
+        }
+        else if (token.type == Token::Type::NUMBER_INTEGER)
+            out = static_cast<T>(token.as_integer());
+        else
+            throw reader.error("Expected number, found ", token);
+    }
+};
+
+template <> struct json_deserializer<std::string>
+{
+    static void read(JSONTokenReader &reader, std::string &out)
+    {
+        out = std::move(reader.expect(Token::Type::STRING, "string").as_string());
+    }
+};
+
+template <> struct json_deserializer<JSONObject>
+{
+    static void read(JSONTokenReader &reader, JSONObject &out) { out = reader.read_tree(); }
+};
+
+template <typename T> struct json_deserializer<std::optional<T>>
+{
+    static void read(JSONTokenReader &reader, std::optional<T> &out)
+    {
+        if (reader.peek().type == Token::Type::LITERAL_NULL)
+        {
+            reader.next();
+            out.reset();
+            return;
+        }
+        json_deserializer<T>::read(reader, out.emplace());
+    }
+};
+
+template <typename T> struct json_deserializer<std::vector<T>>
+{
+    static void read(JSONTokenReader &reader, std::vector<T> &out)
+    {
+        reader.expect(Token::Type::LEFT_SQUARE, "\"[\"");
+        out.clear();
+        if (reader.peek().type == Token::Type::RIGHT_SQUARE)
+        {
+            reader.next();
+            return;
+        }
+        while (1)
+        {
+            // Read into a local, as the elements of a std::vector<bool> are proxies
+            T value{};
+            json_deserializer<T>::read(reader, value);
+            out.push_back(std::move(value));
+            auto token = reader.next();
+            if (token.type == Token::Type::RIGHT_SQUARE)
+                return;
+            if (token.type != Token::Type::COMMA)
+                throw reader.error("Expected \"]\", found ", token);
+        }
+    }
+};
+
+// Reads the members of an object, calling on_pair(key) after each key and colon is consumed.
+// on_pair is responsible for consuming the value
+template <typename F> void json_read_members(JSONTokenReader &reader, F &&on_pair)
+{
+    reader.expect(Token::Type::LEFT_BRACE, "\"{\"");
+    if (reader.peek().type == Token::Type::RIGHT_BRACE)
+    {
+        reader.next();
+        return;
+    }
+    while (1)
+    {
+        auto key = reader.expect(Token::Type::STRING, "string key");
+        reader.expect(Token::Type::COLON, "\":\"");
+        on_pair(key.as_string());
+        auto token = reader.next();
+        if (token.type == Token::Type::RIGHT_BRACE)
+            return;
+        if (token.type != Token::Type::COMMA)
+            throw reader.error("Expected \"}\", found ", token);
+    }
+}
+
+template <typename T> struct json_deserializer<std::map<std::string, T>>
+{
+    static void read(JSONTokenReader &reader, std::map<std::string, T> &out)
+    {
+        out.clear();
+        json_read_members(reader, [&](std::string &key)
+                          { json_deserializer<T>::read(reader, out[std::move(key)]); });
+    }
+};
+
+template <typename T> struct json_deserializer<T, std::enable_if_t<has_json_fields<T>::value>>
+{
+    using dispatch = json_key_dispatch<T>;
+
+    template <size_t I> static void read_field(JSONTokenReader &reader, T &out)
+    {
+        auto &field = std::get<I>(json_fields<T>::value);
+        using member_type = std::decay_t<decltype(out.*(field.pointer))>;
+        json_deserializer<member_type>::read(reader, out.*(field.pointer));
+    }
+
+    template <size_t... I>
+    static constexpr std::array<void (*)(JSONTokenReader &, T &), sizeof...(I)>
+    make_readers(std::index_sequence<I...>)
+    {
+        return {&read_field<I>...};
+    }
+
+    static void read(JSONTokenReader &reader, T &out)
+    {
+        static constexpr auto readers = make_readers(std::make_index_sequence<dispatch::count>());
+        json_read_members(reader,
+                          [&](const std::string &key)
+                          {
+                              size_t index = dispatch::lookup(key);
+                              if (index == dispatch::count)
+                                  reader.skip_value();
+                              else
+                                  readers[index](reader, out);
+                          });
+    }
+};
+
+// Parses buffer directly into out. The whole buffer must hold a single value
+template <typename T> void from_json(const std::string &buffer, T &out)
+{
+    JSONTokenReader reader(buffer);
+    json_deserializer<T>::read(reader, out);
+    reader.finish();
+}
+
+template <typename T> T from_json(const std::string &buffer)
+{
+    T result{};
+    from_json(buffer, result);
+    return result;
+}
+
+// json_serializer<T>::write(out, value) appends the JSON text of value to out
+template <typename T, typename Enable = void> struct json_serializer;
+
+template <> struct json_serializer<bool>
+{
+    static void write(std::string &out, bool value) { out.append(value ? "true" : "false"); }
+};
+
+template <typename T>
+struct json_serializer<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    static void write(std::string &out, T value)
+    {
+        if constexpr (std::is_signed_v<T>)
+            json_write_integer(out, value);
+        else
+            json_write_unsigned(out, value);
+    }
+};
+
+template <typename T> struct json_serializer<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static void write(std::string &out, T value)
+    {
+        if constexpr (std::is_same_v<T, long double>)
+            json_write_real(out, value);
+        else
+            json_write_real(out, static_cast<double>(value));
+    }
+};
+
+template <> struct json_serializer<std::string>
+{
+    static void write(std::string &out, const std::string &value) { json_write_string(out, value); }
+};
+
+template <> struct json_serializer<std::string_view>
+{
+    static void write(std::string &out, std::string_view value) { json_write_string(out, value); }
+};
+
+template <> struct json_serializer<JSONObject>
+{
+    static void write(std::string &out, const JSONObject &value) { json_write_tree(out, value); }
+};
+
+template <typename T> struct json_serializer<std::optional<T>>
+{
+    static void write(std::string &out, const std::optional<T> &value)
+    {
+        if (value)
+            json_serializer<T>::write(out, *value);
+        else
+            out.append("null");
+    }
+};
+
+template <typename T> struct json_serializer<std::vector<T>>
+{
+    static void write(std::string &out, const std::vector<T> &value)
+    {
+        out.push_back('[');
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (i)
+                out.push_back(',');
+            json_serializer<T>::write(out, value[i]);
+        }
+        out.push_back(']');
+    }
+};
+
+template <typename T> struct json_serializer<std::map<std::string, T>>
+{
+    static void write(std::string &out, const std::map<std::string, T> &value)
+    {
+        out.push_back('{');
+        bool first = true;
+        for (auto &pair : value)
+        {
+            if (!first)
+                out.push_back(',');
+            first = false;
+            json_write_string(out, pair.first);
+            out.push_back(':');
+            json_serializer<T>::write(out, pair.second);
+        }
+        out.push_back('}');
+    }
+};
+
+template <typename T> struct json_serializer<T, std::enable_if_t<has_json_fields<T>::value>>
+{
+    template <size_t I> static void write_field(std::string &out, const T &value)
+    {
+        auto &field = std::get<I>(json_fields<T>::value);
+        using member_type = std::decay_t<decltype(value.*(field.pointer))>;
+        if (I)
+            out.push_back(',');
+        out.append(field.key.data.data(), field.key.length);
+        json_serializer<member_type>::write(out, value.*(field.pointer));
+    }
+
+    template <size_t... I>
+    static void write_fields(std::string &out, const T &value, std::index_sequence<I...>)
+    {
+        (write_field<I>(out, value), ...);
+    }
+
+    static void write(std::string &out, const T &value)
+    {
+        out.push_back('{');
+        write_fields(out, value, std::make_index_sequence<json_key_dispatch<T>::count>());
+        out.push_back('}');
+    }
+};
+
+// Appends the JSON text of value to out
+template <typename T> void to_json(const T &value, std::string &out)
+{
+    json_serializer<T>::write(out, value);
+}
+
+template <typename T> std::string to_json(const T &value)
+{
+    std::string out;
+    json_serializer<T>::write(out, value);
+    return out;
+}
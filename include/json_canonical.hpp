@@ -0,0 +1,28 @@
+#pragma once
+#include "json_object.hpp"
+#include <functional>
+#include <string>
+
+/*
+ * Canonical JSON as defined by the JSON Canonicalization Scheme (RFC 8785), for hashing and
+ * signing. The output has no whitespace, object members are sorted by the UTF-16 code units of
+ * their keys, strings escape only what must be escaped, and numbers are written as ECMAScript
+ * writes doubles. Integers are converted to double first, so integers beyond 2^53 are rounded as
+ * they would be by any other implementation of the scheme.
+ * NaN and infinity have no canonical form and throw json_access_error.
+ */
+
+// Receives the canonical bytes in order, for example to update a hash
+using JSONByteSink = std::function<void(const char *data, size_t size)>;
+
+// Appends the shortest text which ECMAScript's Number.prototype.toString() gives for value
+void json_write_es_number(std::string &out, double value);
+
+// Appends the canonical JSON text of a tree
+void json_write_canonical(std::string &out, const JSONObject &ob);
+
+// Passes the canonical JSON text of a tree to sink in blocks of a few kilobytes, without holding
+// the whole text in memory
+void json_write_canonical(const JSONObject &ob, const JSONByteSink &sink);
+
+std::string to_canonical_json(const JSONObject &ob);
@@ -0,0 +1,104 @@
+#pragma once
+#include "json_exceptions.hpp"
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Reads a top level array of objects, such as [{"ts": 1, "v": 2.5}, {"ts": 2, "v": null}], into
+ * one contiguous buffer per key without building a tree:
+ *
+ *   JSONTable table = json_read_columns(buffer);
+ *   const JSONColumn *v = table.column("v");
+ *   for (size_t row = 0; row < table.rows; row++)
+ *       if (v->is_valid(row))
+ *           sum += v->reals[row];
+ *
+ * The buffers follow the layout of Apache Arrow, so that they can be handed to vectorized code as
+ * they are. Every column has one value per row, rows without a value (the key is missing or null)
+ * hold 0 or an empty string and have their bit cleared in the validity bitmap.
+ *
+ * Without a schema the columns are inferred from the data, in the order in which their keys first
+ * appear. A column which holds integers and reals becomes a REAL column, a column which only holds
+ * nulls is a NULL_VALUE column, and any other mix of types, or an object or array as the value of
+ * a key, is an error. With a schema only the listed keys are read, the others are skipped.
+ *
+ * The array can be split into chunks which are read by several threads, the chunks are then
+ * concatenated in order and the result is the same as reading it with one thread.
+ */
+
+enum class JSONColumnType
+{
+    NULL_VALUE,
+    BOOLEAN,
+    INTEGER,
+    REAL,
+    STRING
+};
+
+struct JSONColumn
+{
+    std::string name;
+
+    JSONColumnType type = JSONColumnType::NULL_VALUE;
+
+    // Values of the rows, only the buffer(s) of the column's type are filled. Booleans take one
+    // byte per row
+    std::vector<uint8_t> booleans;
+
+    std::vector<int64_t> integers;
+
+    std::vector<double> reals;
+
+    // The string of row i is bytes[offsets[i], offsets[i + 1]), so there are rows + 1 offsets
+    std::vector<uint64_t> offsets;
+
+    std::string bytes;
+
+    // Bit i % 8 of validity[i / 8] is set if row i has a value
+    std::vector<uint8_t> validity;
+
+    size_t null_count = 0;
+
+    bool is_valid(size_t row) const;
+
+    std::string_view string(size_t row) const;
+};
+
+// A column which is read when a schema is given. Integers are accepted in a REAL column, and null
+// in a column of any type
+struct JSONColumnSchema
+{
+    std::string name;
+
+    JSONColumnType type;
+};
+
+struct JSONColumnOptions
+{
+    // Columns to read, in this order. When empty the columns are inferred
+    std::vector<JSONColumnSchema> schema;
+
+    // Number of threads which read chunks of the array at the same time
+    size_t threads = 1;
+
+    // Smallest chunk given to a thread, in bytes, so that small inputs are not split
+    size_t min_chunk_size = 1 << 20;
+};
+
+struct JSONTable
+{
+    size_t rows = 0;
+
+    std::vector<JSONColumn> columns;
+
+    // Returns the column of a key, or nullptr if there is none
+    const JSONColumn *column(std::string_view name) const;
+};
+
+const char *json_column_type_name(JSONColumnType type);
+
+// Reads the records of a top level array into columns, throws json_parse_error if the input is
+// not such an array or if the values of a key do not fit in one column
+JSONTable json_read_columns(std::string_view buffer, const JSONColumnOptions &options = {});
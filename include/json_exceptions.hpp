@@ -17,9 +17,18 @@ class json_not_implemented_error : public std::exception
 };
 
 // Thrown for any syntax/lexical error related to parsing of JSON
+// If the error can be attributed to a position in the input, offset() returns the byte offset of
+// that position and excerpt() returns a few characters of input around it. Line and column are not
+// stored, they can be computed on demand with JSONParser::location(offset)
 class json_parse_error : public std::exception
 {
-    std::string message;
+    std::string full;
+
+    std::string bare;
+
+    size_t position;
+
+    std::string context;
 
   public:
     json_parse_error();
@@ -28,9 +37,31 @@ class json_parse_error : public std::exception
 
     json_parse_error(const std::string &message, const Token &tok);
 
+    json_parse_error(const std::string &message, size_t offset, const std::string &excerpt);
+
+    // Byte offset of the error in the input, or std::string::npos if it is not known
+    size_t offset() const noexcept;
+
+    const std::string &excerpt() const noexcept;
+
+    // The message without the offset and excerpt which what() appends to it
+    const std::string &message() const noexcept;
+
     const char *what() const noexcept override;
 };
 
+// Thrown when a document exceeds one of the ParseLimits given to the parser. limit() is the name of
+// the ParseLimits field which was exceeded
+class json_limit_error : public json_parse_error
+{
+    std::string name;
+
+  public:
+    json_limit_error(const std::string &limit, size_t value, size_t offset);
+
+    const std::string &limit() const noexcept;
+};
+
 // Thrown when invalid access is performed, for example trying to access key for integer object
 class json_access_error : public std::exception
 {
@@ -42,4 +73,19 @@ class json_access_error : public std::exception
     json_access_error(const std::string &message);
 
     const char *what() const noexcept override;
-};
\ No newline at end of file
+};
+// Thrown when a JSON Patch cannot be applied, operation() is the index of the failing operation.
+// The document is left unchanged
+class json_patch_error : public std::exception
+{
+    std::string message;
+
+    size_t index;
+
+  public:
+    json_patch_error(const std::string &message, size_t operation);
+
+    size_t operation() const noexcept;
+
+    const char *what() const noexcept override;
+};
@@ -1,22 +1,47 @@
 #pragma once
 #include "json_exceptions.hpp"
+#include "json_limits.hpp"
+#include "json_stats.hpp"
 #include "token.hpp"
+#include <string_view>
 
 // https://www.rfc-editor.org/rfc/rfc8259.txt
 // https://www.json.org/json-en.html
 
+// Line and column (both starting from 1) of a byte offset in the input. The column is counted in
+// bytes, not in characters
+struct SourceLocation
+{
+    size_t line;
+    size_t column;
+};
+
+json_parse_error json_error_at(const std::string &message, std::string_view input, size_t offset);
 
 // This class converts a sequence of characters into tokens, which can be consumed by the parser.
 // The data to be parsed is stored in a string variable buffer, and idx stores the index of
 // the character to be processed.
 // The main purpose of this class is to group logically related characters into tokens, which can then be parsed.
 // These details are abstracted by the methods symbol(), advance() and available()
+// Only the offset of the current token is tracked while lexing, line and column numbers are
+// computed from the offset when they are asked for (see location())
 class JSONLexer
 {
     std::string buffer;
 
+    // Characters of the string, number or literal being scanned, kept across tokens and inputs so
+    // that its capacity is reused
+    std::string scratch;
+
     size_t idx;
 
+    // Offset of the first character of the token being scanned
+    size_t start;
+
+    ParseStats *stats;
+
+    ParseLimits limits;
+
     char symbol();
 
     void advance();
@@ -31,10 +56,18 @@ class JSONLexer
 
     Token lex_string();
 
+    uint32_t lex_hex4();
+
+    void lex_unicode_escape(std::string &out);
+
     Token lex_number();
 
     Token lex_literal();
 
+    void record(const Token &token);
+
+    // Gives the microbenchmarks access to the individual lexing stages
+    friend struct JSONLexerBench;
 
   public:
     JSONLexer();
@@ -43,7 +76,25 @@ class JSONLexer
 
     Token next();
 
-    void load(const std::string &s);
+    void load(std::string_view s);
 
     bool is_next();
+
+    // Returns the offset of the next character to be processed
+    size_t position() const;
+
+    // Returns the size of the loaded input in bytes
+    size_t size() const;
+
+    void validate_utf8() const;
+
+    SourceLocation location(size_t offset) const;
+
+    // Creates a parse error for the given offset, with an excerpt of the input around it
+    json_parse_error error(const std::string &message, size_t offset) const;
+
+    void set_stats(ParseStats *s);
+
+    // Limits the length of strings and numbers, the other limits are checked by the parser
+    void set_limits(const ParseLimits &l);
 };
@@ -0,0 +1,36 @@
+#pragma once
+#include <limits>
+#include <stddef.h>
+
+/*
+ * Limits on the cost of parsing a single document, given to JSONParser. Every limit defaults to no
+ * limit. Exceeding a limit throws json_limit_error as soon as it is detected: strings and numbers
+ * are checked while they are scanned, everything else when a value or a container begins. The
+ * partially built tree is freed and the tree of the previous parse is kept.
+ */
+struct ParseLimits
+{
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+    // Size of the input in bytes
+    size_t max_bytes = unlimited;
+
+    // Nesting of objects and arrays, a document which is a single scalar has depth 0
+    size_t max_depth = unlimited;
+
+    // Number of values in the document, including objects and arrays but not keys
+    size_t max_nodes = unlimited;
+
+    // Length of a string or key in bytes, after escapes have been decoded
+    size_t max_string_length = unlimited;
+
+    // Length of a number in characters
+    size_t max_number_length = unlimited;
+
+    // Number of members of an object or elements of an array
+    size_t max_container_size = unlimited;
+
+    // Heap memory held by the tree, as JSONObject::memory_usage() counts it. Temporary storage
+    // which is freed before parse() returns is not included
+    size_t max_allocated_bytes = unlimited;
+};
@@ -1,8 +1,14 @@
 #pragma once
 #include "json_exceptions.hpp"
+#include <atomic>
+#include <limits>
 #include <map>
+#include <memory>
+#include <optional>
 #include <stdint.h>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 enum class JSONObjectType : uint8_t
@@ -17,15 +23,182 @@ enum class JSONObjectType : uint8_t
     ARRAY = 7,
 };
 
+// Heap memory held by a tree, returned by JSONObject::memory_usage(). Sizes are the bytes requested
+// from the allocator, the allocator's own headers and rounding are not included
+struct JSONMemoryUsage
+{
+    // Buffers of strings and keys which are too long for the small string buffer
+    size_t strings = 0;
+    // Map nodes of objects, excluding the JSONObject of the value stored in each node
+    size_t objects = 0;
+    // Storage of arrays which is allocated but holds no element
+    size_t arrays = 0;
+    // The JSONObject of every value stored in an object or array
+    size_t nodes = 0;
+    // Reference counted blocks holding the map or vector of non empty objects and arrays
+    size_t shared = 0;
+    // Values of packed arrays, see JSONObject::pack()
+    size_t packed = 0;
+
+    size_t total() const { return strings + objects + arrays + nodes + shared + packed; }
+
+    // Heap bytes of a string with the given capacity, zero if it fits in the small string buffer
+    static size_t string_size(size_t capacity);
+
+    // Bytes of a map node besides the JSONObject of its value, counted in objects
+    static size_t member_size();
+
+    // Bytes of the reference counted block which holds the container of a non empty object or
+    // array, zero for other types
+    static size_t shared_size(JSONObjectType type);
+};
+
+// The container of an object or array, shared between copies of a JSONObject. The structural hash
+// of the contents is computed on the first call to JSONObject::hash() and cleared whenever the
+// container is accessed for modification, zero means that it has not been computed. Once a non
+// const accessor has returned the container, its contents and their children can be changed
+// through the returned reference without passing through the container again, so the hash of an
+// exposed container is never cached
+template <typename T> struct JSONShared
+{
+    T items;
+    mutable std::atomic<uint64_t> hash{0};
+    bool exposed = false;
+
+    JSONShared() = default;
+    JSONShared(const T &items) : items(items) {}
+    JSONShared(T &&items) : items(std::move(items)) {}
+};
+
+struct JSONObject;
+
+// Elements of an array which are all integers (T is int64_t), all reals (long double) or all
+// booleans (bool, stored as bits), stored as plain values instead of a JSONObject each, see
+// JSONObject::pack(). The hash is cached as in JSONShared
+template <typename T> struct JSONPacked
+{
+    std::vector<T> values;
+    mutable std::atomic<uint64_t> hash{0};
+
+    // The JSONObject of every element, built on the first call to the const as_vector() of the
+    // array, so that a packed array can also be read like any other
+    mutable std::atomic<std::vector<JSONObject> *> elements{nullptr};
+
+    JSONPacked() = default;
+    JSONPacked(std::vector<T> &&values) : values(std::move(values)) {}
+    JSONPacked(const JSONPacked &) = delete;
+    JSONPacked &operator=(const JSONPacked &) = delete;
+    ~JSONPacked() { delete elements.load(std::memory_order_acquire); }
+};
+
+// Objects use a transparent comparator so that keys can be looked up with a std::string_view
+// without building a temporary std::string.
+// The const methods never modify the tree, so a tree which is no longer being modified can be read
+// from many threads at once. Note that operator[] inserts a null value for a missing key, use
+// find(), at() or contains() to look up keys without modifying the object.
+//
+// The map of an object and the vector of an array are reference counted and shared between
+// copies, so copying a tree or a subtree takes constant time. The non const accessors (as_vector(),
+// as_kv_pairs() and operator[]) copy a shared container before returning it, so a modification
+// copies only the containers on the path to the modified value and is never seen by other copies.
+// A reference returned by a non const accessor must not be used to modify the container after
+// the object has been copied, take it again instead. Empty containers are not allocated.
+//
+// An array of integers, reals or booleans can be packed, which stores its values without a
+// JSONObject for each of them. Packing is invisible to the accessors: packed() gives direct access
+// to the values, the const as_vector() and at() build the JSONObjects of the elements once, and
+// the non const as_vector() turns the array back into a vector of JSONObjects. element() and
+// for_each_element() read any array without building the JSONObjects of a packed one, and are
+// what the writers, binary formats, diff() and JSONPath use.
+//
+// Two objects are equal if they have the same type and value, integers and reals are never equal
+// to each other. Equality returns at once for containers shared by both objects, and for objects
+// whose hashes have both been computed and differ.
 struct JSONObject
 {
+    using Members = std::map<std::string, JSONObject, std::less<>>;
+    using Elements = std::vector<JSONObject>;
+
     JSONObjectType type;
-    std::variant<std::string, long double, int64_t, std::map<std::string, JSONObject>,
-                 std::vector<JSONObject>, bool>
+    std::variant<std::string, long double, int64_t, std::shared_ptr<JSONShared<Members>>,
+                 std::shared_ptr<JSONShared<Elements>>, bool,
+                 std::shared_ptr<JSONPacked<int64_t>>, std::shared_ptr<JSONPacked<long double>>,
+                 std::shared_ptr<JSONPacked<bool>>>
         value;
 
     JSONObject &operator[](const std::string &s);
 
+    const JSONObject *find(std::string_view key) const;
+
+    const JSONObject &at(std::string_view key) const;
+
+    const JSONObject &at(size_t index) const;
+
+    // Returns a copy of the element at an index, throws an access error if this is not an array or
+    // if the index is out of range. The element of a packed array is built on its own
+    JSONObject element(size_t index) const;
+
+    // Calls f(element) for every element of an array, in order. The elements of a packed array are
+    // passed as temporaries, one at a time, so that reading them does not unpack the array
+    template <typename F> void for_each_element(F &&f) const
+    {
+        if (auto integers = packed<int64_t>())
+        {
+            for (int64_t element : *integers)
+                f(JSONObject(element));
+        }
+        else if (auto reals = packed<long double>())
+        {
+            for (long double element : *reals)
+                f(JSONObject(element));
+        }
+        else if (auto booleans = packed<bool>())
+        {
+            for (bool element : *booleans)
+                f(JSONObject(element));
+        }
+        else
+        {
+            for (auto &element : as_vector())
+                f(element);
+        }
+    }
+
+    bool contains(std::string_view key) const;
+
+    // Returns a pointer to the stored value if it is of type T, otherwise nullptr. T is one of
+    // Members, Elements, std::string, int64_t, long double or bool
+    template <typename T> const T *get_if() const
+    {
+        if constexpr (std::is_same_v<T, Members>)
+            return type == JSONObjectType::OBJECT ? &as_kv_pairs() : nullptr;
+        else if constexpr (std::is_same_v<T, Elements>)
+            return type == JSONObjectType::ARRAY ? &as_vector() : nullptr;
+        else
+        {
+            static_assert(std::is_same_v<T, std::string> || std::is_same_v<T, int64_t> ||
+                              std::is_same_v<T, long double> || std::is_same_v<T, bool>,
+                          "get_if() needs the type of a JSON value");
+            // Null and empty objects also hold a std::string, so the type has to be checked
+            constexpr JSONObjectType expected =
+                std::is_same_v<T, std::string> ? JSONObjectType::STRING
+                : std::is_same_v<T, int64_t>   ? JSONObjectType::NUMBER_INT
+                : std::is_same_v<T, bool>      ? JSONObjectType::BOOLEAN
+                                               : JSONObjectType::NUMBER_REAL;
+            return type == expected ? std::get_if<T>(&value) : nullptr;
+        }
+    }
+
+    // Converts the value to T, throws json_access_error if it cannot be converted.
+    // See json_converter below for the supported types
+    template <typename T> T get() const;
+
+    // Converts the value to T, returns default_value if it cannot be converted
+    template <typename T> T get_or(const T &default_value) const;
+
+    // Converts the value to T, returns std::nullopt if it cannot be converted
+    template <typename T> std::optional<T> try_get() const;
+
     JSONObject();
 
     JSONObject(JSONObjectType type);
@@ -36,8 +209,16 @@ struct JSONObject
 
     JSONObject(const std::string &val);
 
+    JSONObject(std::string &&val);
+
     JSONObject(const std::vector<JSONObject> &val);
 
+    JSONObject(std::vector<JSONObject> &&val);
+
+    JSONObject(const Members &val);
+
+    JSONObject(Members &&val);
+
     JSONObject(bool val);
 
     int64_t &as_integer();
@@ -50,7 +231,263 @@ struct JSONObject
 
     std::string &as_string();
 
-    std::map<std::string, JSONObject> &as_kv_pairs();
+    std::map<std::string, JSONObject, std::less<>> &as_kv_pairs();
+
+    const int64_t &as_integer() const;
+
+    const bool &as_bool() const;
+
+    const long double &as_real() const;
+
+    const std::vector<JSONObject> &as_vector() const;
+
+    const std::string &as_string() const;
+
+    const std::map<std::string, JSONObject, std::less<>> &as_kv_pairs() const;
+
+    size_t size() const;
+
+    // Walks the tree and returns the heap memory it holds, the object itself is not included.
+    // Shared containers are counted every time they are reached, so that apart from the spare
+    // capacity of arrays this is what clone() allocates
+    JSONMemoryUsage memory_usage() const;
+
+    // Returns a copy which shares no container with this object, packed arrays stay packed
+    JSONObject clone() const;
+
+    // Stores the elements of this array as plain values if they are all integers, all reals or
+    // all booleans, which takes 8 bytes per integer, 16 per real and one bit per boolean instead of
+    // sizeof(JSONObject). Returns false, leaving the array as it is, if it is empty or if its
+    // elements are of any other or of mixed types
+    bool pack();
 
-    size_t size();
-};
\ No newline at end of file
+    // Returns the type of the elements of a packed array, or EMPTY if this is not a packed array
+    JSONObjectType packed_type() const;
+
+    // Returns the values of an array packed with elements of type T (int64_t, long double or
+    // bool), or nullptr if this is not such an array. The values can be read in place
+    template <typename T> const std::vector<T> *packed() const
+    {
+        auto storage = std::get_if<std::shared_ptr<JSONPacked<T>>>(&value);
+        return storage ? &(*storage)->values : nullptr;
+    }
+
+    // Structural hash of the value, equal objects have equal hashes. The hash of an object or array
+    // is cached, so it is computed once for each container until the container is modified, except
+    // for the containers which a non const accessor has returned. The trees built by the parsers,
+    // the decoders and clone() cache the hashes of all their containers
+    size_t hash() const;
+
+    // Returns the cached hash, or nullopt if the hash of this object has not been computed
+    std::optional<size_t> cached_hash() const;
+};
+
+bool operator==(const JSONObject &a, const JSONObject &b);
+
+bool operator!=(const JSONObject &a, const JSONObject &b);
+
+// Allows trees and subtrees to be used as keys of unordered containers
+template <> struct std::hash<JSONObject>
+{
+    size_t operator()(const JSONObject &ob) const { return ob.hash(); }
+};
+
+/*
+ * json_converter<T>::convert(ob, out) converts ob to T and stores it in out, returning false if ob
+ * does not hold a value which can be represented as T. The conversion is picked at compile time,
+ * so that get<T>() on a matching type costs a single type check.
+ * Conversion rules:
+ *  - bool only from true/false
+ *  - integral types only from integers, and only if the value fits in the type
+ *  - floating point types from integers and from reals, reals only if they are within the finite
+ *    range of the type. Reals are never converted to integers
+ *  - std::string and std::string_view from strings, the view points into the tree
+ *  - std::vector<T> from arrays whose every element converts to T
+ *  - std::optional<T> is empty for null, otherwise converts to T
+ * To support a user type, specialize json_converter for it with a static convert() method.
+ */
+template <typename T, typename Enable = void> struct json_converter;
+
+template <> struct json_converter<bool>
+{
+    static bool convert(const JSONObject &ob, bool &out)
+    {
+        auto p = std::get_if<bool>(&ob.value);
+        if (!p)
+            return false;
+        out = *p;
+        return true;
+    }
+};
+
+template <typename T>
+struct json_converter<
+    T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    static bool convert(const JSONObject &ob, T &out)
+    {
+        auto p = std::get_if<int64_t>(&ob.value);
+        if (!p)
+            return false;
+        if constexpr (std::is_signed_v<T>)
+        {
+            if constexpr (sizeof(T) < sizeof(int64_t))
+            {
+                if (*p < std::numeric_limits<T>::min() || *p > std::numeric_limits<T>::max())
+                    return false;
+            }
+        }
+        else
+        {
+            if (*p < 0)
+                return false;
+            if constexpr (sizeof(T) < sizeof(int64_t))
+            {
+                if (static_cast<uint64_t>(*p) > std::numeric_limits<T>::max())
+                    return false;
+            }
+        }
+        out = static_cast<T>(*p);
+        return true;
+    }
+};
+
+template <typename T> struct json_converter<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static bool convert(const JSONObject &ob, T &out)
+    {
+        if (auto real = std::get_if<long double>(&ob.value))
+        {
+            if constexpr (sizeof(T) < sizeof(long double))
+            {
+                if (*real < std::numeric_limits<T>::lowest() ||
+                    *real > std::numeric_limits<T>::max())
+                    return false;
+            }
+            out = static_cast<T>(*real);
+            return true;
+        }
+        if (auto integer = std::get_if<int64_t>(&ob.value))
+        {
+            out = static_cast<T>(*integer);
+            return true;
+        }
+        return false;
+    }
+};
+
+template <> struct json_converter<std::string>
+{
+    static bool convert(const JSONObject &ob, std::string &out)
+    {
+        // An empty or null object also holds a std::string, so the type has to be checked
+        if (ob.type != JSONObjectType::STRING)
+            return false;
+        out = *std::get_if<std::string>(&ob.value);
+        return true;
+    }
+};
+
+template <> struct json_converter<std::string_view>
+{
+    static bool convert(const JSONObject &ob, std::string_view &out)
+    {
+        if (ob.type != JSONObjectType::STRING)
+            return false;
+        out = *std::get_if<std::string>(&ob.value);
+        return true;
+    }
+};
+
+template <> struct json_converter<JSONObject>
+{
+    static bool convert(const JSONObject &ob, JSONObject &out)
+    {
+        out = ob;
+        return true;
+    }
+};
+
+template <typename T> struct json_converter<std::vector<T>>
+{
+    // Converts the values of a packed array without building their JSONObjects
+    template <typename V>
+    static bool convert_values(const std::vector<V> &values, std::vector<T> &out)
+    {
+        std::vector<T> result(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            // Converted through a local, as the elements of a std::vector<bool> are proxies
+            T value{};
+            if (!json_converter<T>::convert(JSONObject(static_cast<V>(values[i])), value))
+                return false;
+            result[i] = std::move(value);
+        }
+        out = std::move(result);
+        return true;
+    }
+
+    static bool convert(const JSONObject &ob, std::vector<T> &out)
+    {
+        if (auto integers = ob.packed<int64_t>())
+            return convert_values(*integers, out);
+        if (auto reals = ob.packed<long double>())
+            return convert_values(*reals, out);
+        if (auto booleans = ob.packed<bool>())
+            return convert_values(*booleans, out);
+        auto elements = ob.get_if<std::vector<JSONObject>>();
+        if (!elements)
+            return false;
+        std::vector<T> result(elements->size());
+        for (size_t i = 0; i < elements->size(); i++)
+        {
+            T value{};
+            if (!json_converter<T>::convert((*elements)[i], value))
+                return false;
+            result[i] = std::move(value);
+        }
+        out = std::move(result);
+        return true;
+    }
+};
+
+template <typename T> struct json_converter<std::optional<T>>
+{
+    static bool convert(const JSONObject &ob, std::optional<T> &out)
+    {
+        if (ob.type == JSONObjectType::NULL_VALUE)
+        {
+            out.reset();
+            return true;
+        }
+        T result;
+        if (!json_converter<T>::convert(ob, result))
+            return false;
+        out = std::move(result);
+        return true;
+    }
+};
+
+template <typename T> T JSONObject::get() const
+{
+    T result{};
+    if (!json_converter<T>::convert(*this, result))
+        throw json_access_error("Value cannot be converted to the requested type");
+    return result;
+}
+
+template <typename T> T JSONObject::get_or(const T &default_value) const
+{
+    T result{};
+    if (!json_converter<T>::convert(*this, result))
+        return default_value;
+    return result;
+}
+
+template <typename T> std::optional<T> JSONObject::try_get() const
+{
+    T result{};
+    if (!json_converter<T>::convert(*this, result))
+        return std::nullopt;
+    return result;
+}
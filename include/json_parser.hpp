@@ -1,44 +1,124 @@
 #pragma once
 #include "json_lexer.hpp"
 #include "json_object.hpp"
-#include <stack>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
 
 /*
  * This class implements the parser logic for parsing JSON.
  * It contains a JSONObject root, which represents the root of the parsed tree, and a Lexer object
  * which is used to obtain tokens from the input string. This parser is a recursive descent parser.
- * TODO: Improve error messages, also add an option to specify recursion depth
+ * The cost of parsing a document can be bounded with ParseLimits, see json_limits.hpp
+ *
+ * A parser can be reused for any number of documents. The input buffer, the token and container
+ * stacks and the scratch string of the lexer keep their capacity between calls to parse(), so
+ * that parsing a document no larger than the ones before only allocates the new tree. Each parse
+ * which succeeds releases the previous tree, use take_tree() to keep it
 */
+
+// Compares the objects and arrays of a document for deduplication. Their children have been
+// interned already, so a child object or array only matches the same container. Reals are compared
+// with their sign, unlike operator==, so that deduplication never turns -0.0 into 0.0
+struct JSONInternEqual
+{
+    bool operator()(const JSONObject &a, const JSONObject &b) const;
+};
+
 class JSONParser
 {
     JSONObject root;
     JSONLexer lexer;
-    std::stack<Token> tokens;
+    // Tokens which have been peeked but not consumed
+    std::vector<Token> tokens;
+
+    // Members and elements of the objects and arrays being parsed, the innermost container's are
+    // at the end. They are moved into the container when it is closed
+    std::vector<std::pair<std::string, JSONObject>> members;
+    std::vector<JSONObject> elements;
+    ParseStats statistics;
+
+    ParseLimits limits;
+
+    // Number of objects and arrays enclosing the value being parsed
+    size_t depth;
+
+    // Values parsed and heap bytes held by them so far, checked against the limits
+    size_t nodes;
+    size_t allocated;
+
+    bool check_utf8;
+
+    // Objects and arrays of the document being parsed, when deduplication is enabled
+    bool deduplicate;
+    std::unordered_set<JSONObject, std::hash<JSONObject>, JSONInternEqual> interned;
+
+    // Whether arrays of integers, reals or booleans are packed, see JSONObject::pack()
+    bool pack_arrays;
 
     Token next();
 
-    Token peek();
+    const Token &peek();
 
     JSONObject parse_value();
 
-    std::pair<std::string, JSONObject> parse_pair();
+    void parse_pair();
 
-    std::vector<std::pair<std::string, JSONObject>> parse_pairs();
+    size_t parse_pairs();
 
     JSONObject parse_object();
 
-    std::vector<JSONObject> parse_elements();
+    size_t parse_elements();
 
     JSONObject parse_array();
 
+    JSONObject intern(JSONObject &&ob);
+
+    void discard();
+
+    void count_string(size_t length);
+
+    void enter_container(size_t offset);
+
+    void check_container_size(size_t size, size_t offset);
+
+    void allocate(size_t bytes, size_t offset);
+
+    void leave_object(size_t size);
+
+    void leave_array(size_t size);
+
+    // Gives the microbenchmarks access to the token stack
+    friend struct JSONParserBench;
+
   public:
     JSONParser();
 
     JSONParser(const std::string &buffer);
 
+    JSONParser(const ParseLimits &limits);
+
+    void set_limits(const ParseLimits &limits);
+
     void parse();
 
-    void parse(const std::string &buffer);
+    void parse(std::string_view buffer);
+
+    bool validate(std::string_view buffer) const;
 
     JSONObject &get_tree();
+
+    const JSONObject &get_tree() const;
+
+    JSONObject take_tree();
+
+    SourceLocation location(size_t offset) const;
+
+    const ParseStats &stats() const;
+
+    void set_validate_utf8(bool enabled);
+
+    void set_deduplicate(bool enabled);
+
+    void set_pack_arrays(bool enabled);
 };
\ No newline at end of file
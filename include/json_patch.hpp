@@ -0,0 +1,35 @@
+#pragma once
+#include "json_object.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * JSON Patch (RFC 6902) between two trees. A patch is an array of operation objects, each with an
+ * "op", a "path" given as a JSON Pointer (RFC 6901) and, for add and replace, a "value".
+ */
+
+// Appends the JSON Pointer reference token for key to path, escaping "~" and "/"
+void json_pointer_append(std::string &path, std::string_view key);
+
+// Returns the operations which turn from into to, using only add, remove and replace. Equal
+// subtrees are skipped by their structural hashes and objects are compared key by key. Arrays are
+// aligned with a longest common subsequence of their elements, after removing their common prefix
+// and suffix. If the remaining parts of the two arrays have more than max_array_cost pairs of
+// elements, the elements are compared index by index instead, which keeps the time and memory
+// bounded at the cost of a longer patch
+JSONObject diff(const JSONObject &from, const JSONObject &to, size_t max_array_cost = 1 << 20);
+
+// Applies a patch to doc in place. Values removed by remove, replace and move are moved rather than
+// copied, and values added from the patch share its objects and arrays. Either every operation is
+// applied, or the first failing one throws json_patch_error and doc is restored as it was, by
+// undoing the operations applied before it
+void apply_patch(JSONObject &doc, const JSONObject &patch);
+
+// Applies several patches in order as a single one, i.e. all of them or none. Operations are
+// numbered across all the patches in json_patch_error::operation()
+void apply_patches(JSONObject &doc, const std::vector<JSONObject> &patches);
+
+// Applies a JSON Merge Patch (RFC 7386) to doc in place: members of patch replace those of doc,
+// recursively for objects, and null members remove them. A merge patch cannot fail
+void apply_merge_patch(JSONObject &doc, const JSONObject &patch);
@@ -0,0 +1,120 @@
+#pragma once
+#include "json_object.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/*
+ * Compiled JSONPath queries. The supported subset is:
+ *   $                   the root, which every query starts with
+ *   .name  ['name']     a member of an object, ['a', 'b'] selects several members
+ *   [2]  [-1]  [0, 3]   elements of an array, negative indices count from the end
+ *   [1:5]  [:2]  [::2]  a slice of an array as in Python, the step must be positive
+ *   .*  [*]             every member or element
+ *   ..name  ..[0]  ..*  the selector which follows, applied to the value and all its descendants
+ *   [?(filter)]         every member or element for which the filter is true
+ * A filter compares values below the member or element, written @.name, @['name'] or @[0], or the
+ * member or element itself, written @, with literals (numbers, 'strings', "strings", true, false
+ * and null) or with each other using == != < <= > >=, or tests that such a value exists. Conditions
+ * are combined with && || and !, and grouped with parentheses. A value which does not exist is
+ * only equal to another one which does not exist, and order is only defined between two numbers or
+ * two strings.
+ *
+ * A union such as ['a', 'b'] or [0, -1] selects each member or element at most once, even if it
+ * names it several times, and in the order of the object or array rather than of the union.
+ *
+ * A query is compiled once into a list of steps, and can then be run any number of times and from
+ * any number of threads. On a tree, the members of an object are visited in key order, as the tree
+ * keeps them; on text they are visited in document order.
+ */
+
+// A step of the path of a filter operand, i.e. a member name or an element index
+using JSONPathKey = std::variant<std::string, int64_t>;
+
+struct JSONPathOperand
+{
+    bool is_path = false;
+    std::vector<JSONPathKey> path;
+    JSONObject literal;
+};
+
+struct JSONPathFilter
+{
+    enum class Kind : uint8_t
+    {
+        OR,
+        AND,
+        NOT,
+        EXISTS,
+        COMPARE,
+    };
+
+    enum class Compare : uint8_t
+    {
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+    };
+
+    Kind kind;
+    Compare compare = Compare::EQ;
+    // Operands of a comparison, EXISTS uses only left
+    JSONPathOperand left;
+    JSONPathOperand right;
+    // Conditions combined by OR, AND and NOT, as indices of JSONPath::filters
+    size_t first = 0;
+    size_t second = 0;
+};
+
+struct JSONPathStep
+{
+    enum class Kind : uint8_t
+    {
+        NAMES,
+        INDICES,
+        SLICE,
+        WILDCARD,
+        FILTER,
+    };
+
+    Kind kind;
+    bool descendant = false;
+    std::vector<std::string> names;
+    std::vector<int64_t> indices;
+    std::optional<int64_t> start;
+    std::optional<int64_t> end;
+    int64_t step = 1;
+    // Root condition of FILTER, as an index of JSONPath::filters
+    size_t filter = 0;
+};
+
+class JSONPath
+{
+    std::string source;
+    std::vector<JSONPathStep> steps;
+    std::vector<JSONPathFilter> filters;
+
+    friend class JSONPathCompiler;
+    friend class JSONPathEvaluator;
+
+  public:
+    // Compiles a query, throws json_parse_error with the offset in expression if it is invalid
+    explicit JSONPath(std::string_view expression);
+
+    // Returns the values of a tree matched by the query, which point into root. Filters read the
+    // elements of packed arrays in place, but an array whose elements are selected builds them
+    std::vector<const JSONObject *> select(const JSONObject &root) const;
+
+    // Returns the values matched by the query in a JSON document, without parsing the document.
+    // Only the matched values, and the members or elements tested by a filter, are parsed. The
+    // rest is skipped by matching brackets and quotes, so errors in a skipped region may not be
+    // detected, while errors in a parsed value throw json_parse_error
+    std::vector<JSONObject> select_text(std::string_view document) const;
+
+    const std::string &expression() const;
+};
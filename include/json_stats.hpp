@@ -0,0 +1,57 @@
+#pragma once
+#include "token.hpp"
+#include <array>
+#include <stdint.h>
+
+/*
+ * Statistics collected while parsing a single document, returned by JSONParser::stats().
+ * Collection is compiled in only when the library is built with JSONPARSER_STATS defined (the
+ * meson option -Dstats=true), otherwise nothing is recorded and enabled is false.
+ *
+ * The *_cycles fields count processor timestamp ticks on x86 and the virtual counter on ARM64,
+ * and nanoseconds elsewhere. Only the relative size of the stages is meaningful.
+ */
+struct ParseStats
+{
+    bool enabled;
+
+    // Number of tokens of each type, indexed by Token::Type
+    std::array<uint64_t, static_cast<size_t>(Token::Type::UNKNOWN) + 1> tokens;
+
+    // Bytes of input consumed by strings (including quotes), numbers, literals and whitespace
+    uint64_t string_bytes;
+    uint64_t number_bytes;
+    uint64_t literal_bytes;
+    uint64_t whitespace_bytes;
+
+    // Number of escape sequences within strings
+    uint64_t escapes;
+
+    // Deepest nesting of objects and arrays, a document which is a single scalar has depth 0
+    uint64_t max_depth;
+
+    uint64_t objects;
+    uint64_t arrays;
+    uint64_t object_members;
+    uint64_t array_elements;
+    uint64_t max_object_size;
+    uint64_t max_array_size;
+
+    // Heap allocations made for the tree: one for each object member, one for the shared block of
+    // each non empty object, two for each non empty array (its storage and its shared block), and
+    // one for each string or key too long for the small string buffer
+    uint64_t allocations;
+
+    uint64_t whitespace_cycles;
+    uint64_t string_cycles;
+    uint64_t number_cycles;
+    uint64_t literal_cycles;
+    // The whole parse, the time spent building the tree is this minus the lexing stages
+    uint64_t total_cycles;
+
+    ParseStats();
+
+    void reset();
+
+    uint64_t token_count(Token::Type type) const;
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ * UTF-8 helpers used by the lexer, for \u escapes and for validating the input.
+ */
+
+// Appends the UTF-8 encoding of a code point, which must not be a surrogate
+void json_utf8_append(std::string &out, uint32_t code_point);
+
+// Returns the offset of the first byte which does not start a well formed UTF-8 sequence, or size
+// if all of data is valid. Overlong encodings, surrogates and code points above U+10FFFF are
+// invalid. Runs of ASCII are checked 16 bytes at a time with SSE2 or NEON where available
+size_t json_validate_utf8(const char *data, size_t size);
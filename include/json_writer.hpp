@@ -0,0 +1,49 @@
+#pragma once
+#include "json_object.hpp"
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+ * Functions which append JSON text to an output buffer. They never clear the buffer, so one
+ * std::string can be reused for many documents without reallocating.
+ */
+
+// Appends s as a quoted JSON string, escaping quotes, backslashes and control characters
+void json_write_string(std::string &out, std::string_view s);
+
+void json_write_integer(std::string &out, int64_t value);
+
+void json_write_unsigned(std::string &out, uint64_t value);
+
+// Appends the shortest representation which reads back to the same value. A real number always
+// contains a decimal point or an exponent, so that it is not read back as an integer.
+// NaN and infinity cannot be represented in JSON, they are written as null
+void json_write_real(std::string &out, long double value);
+
+void json_write_real(std::string &out, double value);
+
+// Appends the compact JSON text of a tree
+void json_write_tree(std::string &out, const JSONObject &ob);
+
+// Returns the compact JSON text of a tree
+std::string to_json(const JSONObject &ob);
+
+/*
+ * Reformat JSON text without parsing it into a tree. The input is checked as it is copied, with
+ * the same rules as JSONParser::parse(), and strings, numbers and literals are copied byte for
+ * byte. Invalid input throws json_parse_error, in which case out is left as it was. The stream
+ * versions write the output in blocks, so that it is never held in memory as a whole, and leave
+ * what was written before the error in the stream.
+ */
+
+// Removes all whitespace between tokens
+void minify(std::string_view in, std::string &out);
+
+void minify(std::string_view in, std::ostream &out);
+
+// Puts every member and element on its own line, indented by indent spaces per level of nesting.
+// Empty objects and arrays are written as {} and []
+void prettify(std::string_view in, std::string &out, size_t indent = 4);
+
+void prettify(std::string_view in, std::ostream &out, size_t indent = 4);
@@ -33,6 +33,9 @@ class Token
 
     bool is_value_present;
 
+    // Byte offset of the first character of this token in the input buffer
+    size_t offset;
+
     std::variant<std::string, int64_t, long double> value;
 
     // Default constructor, which initializes the type to UNKNOWN
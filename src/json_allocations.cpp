@@ -0,0 +1,74 @@
+#include "json_allocations.hpp"
+#include <cstdlib>
+#include <new>
+
+// Allocations of each thread, kept as plain integers so that no initialization is needed before the
+// first allocation of a thread
+static thread_local uint64_t allocation_count = 0;
+static thread_local uint64_t allocation_bytes = 0;
+static thread_local uint64_t release_count = 0;
+
+static void *counted_allocate(size_t size)
+{
+    allocation_count++;
+    allocation_bytes += size;
+    // malloc(0) may return nullptr, but operator new must return a unique pointer
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+    void *p = counted_allocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    void *p = counted_allocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return counted_allocate(size); }
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size);
+}
+
+static void counted_free(void *p)
+{
+    if (p)
+        release_count++;
+    std::free(p);
+}
+
+void operator delete(void *p) noexcept { counted_free(p); }
+
+void operator delete[](void *p) noexcept { counted_free(p); }
+
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { counted_free(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept { counted_free(p); }
+
+JSONAllocationCounter::JSONAllocationCounter() { reset(); }
+
+uint64_t JSONAllocationCounter::count() const { return allocation_count - start_count; }
+
+uint64_t JSONAllocationCounter::bytes() const { return allocation_bytes - start_bytes; }
+
+uint64_t JSONAllocationCounter::releases() const { return release_count - start_releases; }
+
+void JSONAllocationCounter::reset()
+{
+    start_count = allocation_count;
+    start_bytes = allocation_bytes;
+    start_releases = release_count;
+}
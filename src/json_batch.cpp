@@ -0,0 +1,149 @@
+#include "json_batch.hpp"
+#include <algorithm>
+
+/// Starts threads - 1 workers, the thread which calls parse() is the last one. With a single
+/// thread the documents are parsed by the caller and no thread is started
+JSONBatchParser::JSONBatchParser(size_t threads)
+    : generation(0), active(0), stopping(false), documents(nullptr), count(0), block(1),
+      callback(nullptr), next(0), failed(false)
+{
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++)
+        parsers.push_back(std::make_unique<JSONParser>());
+    for (size_t i = 1; i < threads; i++)
+        workers.emplace_back(&JSONBatchParser::work, this, i);
+}
+
+JSONBatchParser::~JSONBatchParser()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+/// Waits for a batch, takes part in it and waits for the next one, until the pool is destroyed
+void JSONBatchParser::work(size_t worker)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        run(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+                finished.notify_all();
+        }
+    }
+}
+
+/// Takes blocks of documents until there are none left, parsing them with the worker's parser.
+/// A document which cannot be parsed gets its error in its result, any other exception stops
+/// the batch
+void JSONBatchParser::run(size_t worker)
+{
+    JSONParser &parser = *parsers[worker];
+    try
+    {
+        while (!failed.load(std::memory_order_relaxed))
+        {
+            size_t first = next.fetch_add(block, std::memory_order_relaxed);
+            if (first >= count)
+                break;
+            size_t last = std::min(first + block, count);
+            for (size_t i = first; i < last; i++)
+            {
+                JSONBatchResult result;
+                try
+                {
+                    parser.parse(documents[i]);
+                    result.tree = parser.take_tree();
+                }
+                catch (const json_parse_error &e)
+                {
+                    result.error = e;
+                }
+                (*callback)(i, result);
+            }
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+            error = std::current_exception();
+        failed = true;
+    }
+}
+
+size_t JSONBatchParser::threads() const { return parsers.size(); }
+
+void JSONBatchParser::set_limits(const ParseLimits &limits)
+{
+    for (auto &parser : parsers)
+        parser->set_limits(limits);
+}
+
+void JSONBatchParser::set_validate_utf8(bool enabled)
+{
+    for (auto &parser : parsers)
+        parser->set_validate_utf8(enabled);
+}
+
+void JSONBatchParser::set_deduplicate(bool enabled)
+{
+    for (auto &parser : parsers)
+        parser->set_deduplicate(enabled);
+}
+
+void JSONBatchParser::set_pack_arrays(bool enabled)
+{
+    for (auto &parser : parsers)
+        parser->set_pack_arrays(enabled);
+}
+
+/// Parses the documents into a vector of results, every thread moves its results to their slots
+std::vector<JSONBatchResult> JSONBatchParser::parse(const std::vector<std::string_view> &input)
+{
+    std::vector<JSONBatchResult> results(input.size());
+    parse(input,
+          [&results](size_t index, JSONBatchResult &result) { results[index] = std::move(result); });
+    return results;
+}
+
+/// Publishes the batch to the workers, parses with them and waits until all of them are done.
+/// Blocks are small enough for the threads to even out documents of different sizes, and large
+/// enough that the shared counter is not contended
+void JSONBatchParser::parse(const std::vector<std::string_view> &input,
+                            const std::function<void(size_t, JSONBatchResult &)> &f)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        documents = input.data();
+        count = input.size();
+        block = std::clamp<size_t>(count / (parsers.size() * 8), 1, 64);
+        callback = &f;
+        next = 0;
+        failed = false;
+        error = nullptr;
+        active = workers.size();
+        generation++;
+    }
+    started.notify_all();
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return active == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,812 @@
+#include "json_binary.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Nesting depth beyond which decoding is rejected, so that hostile input cannot exhaust memory
+static const size_t max_binary_depth = 1024;
+
+static const size_t unlimited = std::numeric_limits<size_t>::max();
+
+// Thrown internally when a streamed item is not complete yet
+struct binary_incomplete
+{
+    size_t needed;
+};
+
+// Returns true if both values are equal, without tripping -Wfloat-equal
+static bool same_value(long double a, long double b) { return !(a < b) && !(a > b); }
+
+static void write_big_endian(std::vector<uint8_t> &out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i > 0; i--)
+        out.push_back(static_cast<uint8_t>(value >> (8 * (i - 1))));
+}
+
+template <typename T> static uint64_t bits_of(T value)
+{
+    static_assert(sizeof(T) <= sizeof(uint64_t), "value too large");
+    if constexpr (sizeof(T) == 4)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    else
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+}
+
+/// @brief Reads big endian values from a block of memory, and reports truncated input.
+/// When streaming, running out of input throws binary_incomplete instead of an error.
+/// Offsets in errors are pos plus base, which is the number of bytes dropped from the start of a
+/// stream. Reading past limit, the end of an item of max_item bytes, throws json_limit_error.
+struct BinaryReader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool streaming;
+    size_t base;
+    size_t limit;
+    size_t max_item;
+
+    void require(size_t n)
+    {
+        if (size - pos >= n && limit - pos >= n)
+            return;
+        if (limit - pos < n)
+            throw too_large(pos);
+        if (streaming)
+            throw binary_incomplete{pos + n};
+        throw error("Unexpected end of input", pos);
+    }
+
+    uint8_t byte()
+    {
+        require(1);
+        return data[pos++];
+    }
+
+    uint64_t big_endian(size_t bytes)
+    {
+        require(bytes);
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++)
+            value = (value << 8) | data[pos++];
+        return value;
+    }
+
+    // Reads a string of length bytes, whose head starts at offset
+    std::string string(uint64_t length, size_t offset)
+    {
+        if (length > limit - pos)
+            throw too_large(offset);
+        if (length > size - pos)
+        {
+            if (streaming)
+                throw binary_incomplete{pos + static_cast<size_t>(length)};
+            throw error("Unexpected end of input", pos);
+        }
+        std::string s(reinterpret_cast<const char *>(data + pos), static_cast<size_t>(length));
+        pos += static_cast<size_t>(length);
+        return s;
+    }
+
+    // Every element takes at least one byte, so no more than the remaining bytes are reserved
+    size_t reserve_hint(uint64_t count) const
+    {
+        return static_cast<size_t>(count < size - pos ? count : size - pos);
+    }
+
+    json_parse_error error(const std::string &message, size_t offset) const
+    {
+        return json_parse_error(message, base + offset, "");
+    }
+
+    json_limit_error too_large(size_t offset) const
+    {
+        return json_limit_error("max_item_size", max_item, base + offset);
+    }
+};
+
+/// Opens an array or map of count items, or of items up to a break byte if indefinite. Every item
+/// takes at least a byte, so a count which cannot fit in the item size limit is rejected at once
+static void open_container(BinaryReader &reader, std::vector<BinaryFrame> &frames, bool is_map,
+                           bool indefinite, uint64_t count, size_t offset)
+{
+    if (!indefinite && reader.max_item != unlimited &&
+        count > (reader.limit - reader.pos) / (is_map ? 2 : 1))
+        throw reader.too_large(offset);
+    frames.emplace_back();
+    auto &frame = frames.back();
+    frame.is_map = is_map;
+    frame.indefinite = indefinite;
+    frame.remaining = count;
+    frame.has_key = false;
+    if (!is_map && !indefinite)
+        frame.elements.reserve(reader.reserve_hint(count));
+}
+
+/// Decodes items until the outermost one is complete, keeping the containers which are open in
+/// frames instead of on the call stack. Each step decodes a whole scalar, key, container head or
+/// container end, and commit is set to the position before it, so that decoding which runs out of
+/// input can resume from commit with the same frames. item(reader, frames, value) decodes a scalar
+/// into value and returns true, or opens a container and returns false. key(reader) decodes a key,
+/// is_break(reader) consumes the end of an indefinite container if it is next
+template <typename Item, typename Key, typename IsBreak>
+static JSONObject decode_items(BinaryReader &reader, std::vector<BinaryFrame> &frames,
+                               size_t &commit, const char *too_deep, Item item, Key key,
+                               IsBreak is_break)
+{
+    while (true)
+    {
+        commit = reader.pos;
+        JSONObject value;
+        if (!frames.empty() && !frames.back().has_key &&
+            (frames.back().indefinite ? is_break(reader) : frames.back().remaining == 0))
+        {
+            auto &frame = frames.back();
+            value = frame.is_map ? JSONObject(std::move(frame.pairs))
+                                 : JSONObject(std::move(frame.elements));
+            frames.pop_back();
+        }
+        else if (!frames.empty() && frames.back().is_map && !frames.back().has_key)
+        {
+            frames.back().key = key(reader);
+            frames.back().has_key = true;
+            continue;
+        }
+        else
+        {
+            if (frames.size() > max_binary_depth)
+                throw reader.error(too_deep, reader.pos);
+            if (!item(reader, frames, value))
+                continue;
+        }
+
+        if (frames.empty())
+            return value;
+        auto &parent = frames.back();
+        if (parent.is_map)
+        {
+            parent.pairs[std::move(parent.key)] = std::move(value);
+            parent.has_key = false;
+        }
+        else
+        {
+            parent.elements.push_back(std::move(value));
+        }
+        if (!parent.indefinite)
+            parent.remaining--;
+    }
+}
+
+static double half_to_double(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+    if (exponent == 0)
+        value = std::ldexp(mantissa, -24);
+    else if (exponent != 31)
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    else
+        value = mantissa == 0 ? HUGE_VAL : NAN;
+    return half & 0x8000 ? -value : value;
+}
+
+static float float_from_bits(uint64_t bits)
+{
+    uint32_t narrow = static_cast<uint32_t>(bits);
+    float value;
+    std::memcpy(&value, &narrow, sizeof(value));
+    return value;
+}
+
+static double double_from_bits(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*
+ * CBOR
+ */
+
+static void cbor_head(std::vector<uint8_t> &out, uint8_t major, uint64_t argument)
+{
+    uint8_t type = static_cast<uint8_t>(major << 5);
+    if (argument < 24)
+        out.push_back(static_cast<uint8_t>(type | argument));
+    else if (argument <= 0xFF)
+    {
+        out.push_back(type | 24);
+        write_big_endian(out, argument, 1);
+    }
+    else if (argument <= 0xFFFF)
+    {
+        out.push_back(type | 25);
+        write_big_endian(out, argument, 2);
+    }
+    else if (argument <= 0xFFFFFFFF)
+    {
+        out.push_back(type | 26);
+        write_big_endian(out, argument, 4);
+    }
+    else
+    {
+        out.push_back(type | 27);
+        write_big_endian(out, argument, 8);
+    }
+}
+
+void to_cbor(const JSONObject &ob, std::vector<uint8_t> &out)
+{
+    switch (ob.type)
+    {
+    case JSONObjectType::NUMBER_INT:
+    {
+        int64_t value = ob.as_integer();
+        if (value >= 0)
+            cbor_head(out, 0, static_cast<uint64_t>(value));
+        else
+            cbor_head(out, 1, static_cast<uint64_t>(-(value + 1)));
+        break;
+    }
+    case JSONObjectType::NUMBER_REAL:
+    {
+        long double value = ob.as_real();
+        double wide = static_cast<double>(value);
+        float narrow = static_cast<float>(wide);
+        if (same_value(narrow, wide))
+        {
+            out.push_back(0xFA);
+            write_big_endian(out, bits_of(narrow), 4);
+        }
+        else
+        {
+            out.push_back(0xFB);
+            write_big_endian(out, bits_of(wide), 8);
+        }
+        break;
+    }
+    case JSONObjectType::STRING:
+    {
+        auto &s = ob.as_string();
+        cbor_head(out, 3, s.size());
+        out.insert(out.end(), s.begin(), s.end());
+        break;
+    }
+    case JSONObjectType::BOOLEAN:
+        out.push_back(ob.as_bool() ? 0xF5 : 0xF4);
+        break;
+    case JSONObjectType::ARRAY:
+    {
+        cbor_head(out, 4, ob.size());
+        ob.for_each_element([&out](const JSONObject &element) { to_cbor(element, out); });
+        break;
+    }
+    case JSONObjectType::OBJECT:
+    {
+        auto &pairs = ob.as_kv_pairs();
+        cbor_head(out, 5, pairs.size());
+        for (auto &pair : pairs)
+        {
+            cbor_head(out, 3, pair.first.size());
+            out.insert(out.end(), pair.first.begin(), pair.first.end());
+            to_cbor(pair.second, out);
+        }
+        break;
+    }
+    default:
+        out.push_back(0xF6);
+        break;
+    }
+}
+
+std::vector<uint8_t> to_cbor(const JSONObject &ob)
+{
+    std::vector<uint8_t> out;
+    to_cbor(ob, out);
+    return out;
+}
+
+// Reads the argument of a head with the given additional information, 31 (indefinite length)
+// is returned as UINT64_MAX
+static uint64_t cbor_argument(BinaryReader &reader, uint8_t info, size_t offset)
+{
+    if (info < 24)
+        return info;
+    if (info == 24)
+        return reader.big_endian(1);
+    if (info == 25)
+        return reader.big_endian(2);
+    if (info == 26)
+        return reader.big_endian(4);
+    if (info == 27)
+        return reader.big_endian(8);
+    if (info == 31)
+        return UINT64_MAX;
+    throw reader.error("Invalid CBOR additional information", offset);
+}
+
+static bool cbor_is_break(BinaryReader &reader)
+{
+    reader.require(1);
+    if (reader.data[reader.pos] != 0xFF)
+        return false;
+    reader.pos++;
+    return true;
+}
+
+static std::string cbor_text(BinaryReader &reader, uint8_t info, size_t offset)
+{
+    uint64_t length = cbor_argument(reader, info, offset);
+    if (info != 31)
+        return reader.string(length, offset);
+    // Indefinite length strings are made of definite length chunks of the same major type
+    std::string result;
+    while (!cbor_is_break(reader))
+    {
+        size_t chunk_offset = reader.pos;
+        uint8_t head = reader.byte();
+        if (head >> 5 != 3 || (head & 0x1F) == 31)
+            throw reader.error("Invalid CBOR string chunk", chunk_offset);
+        result += reader.string(cbor_argument(reader, head & 0x1F, chunk_offset), chunk_offset);
+    }
+    return result;
+}
+
+/// Decodes a CBOR item which is neither an array, a map nor a tag
+static JSONObject cbor_scalar(BinaryReader &reader, uint8_t head, size_t offset)
+{
+    uint8_t major = head >> 5;
+    uint8_t info = head & 0x1F;
+    switch (major)
+    {
+    case 0:
+    {
+        uint64_t value = cbor_argument(reader, info, offset);
+        if (info == 31)
+            throw reader.error("Invalid CBOR integer", offset);
+        if (value > static_cast<uint64_t>(INT64_MAX))
+            return JSONObject(static_cast<long double>(value));
+        return JSONObject(static_cast<int64_t>(value));
+    }
+    case 1:
+    {
+        uint64_t value = cbor_argument(reader, info, offset);
+        if (info == 31)
+            throw reader.error("Invalid CBOR integer", offset);
+        if (value > static_cast<uint64_t>(INT64_MAX))
+            return JSONObject(-1.0L - static_cast<long double>(value));
+        return JSONObject(-1 - static_cast<int64_t>(value));
+    }
+    case 3:
+        return JSONObject(cbor_text(reader, info, offset));
+    case 7:
+        switch (info)
+        {
+        case 20:
+            return JSONObject(false);
+        case 21:
+            return JSONObject(true);
+        case 22:
+        case 23:
+            return JSONObject(JSONObjectType::NULL_VALUE);
+        case 25:
+            return JSONObject(static_cast<long double>(
+                half_to_double(static_cast<uint16_t>(reader.big_endian(2)))));
+        case 26:
+            return JSONObject(static_cast<long double>(float_from_bits(reader.big_endian(4))));
+        case 27:
+            return JSONObject(static_cast<long double>(double_from_bits(reader.big_endian(8))));
+        default:
+            throw reader.error("Unsupported CBOR simple value", offset);
+        }
+    default:
+        throw reader.error("Byte strings cannot be represented in JSON", offset);
+    }
+}
+
+/// Decodes a CBOR scalar into value and returns true, or opens the array or map which starts at
+/// the reader's position and returns false. A tag only adds meaning to the item which follows it,
+/// it is skipped and the item is decoded as is
+static bool cbor_item(BinaryReader &reader, std::vector<BinaryFrame> &frames, JSONObject &value)
+{
+    size_t offset = reader.pos;
+    uint8_t head = reader.byte();
+    uint8_t major = head >> 5;
+    uint8_t info = head & 0x1F;
+    if (major == 4 || major == 5)
+    {
+        uint64_t count = cbor_argument(reader, info, offset);
+        open_container(reader, frames, major == 5, info == 31, count, offset);
+        return false;
+    }
+    if (major == 6)
+    {
+        cbor_argument(reader, info, offset);
+        return false;
+    }
+    value = cbor_scalar(reader, head, offset);
+    return true;
+}
+
+static std::string cbor_key(BinaryReader &reader)
+{
+    size_t offset = reader.pos;
+    uint8_t head = reader.byte();
+    if (head >> 5 != 3)
+        throw reader.error("CBOR map keys must be text strings", offset);
+    return cbor_text(reader, head & 0x1F, offset);
+}
+
+static JSONObject cbor_decode(BinaryReader &reader, std::vector<BinaryFrame> &frames,
+                              size_t &commit)
+{
+    return decode_items(reader, frames, commit, "CBOR nesting is too deep", cbor_item, cbor_key,
+                        cbor_is_break);
+}
+
+JSONObject from_cbor(const uint8_t *data, size_t size)
+{
+    BinaryReader reader{data, size, 0, false, 0, unlimited, unlimited};
+    std::vector<BinaryFrame> frames;
+    size_t commit = 0;
+    auto ob = cbor_decode(reader, frames, commit);
+    if (reader.pos != size)
+        throw reader.error("Extra bytes after CBOR item", reader.pos);
+    return ob;
+}
+
+JSONObject from_cbor(const std::vector<uint8_t> &data)
+{
+    return from_cbor(data.data(), data.size());
+}
+
+/*
+ * MessagePack
+ */
+
+static void msgpack_length(std::vector<uint8_t> &out, uint64_t length, uint8_t fix,
+                           uint8_t fix_limit, uint8_t first)
+{
+    // first is the marker for the 8 bit length form if it exists, otherwise the 16 bit form.
+    // The markers for the wider forms follow it
+    if (length < fix_limit)
+        out.push_back(static_cast<uint8_t>(fix | length));
+    else if (first == 0xD9 && length <= 0xFF)
+    {
+        out.push_back(first);
+        write_big_endian(out, length, 1);
+    }
+    else if (length <= 0xFFFF)
+    {
+        out.push_back(first == 0xD9 ? 0xDA : first);
+        write_big_endian(out, length, 2);
+    }
+    else
+    {
+        out.push_back(first == 0xD9 ? 0xDB : static_cast<uint8_t>(first + 1));
+        write_big_endian(out, length, 4);
+    }
+}
+
+void to_msgpack(const JSONObject &ob, std::vector<uint8_t> &out)
+{
+    switch (ob.type)
+    {
+    case JSONObjectType::NUMBER_INT:
+    {
+        int64_t value = ob.as_integer();
+        if (value >= -32 && value <= 127)
+            out.push_back(static_cast<uint8_t>(value));
+        else if (value >= 0)
+        {
+            uint64_t u = static_cast<uint64_t>(value);
+            if (u <= 0xFF)
+            {
+                out.push_back(0xCC);
+                write_big_endian(out, u, 1);
+            }
+            else if (u <= 0xFFFF)
+            {
+                out.push_back(0xCD);
+                write_big_endian(out, u, 2);
+            }
+            else if (u <= 0xFFFFFFFF)
+            {
+                out.push_back(0xCE);
+                write_big_endian(out, u, 4);
+            }
+            else
+            {
+                out.push_back(0xCF);
+                write_big_endian(out, u, 8);
+            }
+        }
+        else
+        {
+            uint64_t bits = static_cast<uint64_t>(value);
+            if (value >= INT8_MIN)
+            {
+                out.push_back(0xD0);
+                write_big_endian(out, bits, 1);
+            }
+            else if (value >= INT16_MIN)
+            {
+                out.push_back(0xD1);
+                write_big_endian(out, bits, 2);
+            }
+            else if (value >= INT32_MIN)
+            {
+                out.push_back(0xD2);
+                write_big_endian(out, bits, 4);
+            }
+            else
+            {
+                out.push_back(0xD3);
+                write_big_endian(out, bits, 8);
+            }
+        }
+        break;
+    }
+    case JSONObjectType::NUMBER_REAL:
+    {
+        long double value = ob.as_real();
+        double wide = static_cast<double>(value);
+        float narrow = static_cast<float>(wide);
+        if (same_value(narrow, wide))
+        {
+            out.push_back(0xCA);
+            write_big_endian(out, bits_of(narrow), 4);
+        }
+        else
+        {
+            out.push_back(0xCB);
+            write_big_endian(out, bits_of(wide), 8);
+        }
+        break;
+    }
+    case JSONObjectType::STRING:
+    {
+        auto &s = ob.as_string();
+        msgpack_length(out, s.size(), 0xA0, 32, 0xD9);
+        out.insert(out.end(), s.begin(), s.end());
+        break;
+    }
+    case JSONObjectType::BOOLEAN:
+        out.push_back(ob.as_bool() ? 0xC3 : 0xC2);
+        break;
+    case JSONObjectType::ARRAY:
+    {
+        msgpack_length(out, ob.size(), 0x90, 16, 0xDC);
+        ob.for_each_element([&out](const JSONObject &element) { to_msgpack(element, out); });
+        break;
+    }
+    case JSONObjectType::OBJECT:
+    {
+        auto &pairs = ob.as_kv_pairs();
+        msgpack_length(out, pairs.size(), 0x80, 16, 0xDE);
+        for (auto &pair : pairs)
+        {
+            msgpack_length(out, pair.first.size(), 0xA0, 32, 0xD9);
+            out.insert(out.end(), pair.first.begin(), pair.first.end());
+            to_msgpack(pair.second, out);
+        }
+        break;
+    }
+    default:
+        out.push_back(0xC0);
+        break;
+    }
+}
+
+std::vector<uint8_t> to_msgpack(const JSONObject &ob)
+{
+    std::vector<uint8_t> out;
+    to_msgpack(ob, out);
+    return out;
+}
+
+// Returns the length of a string if head is a string marker, otherwise returns false
+static bool msgpack_string_length(BinaryReader &reader, uint8_t head, uint64_t &length)
+{
+    if (head >= 0xA0 && head <= 0xBF)
+        length = head & 0x1F;
+    else if (head == 0xD9)
+        length = reader.big_endian(1);
+    else if (head == 0xDA)
+        length = reader.big_endian(2);
+    else if (head == 0xDB)
+        length = reader.big_endian(4);
+    else
+        return false;
+    return true;
+}
+
+// Returns the number of items and the kind of a container if head is an array or map marker,
+// otherwise returns false
+static bool msgpack_container(BinaryReader &reader, uint8_t head, uint64_t &count, bool &is_map)
+{
+    is_map = head >= 0x80 && head <= 0x8F;
+    if (is_map || (head >= 0x90 && head <= 0x9F))
+        count = head & 0x0F;
+    else if (head == 0xDC || head == 0xDE)
+        count = reader.big_endian(2);
+    else if (head == 0xDD || head == 0xDF)
+        count = reader.big_endian(4);
+    else
+        return false;
+    is_map = is_map || head >= 0xDE;
+    return true;
+}
+
+/// Decodes a MessagePack item which is neither an array nor a map
+static JSONObject msgpack_scalar(BinaryReader &reader, uint8_t head, size_t offset)
+{
+    if (head <= 0x7F)
+        return JSONObject(static_cast<int64_t>(head));
+    if (head >= 0xE0)
+        return JSONObject(static_cast<int64_t>(static_cast<int8_t>(head)));
+
+    uint64_t length;
+    if (msgpack_string_length(reader, head, length))
+        return JSONObject(reader.string(length, offset));
+
+    switch (head)
+    {
+    case 0xC0:
+        return JSONObject(JSONObjectType::NULL_VALUE);
+    case 0xC2:
+        return JSONObject(false);
+    case 0xC3:
+        return JSONObject(true);
+    case 0xCA:
+        return JSONObject(static_cast<long double>(float_from_bits(reader.big_endian(4))));
+    case 0xCB:
+        return JSONObject(static_cast<long double>(double_from_bits(reader.big_endian(8))));
+    case 0xCC:
+        return JSONObject(static_cast<int64_t>(reader.big_endian(1)));
+    case 0xCD:
+        return JSONObject(static_cast<int64_t>(reader.big_endian(2)));
+    case 0xCE:
+        return JSONObject(static_cast<int64_t>(reader.big_endian(4)));
+    case 0xCF:
+    {
+        uint64_t value = reader.big_endian(8);
+        if (value > static_cast<uint64_t>(INT64_MAX))
+            return JSONObject(static_cast<long double>(value));
+        return JSONObject(static_cast<int64_t>(value));
+    }
+    case 0xD0:
+        return JSONObject(static_cast<int64_t>(static_cast<int8_t>(reader.big_endian(1))));
+    case 0xD1:
+        return JSONObject(static_cast<int64_t>(static_cast<int16_t>(reader.big_endian(2))));
+    case 0xD2:
+        return JSONObject(static_cast<int64_t>(static_cast<int32_t>(reader.big_endian(4))));
+    case 0xD3:
+        return JSONObject(static_cast<int64_t>(reader.big_endian(8)));
+    default:
+        throw reader.error("Unsupported MessagePack type", offset);
+    }
+}
+
+/// Decodes a MessagePack scalar into value and returns true, or opens the array or map which
+/// starts at the reader's position and returns false
+static bool msgpack_item(BinaryReader &reader, std::vector<BinaryFrame> &frames, JSONObject &value)
+{
+    size_t offset = reader.pos;
+    uint8_t head = reader.byte();
+    uint64_t count;
+    bool is_map;
+    if (msgpack_container(reader, head, count, is_map))
+    {
+        open_container(reader, frames, is_map, false, count, offset);
+        return false;
+    }
+    value = msgpack_scalar(reader, head, offset);
+    return true;
+}
+
+static std::string msgpack_key(BinaryReader &reader)
+{
+    size_t offset = reader.pos;
+    uint64_t length;
+    if (!msgpack_string_length(reader, reader.byte(), length))
+        throw reader.error("MessagePack map keys must be strings", offset);
+    return reader.string(length, offset);
+}
+
+// MessagePack containers always have a count
+static bool msgpack_is_break(BinaryReader &) { return false; }
+
+static JSONObject msgpack_decode(BinaryReader &reader, std::vector<BinaryFrame> &frames,
+                                 size_t &commit)
+{
+    return decode_items(reader, frames, commit, "MessagePack nesting is too deep", msgpack_item,
+                        msgpack_key, msgpack_is_break);
+}
+
+JSONObject from_msgpack(const uint8_t *data, size_t size)
+{
+    BinaryReader reader{data, size, 0, false, 0, unlimited, unlimited};
+    std::vector<BinaryFrame> frames;
+    size_t commit = 0;
+    auto ob = msgpack_decode(reader, frames, commit);
+    if (reader.pos != size)
+        throw reader.error("Extra bytes after MessagePack item", reader.pos);
+    return ob;
+}
+
+JSONObject from_msgpack(const std::vector<uint8_t> &data)
+{
+    return from_msgpack(data.data(), data.size());
+}
+
+/*
+ * Streaming
+ */
+
+JSONStreamDecoder::JSONStreamDecoder(BinaryFormat format)
+    : format(format), consumed(0), needed(0), discarded(0), item_start(0), max_item(unlimited)
+{
+}
+
+void JSONStreamDecoder::set_max_item_size(size_t bytes) { max_item = bytes; }
+
+void JSONStreamDecoder::feed(const uint8_t *data, size_t size)
+{
+    // Drop the bytes which were already decoded once they make up most of the buffer
+    if (consumed > 0 && consumed >= buffer.size() / 2)
+    {
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(consumed));
+        needed -= needed > consumed ? consumed : needed;
+        discarded += consumed;
+        consumed = 0;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+/// Decodes from where the previous call stopped, with the containers it left open. Running out of
+/// input keeps everything decoded up to the last complete scalar, key or container head
+bool JSONStreamDecoder::next(JSONObject &out)
+{
+    if (consumed == buffer.size() || buffer.size() < needed)
+        return false;
+    // The end of the pending item if it is max_item bytes long, in the coordinates of buffer
+    size_t limit = unlimited;
+    if (max_item < unlimited - item_start)
+        limit = item_start + max_item - discarded;
+    BinaryReader reader{buffer.data(), buffer.size(), consumed, true, discarded, limit, max_item};
+    size_t commit = consumed;
+    try
+    {
+        out = format == BinaryFormat::CBOR ? cbor_decode(reader, frames, commit)
+                                           : msgpack_decode(reader, frames, commit);
+    }
+    catch (const binary_incomplete &incomplete)
+    {
+        consumed = commit;
+        needed = incomplete.needed;
+        return false;
+    }
+    catch (...)
+    {
+        // Calling next() again fails again at the same place
+        consumed = commit;
+        throw;
+    }
+    consumed = reader.pos;
+    item_start = discarded + consumed;
+    needed = 0;
+    return true;
+}
+
+size_t JSONStreamDecoder::pending() const { return discarded + buffer.size() - item_start; }
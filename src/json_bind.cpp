@@ -0,0 +1,166 @@
+#include "json_bind.hpp"
+
+JSONTokenReader::JSONTokenReader(const std::string &buffer) : lexer(buffer), has_lookahead(false)
+{
+}
+
+/// @brief Returns the next token, consuming it
+Token JSONTokenReader::next()
+{
+    if (has_lookahead)
+    {
+        has_lookahead = false;
+        return std::move(lookahead);
+    }
+    return lexer.next();
+}
+
+/// @brief Returns the next token without consuming it
+const Token &JSONTokenReader::peek()
+{
+    if (!has_lookahead)
+    {
+        lookahead = lexer.next();
+        has_lookahead = true;
+    }
+    return lookahead;
+}
+
+Token JSONTokenReader::expect(Token::Type type, const char *what)
+{
+    auto token = next();
+    if (token.type != type)
+        throw error(std::string("Expected ") + what + ", found ", token);
+    return token;
+}
+
+static bool is_scalar(Token::Type type)
+{
+    switch (type)
+    {
+    case Token::Type::STRING:
+    case Token::Type::NUMBER_INTEGER:
+    case Token::Type::NUMBER_REAL:
+    case Token::Type::LITERAL_TRUE:
+    case Token::Type::LITERAL_FALSE:
+    case Token::Type::LITERAL_NULL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// @brief Skips over the next value with the same grammar as the parser. Nested containers are
+/// kept on a stack of their closing tokens instead of being skipped recursively.
+void JSONTokenReader::skip_value()
+{
+    std::vector<Token::Type> closers;
+    while (1)
+    {
+        // A value is expected
+        auto token = next();
+        if (token.type == Token::Type::LEFT_BRACE || token.type == Token::Type::LEFT_SQUARE)
+        {
+            auto closer = token.type == Token::Type::LEFT_BRACE ? Token::Type::RIGHT_BRACE
+                                                                : Token::Type::RIGHT_SQUARE;
+            if (peek().type != closer)
+            {
+                closers.push_back(closer);
+                if (closer == Token::Type::RIGHT_BRACE)
+                {
+                    expect(Token::Type::STRING, "string key");
+                    expect(Token::Type::COLON, "\":\"");
+                }
+                continue;
+            }
+            next();
+        }
+        else if (!is_scalar(token.type))
+        {
+            throw error("Expected value, found ", token);
+        }
+
+        // The value is complete, it is followed by a comma or by the end of its container
+        while (!closers.empty())
+        {
+            auto separator = next();
+            if (separator.type == Token::Type::COMMA)
+            {
+                if (closers.back() == Token::Type::RIGHT_BRACE)
+                {
+                    expect(Token::Type::STRING, "string key");
+                    expect(Token::Type::COLON, "\":\"");
+                }
+                break;
+            }
+            if (separator.type != closers.back())
+                throw error(closers.back() == Token::Type::RIGHT_BRACE ? "Expected \"}\", found "
+                                                                       : "Expected \"]\", found ",
+                            separator);
+            closers.pop_back();
+        }
+        if (closers.empty())
+            return;
+    }
+}
+
+/// @brief Reads the next value into a JSONObject, this is used for members whose type is
+/// JSONObject
+JSONObject JSONTokenReader::read_tree()
+{
+    auto token = next();
+    switch (token.type)
+    {
+    case Token::Type::STRING:
+        return JSONObject(token.as_string());
+    case Token::Type::NUMBER_INTEGER:
+        return JSONObject(token.as_integer());
+    case Token::Type::NUMBER_REAL:
+        return JSONObject(token.as_real());
+    case Token::Type::LITERAL_TRUE:
+        return JSONObject(true);
+    case Token::Type::LITERAL_FALSE:
+        return JSONObject(false);
+    case Token::Type::LITERAL_NULL:
+        return JSONObject(JSONObjectType::NULL_VALUE);
+    case Token::Type::LEFT_BRACE:
+    {
+        lookahead = std::move(token);
+        has_lookahead = true;
+        JSONObject::Members members;
+        json_read_members(*this, [&](std::string &key) { members[key] = read_tree(); });
+        return JSONObject(std::move(members));
+    }
+    case Token::Type::LEFT_SQUARE:
+    {
+        JSONObject::Elements elements;
+        if (peek().type == Token::Type::RIGHT_SQUARE)
+        {
+            next();
+            return JSONObject(std::move(elements));
+        }
+        while (1)
+        {
+            elements.push_back(read_tree());
+            auto separator = next();
+            if (separator.type == Token::Type::RIGHT_SQUARE)
+                return JSONObject(std::move(elements));
+            if (separator.type != Token::Type::COMMA)
+                throw error("Expected \"]\", found ", separator);
+        }
+    }
+    default:
+        throw error("Expected value, found ", token);
+    }
+}
+
+void JSONTokenReader::finish()
+{
+    if (has_lookahead || lexer.is_next())
+        throw lexer.error("Extra tokens after parsing JSON", lexer.position());
+}
+
+json_parse_error JSONTokenReader::error(const std::string &message, const Token &tok) const
+{
+    return lexer.error(message + tok.as_exception_string(), tok.offset);
+}
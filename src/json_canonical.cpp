@@ -0,0 +1,245 @@
+#include "json_canonical.hpp"
+#include "json_writer.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+void json_write_es_number(std::string &out, double value)
+{
+    if (!std::isfinite(value))
+        throw json_access_error("NaN and infinity cannot be written as canonical JSON");
+    // Zero, including negative zero
+    if (!(value < 0) && !(value > 0))
+    {
+        out.push_back('0');
+        return;
+    }
+
+    // Shortest digits which read back to the same double, as d.ddde[+-]x
+    char buffer[40];
+    auto result =
+        std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+    const char *p = buffer;
+    if (*p == '-')
+    {
+        out.push_back('-');
+        p++;
+    }
+    char digits[20];
+    int k = 0;
+    for (; *p != 'e'; p++)
+    {
+        if (*p != '.')
+            digits[k++] = *p;
+    }
+    int exponent = 0;
+    std::from_chars(p + (p[1] == '+' ? 2 : 1), result.ptr, exponent);
+    // The value is 0.digits * 10^n
+    const int n = exponent + 1;
+
+    if (k <= n && n <= 21)
+    {
+        out.append(digits, static_cast<size_t>(k));
+        out.append(static_cast<size_t>(n - k), '0');
+    }
+    else if (0 < n && n <= 21)
+    {
+        out.append(digits, static_cast<size_t>(n));
+        out.push_back('.');
+        out.append(digits + n, static_cast<size_t>(k - n));
+    }
+    else if (-6 < n && n <= 0)
+    {
+        out.append("0.");
+        out.append(static_cast<size_t>(-n), '0');
+        out.append(digits, static_cast<size_t>(k));
+    }
+    else
+    {
+        out.push_back(digits[0]);
+        if (k > 1)
+        {
+            out.push_back('.');
+            out.append(digits + 1, static_cast<size_t>(k - 1));
+        }
+        out.push_back('e');
+        out.push_back(n - 1 < 0 ? '-' : '+');
+        json_write_integer(out, std::abs(n - 1));
+    }
+}
+
+/// UTF-8 orders strings by code point, which is also the UTF-16 order unless a string contains
+/// characters from U+E000 upwards, whose lead bytes are 0xEE and above
+static bool needs_utf16_order(std::string_view key)
+{
+    for (char c : key)
+    {
+        if (static_cast<unsigned char>(c) >= 0xEE)
+            return true;
+    }
+    return false;
+}
+
+/// Decodes the code point at i and returns a key which orders code points as their UTF-16
+/// encodings are ordered: the first code unit in the high half, the second (if any) in the low
+/// half. A malformed sequence is taken one byte at a time
+static uint32_t next_utf16_key(std::string_view s, size_t &i)
+{
+    auto lead = static_cast<unsigned char>(s[i]);
+    size_t length = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    uint32_t code_point = length == 1 ? lead : lead & (0x3Fu >> (length - 1));
+    if (length > 1 && s.size() - i >= length)
+    {
+        for (size_t k = 1; k < length; k++)
+            code_point = (code_point << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3Fu);
+    }
+    else
+    {
+        length = 1;
+        code_point = lead;
+    }
+    i += length;
+    if (code_point < 0x10000)
+        return code_point << 16;
+    code_point -= 0x10000;
+    return (0xD800 + (code_point >> 10)) << 16 | (0xDC00 + (code_point & 0x3FF));
+}
+
+static bool utf16_less(std::string_view a, std::string_view b)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        uint32_t x = next_utf16_key(a, i);
+        uint32_t y = next_utf16_key(b, j);
+        if (x != y)
+            return x < y;
+    }
+    return i == a.size() && j < b.size();
+}
+
+/// Writes into a buffer which is passed to the sink whenever it fills up, or directly into the
+/// output string if there is no sink
+class CanonicalWriter
+{
+    std::string &out;
+    const JSONByteSink *sink;
+
+    void flush()
+    {
+        const size_t block = 1 << 12;
+        if (sink && out.size() >= block)
+        {
+            (*sink)(out.data(), out.size());
+            out.clear();
+        }
+    }
+
+    void write_member(const std::string &key, const JSONObject &value, bool first)
+    {
+        if (!first)
+            out.push_back(',');
+        json_write_string(out, key);
+        out.push_back(':');
+        write(value);
+    }
+
+  public:
+    CanonicalWriter(std::string &out, const JSONByteSink *sink) : out(out), sink(sink) {}
+
+    void write(const JSONObject &ob)
+    {
+        switch (ob.type)
+        {
+        case JSONObjectType::NUMBER_REAL:
+            json_write_es_number(out, static_cast<double>(ob.as_real()));
+            break;
+        case JSONObjectType::NUMBER_INT:
+            json_write_es_number(out, static_cast<double>(ob.as_integer()));
+            break;
+        case JSONObjectType::STRING:
+            json_write_string(out, ob.as_string());
+            break;
+        case JSONObjectType::BOOLEAN:
+            out.append(ob.as_bool() ? "true" : "false");
+            break;
+        case JSONObjectType::OBJECT:
+        {
+            auto &pairs = ob.as_kv_pairs();
+            out.push_back('{');
+            bool reorder = std::any_of(pairs.begin(), pairs.end(),
+                                       [](auto &pair) { return needs_utf16_order(pair.first); });
+            if (!reorder)
+            {
+                bool first = true;
+                for (auto &pair : pairs)
+                {
+                    write_member(pair.first, pair.second, first);
+                    first = false;
+                }
+            }
+            else
+            {
+                std::vector<const std::pair<const std::string, JSONObject> *> sorted;
+                sorted.reserve(pairs.size());
+                for (auto &pair : pairs)
+                    sorted.push_back(&pair);
+                std::sort(sorted.begin(), sorted.end(),
+                          [](auto *a, auto *b) { return utf16_less(a->first, b->first); });
+                for (size_t i = 0; i < sorted.size(); i++)
+                    write_member(sorted[i]->first, sorted[i]->second, i == 0);
+            }
+            out.push_back('}');
+            break;
+        }
+        case JSONObjectType::ARRAY:
+        {
+            out.push_back('[');
+            bool first = true;
+            ob.for_each_element(
+                [&](const JSONObject &element)
+                {
+                    if (!first)
+                        out.push_back(',');
+                    first = false;
+                    write(element);
+                });
+            out.push_back(']');
+            break;
+        }
+        default:
+            out.append("null");
+            break;
+        }
+        flush();
+    }
+
+    void finish()
+    {
+        if (sink && !out.empty())
+            (*sink)(out.data(), out.size());
+    }
+};
+
+void json_write_canonical(std::string &out, const JSONObject &ob)
+{
+    CanonicalWriter writer(out, nullptr);
+    writer.write(ob);
+}
+
+void json_write_canonical(const JSONObject &ob, const JSONByteSink &sink)
+{
+    std::string buffer;
+    CanonicalWriter writer(buffer, &sink);
+    writer.write(ob);
+    writer.finish();
+}
+
+std::string to_canonical_json(const JSONObject &ob)
+{
+    std::string out;
+    json_write_canonical(out, ob);
+    return out;
+}
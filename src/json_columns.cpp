@@ -0,0 +1,534 @@
+#include "json_columns.hpp"
+#include "json_lexer.hpp"
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+
+/// Returns whether row has a value, i.e. its key was present and not null
+bool JSONColumn::is_valid(size_t row) const { return (validity[row / 8] >> (row % 8)) & 1; }
+
+/// Returns the string of a row of a STRING column, the string is empty if the row has no value
+std::string_view JSONColumn::string(size_t row) const
+{
+    if (type != JSONColumnType::STRING)
+        throw json_access_error("Column \"" + name + "\" does not hold strings");
+    return std::string_view(bytes).substr(offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+const JSONColumn *JSONTable::column(std::string_view name) const
+{
+    for (auto &column : columns)
+    {
+        if (column.name == name)
+            return &column;
+    }
+    return nullptr;
+}
+
+const char *json_column_type_name(JSONColumnType type)
+{
+    switch (type)
+    {
+    case JSONColumnType::BOOLEAN:
+        return "boolean";
+    case JSONColumnType::INTEGER:
+        return "integer";
+    case JSONColumnType::REAL:
+        return "real";
+    case JSONColumnType::STRING:
+        return "string";
+    default:
+        return "null";
+    }
+}
+
+static std::string mismatch_message(JSONColumnType value, const JSONColumn &column)
+{
+    return std::string("Cannot store ") + json_column_type_name(value) + " in " +
+           json_column_type_name(column.type) + " column \"" + column.name + "\"";
+}
+
+/// Finds the type of a column which holds values of both types, returns false if there is none
+static bool common_type(JSONColumnType a, JSONColumnType b, JSONColumnType &common)
+{
+    if (a == b || b == JSONColumnType::NULL_VALUE)
+        common = a;
+    else if (a == JSONColumnType::NULL_VALUE)
+        common = b;
+    else if ((a == JSONColumnType::INTEGER && b == JSONColumnType::REAL) ||
+             (a == JSONColumnType::REAL && b == JSONColumnType::INTEGER))
+        common = JSONColumnType::REAL;
+    else
+        return false;
+    return true;
+}
+
+static void push_validity(JSONColumn &column, size_t row, bool valid)
+{
+    if (row % 8 == 0)
+        column.validity.push_back(0);
+    if (valid)
+        column.validity.back() = static_cast<uint8_t>(column.validity.back() | (1u << (row % 8)));
+    else
+        column.null_count++;
+}
+
+static void push_null(JSONColumn &column, size_t row)
+{
+    switch (column.type)
+    {
+    case JSONColumnType::BOOLEAN:
+        column.booleans.push_back(0);
+        break;
+    case JSONColumnType::INTEGER:
+        column.integers.push_back(0);
+        break;
+    case JSONColumnType::REAL:
+        column.reals.push_back(0);
+        break;
+    case JSONColumnType::STRING:
+        column.offsets.push_back(column.bytes.size());
+        break;
+    default:
+        break;
+    }
+    push_validity(column, row, false);
+}
+
+/// Changes the type of a column which holds the given number of rows. The rows of a NULL_VALUE
+/// column become zeroes or empty strings, and the values of an INTEGER column are converted
+static void promote(JSONColumn &column, JSONColumnType type, size_t rows)
+{
+    if (column.type == JSONColumnType::INTEGER)
+    {
+        column.reals.reserve(column.integers.capacity());
+        for (auto value : column.integers)
+            column.reals.push_back(static_cast<double>(value));
+        column.integers = std::vector<int64_t>();
+    }
+    else if (type == JSONColumnType::BOOLEAN)
+        column.booleans.assign(rows, 0);
+    else if (type == JSONColumnType::INTEGER)
+        column.integers.assign(rows, 0);
+    else if (type == JSONColumnType::REAL)
+        column.reals.assign(rows, 0);
+    else if (type == JSONColumnType::STRING)
+        column.offsets.assign(rows + 1, 0);
+    column.type = type;
+}
+
+/// Appends the rows of a column read from a chunk to a column of the whole table, whose type
+/// fits both. A missing column contributes rows without values
+static void append(JSONColumn &to, size_t row, const JSONColumn *from, size_t rows)
+{
+    if (from == nullptr || from->type == JSONColumnType::NULL_VALUE)
+    {
+        for (size_t i = 0; i < rows; i++)
+            push_null(to, row + i);
+        return;
+    }
+    switch (to.type)
+    {
+    case JSONColumnType::BOOLEAN:
+        to.booleans.insert(to.booleans.end(), from->booleans.begin(), from->booleans.end());
+        break;
+    case JSONColumnType::INTEGER:
+        to.integers.insert(to.integers.end(), from->integers.begin(), from->integers.end());
+        break;
+    case JSONColumnType::REAL:
+        if (from->type == JSONColumnType::INTEGER)
+        {
+            for (auto value : from->integers)
+                to.reals.push_back(static_cast<double>(value));
+        }
+        else
+            to.reals.insert(to.reals.end(), from->reals.begin(), from->reals.end());
+        break;
+    default:
+    {
+        uint64_t base = to.bytes.size();
+        to.bytes += from->bytes;
+        for (size_t i = 1; i <= rows; i++)
+            to.offsets.push_back(base + from->offsets[i]);
+        break;
+    }
+    }
+    for (size_t i = 0; i < rows; i++)
+        push_validity(to, row + i, from->is_valid(i));
+}
+
+/// Reads the records of one chunk of the array, i.e. objects separated by commas, into a table.
+/// The lexer only holds the chunk, so errors are reported at base plus the offset in the chunk
+class JSONColumnReader
+{
+    std::string_view document;
+
+    size_t base;
+
+    JSONLexer lexer;
+
+    bool infer;
+
+    JSONTable table;
+
+    // Number of rows of each column which have been filled, to find keys missing from a record
+    std::vector<size_t> lengths;
+
+    std::unordered_map<std::string, size_t> index;
+
+    // Column of the key which followed the previous one, records usually list their keys in the
+    // same order, which makes this a hit without hashing the key
+    size_t expected;
+
+    [[noreturn]] void fail(const std::string &message, size_t offset) const
+    {
+        throw json_error_at(message, document, base + offset);
+    }
+
+    Token next()
+    {
+        if (!lexer.is_next())
+            fail("Unexpected end of input", lexer.size());
+        try
+        {
+            return lexer.next();
+        }
+        catch (const json_parse_error &e)
+        {
+            // The lexer's offsets are relative to the chunk, the error is raised again with the
+            // lexer's message at the offset in the whole input
+            if (e.offset() == std::string::npos)
+                fail(e.message(), lexer.position());
+            fail(e.message(), e.offset());
+        }
+    }
+
+    void add(const std::string &name, JSONColumnType type)
+    {
+        JSONColumn column;
+        column.name = name;
+        promote(column, type, table.rows);
+        for (size_t row = 0; row < table.rows; row++)
+            push_validity(column, row, false);
+        index.emplace(name, table.columns.size());
+        lengths.push_back(table.rows);
+        table.columns.push_back(std::move(column));
+    }
+
+    // Returns the column of a key, or npos if it is not read
+    size_t find(const std::string &key)
+    {
+        if (expected < table.columns.size() && table.columns[expected].name == key)
+            return expected++;
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            expected = it->second + 1;
+            return it->second;
+        }
+        if (!infer)
+            return std::string::npos;
+        add(key, JSONColumnType::NULL_VALUE);
+        expected = table.columns.size();
+        return table.columns.size() - 1;
+    }
+
+    void skip_value()
+    {
+        size_t depth = 0;
+        do
+        {
+            auto token = next();
+            switch (token.type)
+            {
+            case Token::Type::LEFT_BRACE:
+            case Token::Type::LEFT_SQUARE:
+                depth++;
+                break;
+            case Token::Type::RIGHT_BRACE:
+            case Token::Type::RIGHT_SQUARE:
+                if (depth == 0)
+                    fail("Expected value", token.offset);
+                depth--;
+                break;
+            case Token::Type::COMMA:
+            case Token::Type::COLON:
+                if (depth == 0)
+                    fail("Expected value", token.offset);
+                break;
+            default:
+                break;
+            }
+        } while (depth != 0);
+    }
+
+    void read_value(size_t c, size_t row)
+    {
+        auto token = next();
+        JSONColumnType type;
+        switch (token.type)
+        {
+        case Token::Type::STRING:
+            type = JSONColumnType::STRING;
+            break;
+        case Token::Type::NUMBER_INTEGER:
+            type = JSONColumnType::INTEGER;
+            break;
+        case Token::Type::NUMBER_REAL:
+            type = JSONColumnType::REAL;
+            break;
+        case Token::Type::LITERAL_TRUE:
+        case Token::Type::LITERAL_FALSE:
+            type = JSONColumnType::BOOLEAN;
+            break;
+        case Token::Type::LITERAL_NULL:
+            type = JSONColumnType::NULL_VALUE;
+            break;
+        case Token::Type::LEFT_BRACE:
+        case Token::Type::LEFT_SQUARE:
+            fail("Expected a scalar for column \"" + table.columns[c].name + "\"", token.offset);
+        default:
+            fail("Expected value", token.offset);
+        }
+
+        auto &column = table.columns[c];
+        lengths[c]++;
+        if (type == JSONColumnType::NULL_VALUE)
+        {
+            push_null(column, row);
+            return;
+        }
+        if (type != column.type &&
+            !(column.type == JSONColumnType::REAL && type == JSONColumnType::INTEGER))
+        {
+            JSONColumnType common;
+            if (!infer || !common_type(column.type, type, common))
+                fail(mismatch_message(type, column), token.offset);
+            promote(column, common, row);
+        }
+        switch (column.type)
+        {
+        case JSONColumnType::BOOLEAN:
+            column.booleans.push_back(token.type == Token::Type::LITERAL_TRUE);
+            break;
+        case JSONColumnType::INTEGER:
+            column.integers.push_back(token.as_integer());
+            break;
+        case JSONColumnType::REAL:
+            column.reals.push_back(type == JSONColumnType::INTEGER
+                                       ? static_cast<double>(token.as_integer())
+                                       : static_cast<double>(token.as_real()));
+            break;
+        default:
+            column.bytes += token.as_string();
+            column.offsets.push_back(column.bytes.size());
+            break;
+        }
+        push_validity(column, row, true);
+    }
+
+    void read_record()
+    {
+        auto token = next();
+        if (token.type != Token::Type::LEFT_BRACE)
+            fail("Expected an object", token.offset);
+        size_t row = table.rows;
+        expected = 0;
+        token = next();
+        if (token.type != Token::Type::RIGHT_BRACE)
+        {
+            while (1)
+            {
+                if (token.type != Token::Type::STRING)
+                    fail("Expected string key", token.offset);
+                size_t c = find(token.as_string());
+                if (c != std::string::npos && lengths[c] > row)
+                    fail("Duplicate key \"" + token.as_string() + "\"", token.offset);
+                token = next();
+                if (token.type != Token::Type::COLON)
+                    fail("Expected \":\"", token.offset);
+                if (c == std::string::npos)
+                    skip_value();
+                else
+                    read_value(c, row);
+                token = next();
+                if (token.type == Token::Type::RIGHT_BRACE)
+                    break;
+                if (token.type != Token::Type::COMMA)
+                    fail("Expected \"}\"", token.offset);
+                token = next();
+            }
+        }
+        for (size_t c = 0; c < table.columns.size(); c++)
+        {
+            if (lengths[c] == row)
+            {
+                push_null(table.columns[c], row);
+                lengths[c]++;
+            }
+        }
+        table.rows++;
+    }
+
+  public:
+    JSONColumnReader(std::string_view document, size_t begin, size_t end,
+                     const std::vector<JSONColumnSchema> &schema)
+        : document(document), base(begin),
+          lexer(std::string(document.substr(begin, end - begin))), infer(schema.empty()),
+          expected(0)
+    {
+        for (auto &column : schema)
+            add(column.name, column.type);
+    }
+
+    // Reads the records, an empty chunk is only allowed if it is the whole array
+    JSONTable read(bool whole)
+    {
+        if (!lexer.is_next())
+        {
+            if (!whole)
+                fail("Expected an object", 0);
+            return std::move(table);
+        }
+        while (1)
+        {
+            read_record();
+            if (!lexer.is_next())
+                break;
+            auto token = next();
+            if (token.type != Token::Type::COMMA)
+                fail("Expected \",\" or \"]\"", token.offset);
+        }
+        return std::move(table);
+    }
+};
+
+/// Finds the commas which split the elements of the array between begin and end into chunks of
+/// about the same size. This only tracks strings and nesting, the chunks are checked when they
+/// are read, and a chunk boundary in the wrong place of malformed input only fails elsewhere
+static std::vector<size_t> split(std::string_view text, size_t begin, size_t end, size_t chunks)
+{
+    std::vector<size_t> commas;
+    size_t depth = 0;
+    size_t target = begin + (end - begin) / chunks;
+    for (size_t i = begin; i < end && commas.size() + 1 < chunks; i++)
+    {
+        char ch = text[i];
+        if (ch == '"')
+        {
+            for (i++; i < end && text[i] != '"'; i++)
+            {
+                if (text[i] == '\\')
+                    i++;
+            }
+        }
+        else if (ch == '{' || ch == '[')
+            depth++;
+        else if ((ch == '}' || ch == ']') && depth > 0)
+            depth--;
+        else if (ch == ',' && depth == 0 && i >= target)
+        {
+            commas.push_back(i);
+            target = begin + (end - begin) / chunks * (commas.size() + 1);
+        }
+    }
+    return commas;
+}
+
+/// Concatenates the tables read from the chunks. The columns are ordered by the first chunk
+/// which has them, and get a type which fits the values of every chunk
+static JSONTable concatenate(std::vector<JSONTable> &parts)
+{
+    JSONTable result;
+    std::unordered_map<std::string, size_t> index;
+    for (auto &part : parts)
+    {
+        for (auto &column : part.columns)
+        {
+            auto it = index.find(column.name);
+            if (it == index.end())
+            {
+                index.emplace(column.name, result.columns.size());
+                result.columns.emplace_back();
+                result.columns.back().name = column.name;
+                result.columns.back().type = column.type;
+                continue;
+            }
+            auto &merged = result.columns[it->second];
+            if (!common_type(merged.type, column.type, merged.type))
+                throw json_parse_error(mismatch_message(column.type, merged));
+        }
+    }
+    for (auto &column : result.columns)
+    {
+        if (column.type == JSONColumnType::STRING)
+            column.offsets.push_back(0);
+    }
+
+    for (auto &part : parts)
+    {
+        for (auto &column : result.columns)
+            append(column, result.rows, part.column(column.name), part.rows);
+        result.rows += part.rows;
+        part = JSONTable();
+    }
+    return result;
+}
+
+/// Reads the records of a top level array of objects into columns, see json_columns.hpp.
+/// With more than one thread, the array is split at the commas between records into chunks of
+/// at least options.min_chunk_size bytes, every chunk is read into a table of its own and the
+/// tables are concatenated
+JSONTable json_read_columns(std::string_view buffer, const JSONColumnOptions &options)
+{
+    auto is_whitespace = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+    size_t begin = 0;
+    while (begin < buffer.size() && is_whitespace(buffer[begin]))
+        begin++;
+    if (begin == buffer.size() || buffer[begin] != '[')
+        throw json_error_at("Expected an array of objects", buffer, begin);
+    size_t end = buffer.size();
+    while (end > begin + 1 && is_whitespace(buffer[end - 1]))
+        end--;
+    if (end == begin + 1 || buffer[end - 1] != ']')
+        throw json_error_at("Expected \"]\"", buffer, end - 1);
+    begin++;
+    end--;
+
+    size_t chunk_size = std::max<size_t>(options.min_chunk_size, 1);
+    size_t chunks = std::min(std::max<size_t>(options.threads, 1),
+                             std::max<size_t>((end - begin) / chunk_size, 1));
+    if (chunks == 1)
+        return JSONColumnReader(buffer, begin, end, options.schema).read(true);
+
+    auto commas = split(buffer, begin, end, chunks);
+    chunks = commas.size() + 1;
+    std::vector<JSONTable> parts(chunks);
+    std::vector<std::exception_ptr> errors(chunks);
+    auto read = [&](size_t chunk)
+    {
+        try
+        {
+            size_t from = chunk == 0 ? begin : commas[chunk - 1] + 1;
+            size_t to = chunk == commas.size() ? end : commas[chunk];
+            parts[chunk] = JSONColumnReader(buffer, from, to, options.schema).read(false);
+        }
+        catch (...)
+        {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t chunk = 1; chunk < chunks; chunk++)
+        workers.emplace_back(read, chunk);
+    read(0);
+    for (auto &worker : workers)
+        worker.join();
+    for (auto &error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    return concatenate(parts);
+}
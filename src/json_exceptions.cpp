@@ -12,19 +12,57 @@ json_not_implemented_error::json_not_implemented_error(const std::string &messag
 
 const char *json_not_implemented_error::what() const noexcept { return message.c_str(); }
 
-json_parse_error::json_parse_error() : message("Error parsing JSON") {}
+json_parse_error::json_parse_error()
+    : full("Error parsing JSON"), bare(full), position(std::string::npos)
+{
+}
 
-json_parse_error::json_parse_error(const std::string &message) : message(message) {}
+json_parse_error::json_parse_error(const std::string &message)
+    : full(message), bare(message), position(std::string::npos)
+{
+}
 
 json_parse_error::json_parse_error(const std::string &message, const Token &tok)
-    : message(message + tok.as_exception_string())
+    : bare(message + tok.as_exception_string()), position(tok.offset)
+{
+    full = bare + " at offset " + std::to_string(tok.offset);
+}
+
+json_parse_error::json_parse_error(const std::string &message, size_t offset,
+                                   const std::string &excerpt)
+    : full(message + " at offset " + std::to_string(offset)), bare(message), position(offset),
+      context(excerpt)
+{
+    if (!context.empty())
+        full += " near \"" + context + "\"";
+}
+
+size_t json_parse_error::offset() const noexcept { return position; }
+
+const std::string &json_parse_error::excerpt() const noexcept { return context; }
+
+const std::string &json_parse_error::message() const noexcept { return bare; }
+
+const char *json_parse_error::what() const noexcept { return full.c_str(); }
+
+json_limit_error::json_limit_error(const std::string &limit, size_t value, size_t offset)
+    : json_parse_error("Exceeded " + limit + " of " + std::to_string(value), offset, ""),
+      name(limit)
 {
 }
 
-const char *json_parse_error::what() const noexcept { return message.c_str(); }
+const std::string &json_limit_error::limit() const noexcept { return name; }
 
 json_access_error::json_access_error() : message("Invalid access") {}
 
 json_access_error::json_access_error(const std::string &message) : message(message) {}
 
-const char *json_access_error::what() const noexcept { return message.c_str(); }
\ No newline at end of file
+const char *json_access_error::what() const noexcept { return message.c_str(); }
+json_patch_error::json_patch_error(const std::string &message, size_t operation)
+    : message(message + " in operation " + std::to_string(operation)), index(operation)
+{
+}
+
+size_t json_patch_error::operation() const noexcept { return index; }
+
+const char *json_patch_error::what() const noexcept { return message.c_str(); }
@@ -0,0 +1,73 @@
+#pragma once
+#include "json_stats.hpp"
+
+// Macros used to record ParseStats. When JSONPARSER_STATS is not defined they expand to empty
+// statements, so that the instrumentation costs nothing.
+#ifdef JSONPARSER_STATS
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+inline uint64_t json_stats_clock()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+#endif
+}
+
+// Adds the ticks elapsed during its lifetime to a field of the statistics
+class JSONStatsTimer
+{
+    ParseStats *stats;
+    uint64_t ParseStats::*field;
+    uint64_t start;
+
+  public:
+    JSONStatsTimer(ParseStats *stats, uint64_t ParseStats::*field)
+        : stats(stats), field(field), start(json_stats_clock())
+    {
+    }
+
+    ~JSONStatsTimer()
+    {
+        if (stats)
+            stats->*field += json_stats_clock() - start;
+    }
+};
+
+#define JSON_STATS(statement)                                                                      \
+    do                                                                                             \
+    {                                                                                              \
+        statement;                                                                                 \
+    } while (0)
+
+#define JSON_STATS_TIMER(stats, field) JSONStatsTimer json_stats_timer_(stats, &ParseStats::field)
+
+#else
+
+#define JSON_STATS(statement)                                                                      \
+    do                                                                                             \
+    {                                                                                              \
+    } while (0)
+
+#define JSON_STATS_TIMER(stats, field)                                                             \
+    do                                                                                             \
+    {                                                                                              \
+    } while (0)
+
+#endif
@@ -1,4 +1,8 @@
 #include "json_lexer.hpp"
+#include "json_instrument.hpp"
+#include "json_utf8.hpp"
+#include <cstring>
+#include <stdexcept>
 
 /// @brief This method returns the current character(sybmol) being processed
 /// @return Returns a character
@@ -15,6 +19,7 @@ bool JSONLexer::available() { return idx < buffer.size(); }
 /// since these characters do not have any meaning in JSON syntax.
 void JSONLexer::skip_whitespace()
 {
+    JSON_STATS_TIMER(stats, whitespace_cycles);
     while (available())
     {
         switch (symbol())
@@ -23,6 +28,7 @@ void JSONLexer::skip_whitespace()
         case '\n':
         case '\r':
         case '\t':
+            JSON_STATS(if (stats) stats->whitespace_bytes++);
             advance();
             break;
         default:
@@ -88,7 +94,7 @@ Token JSONLexer::lex_single_symbol_token()
 /// A JSON string is a group of characters surrounded by double quotes (").
 /// @return A token with type set to UNKNOWN if a string cannot be found, otherwise the scanned
 /// string
-/// TODO: Implement unicode escape sequence, also check if a character is a control character
+/// TODO: Check if a character is a control character
 Token JSONLexer::lex_string()
 {
     Token token;
@@ -96,9 +102,11 @@ Token JSONLexer::lex_string()
     if (symbol() != '"')
         return token;
 
+    JSON_STATS_TIMER(stats, string_cycles);
     token.type = Token::Type::STRING;
     // Discard the scanned quote
     advance();
+    scratch.clear();
 
     while (available())
     {
@@ -107,59 +115,122 @@ Token JSONLexer::lex_string()
         {
             // Discard the reverse solidus
             advance();
+            JSON_STATS(if (stats) stats->escapes++);
 
             // There has to be atleast one character after an escape sequence
             if (!available())
-                throw json_parse_error("Unterminated string literal");
+                throw error("Unterminated string literal", start);
 
             if (symbol() == '/')
-                token.as_string().push_back('/');
+                scratch.push_back('/');
 
             else if (symbol() == '\\')
-                token.as_string().push_back('\\');
+                scratch.push_back('\\');
 
             else if (symbol() == '"')
-                token.as_string().push_back('"');
+                scratch.push_back('"');
 
             else if (symbol() == 'b')
-                token.as_string().push_back('\b');
+                scratch.push_back('\b');
 
             else if (symbol() == 'f')
-                token.as_string().push_back('\f');
+                scratch.push_back('\f');
 
             else if (symbol() == 'n')
-                token.as_string().push_back('\n');
+                scratch.push_back('\n');
 
             else if (symbol() == 'r')
-                token.as_string().push_back('\r');
+                scratch.push_back('\r');
 
             else if (symbol() == 't')
-                token.as_string().push_back('\t');
+                scratch.push_back('\t');
 
             else if (symbol() == 'u')
-                throw json_not_implemented_error("Unicode is not yet implemented");
+                lex_unicode_escape(scratch);
 
             else
-                throw json_parse_error("Invalid escape character");
+                throw error("Invalid escape character", idx - 1);
 
             advance();
         }
+        // The length is checked once per run of escapes or of plain characters rather than for
+        // every character
+        if (scratch.size() > limits.max_string_length)
+            throw json_limit_error("max_string_length", limits.max_string_length, start);
         if (!available())
-            throw json_parse_error("Unterminated string literal");
+            throw error("Unterminated string literal", start);
 
         // Check if the end of the string has been reached
         if (symbol() == '"')
         {
             advance();
+            // The token gets a copy of exactly the length of the string, which is moved into the
+            // tree by the parser, while scratch keeps its capacity for the next string
+            token.value = std::string(scratch);
             return token;
         }
 
-        // Add the current character to the string
-        token.as_string().push_back(symbol());
-        advance();
+        // Add the characters up to the next quote or escape to the string
+        size_t end = idx + 1;
+        while (end < buffer.size() && buffer[end] != '"' && buffer[end] != '\\')
+            end++;
+        scratch.append(buffer, idx, end - idx);
+        idx = end;
     }
     // Reached end of input without finding matching "
-    throw json_parse_error("Unterminated string literal");
+    throw error("Unterminated string literal", start);
+}
+
+/// Reads the four hexadecimal digits of a \u escape. idx is at the u, and is left at the last digit
+uint32_t JSONLexer::lex_hex4()
+{
+    const size_t escape = idx - 1;
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        advance();
+        if (!available())
+            throw error("Unterminated string literal", start);
+
+        char c = symbol();
+        uint32_t digit;
+        if (c >= '0' && c <= '9')
+            digit = static_cast<uint32_t>(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            digit = static_cast<uint32_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            digit = static_cast<uint32_t>(c - 'A' + 10);
+        else
+            throw error("Invalid unicode escape", escape);
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+/// Decodes a \u escape and appends the character as UTF-8. Characters outside the basic
+/// multilingual plane are escaped as a UTF-16 surrogate pair, i.e. two consecutive escapes, which
+/// are combined into a single code point. A surrogate which is not part of a pair is an error,
+/// as it cannot be represented in UTF-8
+void JSONLexer::lex_unicode_escape(std::string &out)
+{
+    const size_t escape = idx - 1;
+    uint32_t code_point = lex_hex4();
+    if (code_point >= 0xDC00 && code_point <= 0xDFFF)
+        throw error("Unpaired unicode surrogate", escape);
+
+    if (code_point >= 0xD800 && code_point <= 0xDBFF)
+    {
+        if (idx + 2 >= buffer.size() || buffer[idx + 1] != '\\' || buffer[idx + 2] != 'u')
+            throw error("Unpaired unicode surrogate", escape);
+        // Move to the u of the second escape
+        advance();
+        advance();
+        uint32_t low = lex_hex4();
+        if (low < 0xDC00 || low > 0xDFFF)
+            throw error("Unpaired unicode surrogate", escape);
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+    json_utf8_append(out, code_point);
 }
 
 /// @brief This function scans the input for a number
@@ -171,8 +242,10 @@ Token JSONLexer::lex_string()
 /// number.
 Token JSONLexer::lex_number()
 {
+    JSON_STATS_TIMER(stats, number_cycles);
     Token t;
-    std::string number;
+    std::string &number = scratch;
+    number.clear();
 
     // These flags are used to ensure that only a single decimal point / e should exist in a number
     bool decimal_point_found = false;
@@ -190,7 +263,7 @@ Token JSONLexer::lex_number()
     {
         // But if a dash (minus sign) has been found, this becomes an invalid token
         if (number.size() > 0)
-            throw json_parse_error("Invalid literal \"-\"");
+            throw error("Invalid literal \"-\"", start);
         return t;
     }
 
@@ -224,26 +297,39 @@ Token JSONLexer::lex_number()
         }
         else
         {
-            throw json_parse_error(std::string("Invalid literal '") + symbol() +
-                                   std::string("' for number"));
+            throw error(std::string("Invalid literal '") + symbol() + std::string("' for number"),
+                        idx);
         }
         last = symbol();
         advance();
     }
+    if (number.size() > limits.max_number_length)
+        throw json_limit_error("max_number_length", limits.max_number_length, start);
     // Check if the number detected is a real number
     if (decimal_point_found || e_found)
     {
         // Detect cases where e is at the end of the number, e.g. 3e or 3e+
         if (number.back() == 'e' || number.back() == 'E' || number.back() == '+' ||
             number.back() == '-')
-            throw json_parse_error("Incomplete number");
+            throw error("Incomplete number", start);
         t.type = Token::Type::NUMBER_REAL;
-        t.value = std::stold(number);
     }
     else
     {
         t.type = Token::Type::NUMBER_INTEGER;
-        t.value = std::stoll(number);
+    }
+    // An integer which does not fit in 64 bits, or a real whose exponent is too large or too small
+    // for a long double, is an error rather than a rounded value
+    try
+    {
+        if (t.type == Token::Type::NUMBER_REAL)
+            t.value = std::stold(number);
+        else
+            t.value = std::stoll(number);
+    }
+    catch (const std::out_of_range &)
+    {
+        throw error("Number out of range", start);
     }
     return t;
 }
@@ -255,8 +341,10 @@ Token JSONLexer::lex_number()
 /// literal.
 Token JSONLexer::lex_literal()
 {
+    JSON_STATS_TIMER(stats, literal_cycles);
     Token token;
-    std::string literal;
+    std::string &literal = scratch;
+    literal.clear();
     while (available() && !is_stop())
     {
         literal.push_back(symbol());
@@ -271,16 +359,18 @@ Token JSONLexer::lex_literal()
     else if (literal == "false")
         token.type = Token::Type::LITERAL_FALSE;
     else
-        throw json_parse_error(std::string("Invalid literal \"") + std::string(literal) +
-                               std::string("\""));
+        throw error(std::string("Invalid literal \"") + std::string(literal) + std::string("\""),
+                    start);
     return token;
 }
 
 /// Default constructor for the lexer, initializes variables to their default values
 /// A call to load is needed later to be able to tokenize the input
-JSONLexer::JSONLexer() : idx(0) {}
+JSONLexer::JSONLexer() : idx(0), start(0), stats(nullptr) {}
 
-JSONLexer::JSONLexer(const std::string &buffer) : buffer(buffer), idx(0) {}
+JSONLexer::JSONLexer(const std::string &buffer) : buffer(buffer), idx(0), start(0), stats(nullptr)
+{
+}
 
 /// @brief This method detects tokens in the input string.
 /// This method scans the input and returns the next token found.
@@ -290,31 +380,29 @@ Token JSONLexer::next()
 {
     // If we have reached the end of the buffer, throw an error
     if (!is_next())
-        throw json_parse_error();
+        throw error("Unexpected end of input", idx);
 
+    start = idx;
     Token token;
 
-    if ((token = lex_single_symbol_token()).type != Token::Type::UNKNOWN)
-        return token;
-
-    if ((token = lex_string()).type != Token::Type::UNKNOWN)
-        return token;
-
-    if ((token = lex_number()).type != Token::Type::UNKNOWN)
-        return token;
-
-    if ((token = lex_literal()).type != Token::Type::UNKNOWN)
-        return token;
+    if ((token = lex_single_symbol_token()).type == Token::Type::UNKNOWN &&
+        (token = lex_string()).type == Token::Type::UNKNOWN &&
+        (token = lex_number()).type == Token::Type::UNKNOWN &&
+        (token = lex_literal()).type == Token::Type::UNKNOWN)
+        throw error("Invalid JSON", start);
 
-    else
-        throw json_parse_error("Invalid JSON");
+    token.offset = start;
+    JSON_STATS(record(token));
+    return token;
 }
 
-/// Loads the given input string
-void JSONLexer::load(const std::string &s)
+/// Loads the given input string. The input is copied into the buffer of the previous one, which
+/// is only reallocated when the input is larger than any loaded before
+void JSONLexer::load(std::string_view s)
 {
-    buffer = s;
+    buffer.assign(s.data(), s.size());
     idx = 0;
+    start = 0;
 }
 
 /// Checks if there are any characters left to be processed
@@ -324,3 +412,109 @@ bool JSONLexer::is_next()
     skip_whitespace();
     return idx < buffer.size();
 }
+
+size_t JSONLexer::position() const { return idx; }
+
+size_t JSONLexer::size() const { return buffer.size(); }
+
+/// Checks that the whole input is well formed UTF-8, throws json_parse_error with the offset of
+/// the first invalid byte otherwise
+void JSONLexer::validate_utf8() const
+{
+    size_t invalid = json_validate_utf8(buffer.data(), buffer.size());
+    if (invalid != buffer.size())
+        throw error("Invalid UTF-8", invalid);
+}
+
+/// @brief Counts the newline characters in a block of memory.
+/// The block is processed eight bytes at a time, a byte equal to '\n' is turned into 0x80 and all
+/// other bytes into 0, so that the newlines in a word can be summed with a single multiplication.
+/// This is only used when reporting errors, so that lexing itself never has to track lines.
+static size_t count_newlines(const char *data, size_t length)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t low_bits = 0x7F7F7F7F7F7F7F7FULL;
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        uint64_t x = word ^ (ones * '\n');
+        // The high bit of each byte is set only if that byte of x is zero
+        uint64_t zero = ~(((x & low_bits) + low_bits) | x | low_bits);
+        count += static_cast<size_t>(((zero >> 7) * ones) >> 56);
+    }
+    for (; i < length; i++)
+        count += data[i] == '\n';
+    return count;
+}
+
+/// @brief Computes the line and column of a byte offset in the loaded input.
+/// The lines before the offset are counted by scanning the buffer, so this is O(offset) and is
+/// meant to be called only after an error has occured.
+/// @param offset Byte offset, usually obtained from json_parse_error::offset()
+SourceLocation JSONLexer::location(size_t offset) const
+{
+    if (offset > buffer.size())
+        offset = buffer.size();
+    SourceLocation loc;
+    loc.line = count_newlines(buffer.data(), offset) + 1;
+    size_t line_start = offset == 0 ? std::string::npos : buffer.rfind('\n', offset - 1);
+    loc.column = line_start == std::string::npos ? offset + 1 : offset - line_start;
+    return loc;
+}
+
+/// @brief Creates a json_parse_error which points to the given offset. A short excerpt of the
+/// input around the offset is copied into the error, with control characters replaced by spaces.
+json_parse_error JSONLexer::error(const std::string &message, size_t offset) const
+{
+    return json_error_at(message, buffer, offset);
+}
+
+/// Creates a parse error for an offset in any input, as JSONLexer::error() does for its buffer
+json_parse_error json_error_at(const std::string &message, std::string_view input, size_t offset)
+{
+    const size_t radius = 16;
+    if (offset > input.size())
+        offset = input.size();
+    size_t begin = offset > radius ? offset - radius : 0;
+    std::string excerpt(input.substr(begin, 2 * radius));
+    for (auto &ch : excerpt)
+    {
+        if (static_cast<unsigned char>(ch) < 0x20)
+            ch = ' ';
+    }
+    return json_parse_error(message, offset, excerpt);
+}
+
+/// Sets the statistics which are updated while lexing, or nullptr to not record them.
+/// Statistics are only recorded when the library is built with JSONPARSER_STATS
+void JSONLexer::set_stats(ParseStats *s) { stats = s; }
+
+void JSONLexer::set_limits(const ParseLimits &l) { limits = l; }
+
+/// Counts a scanned token and the bytes of input it took up
+void JSONLexer::record(const Token &token)
+{
+    if (!stats)
+        return;
+    stats->tokens[static_cast<size_t>(token.type)]++;
+    switch (token.type)
+    {
+    case Token::Type::STRING:
+        stats->string_bytes += idx - start;
+        break;
+    case Token::Type::NUMBER_INTEGER:
+    case Token::Type::NUMBER_REAL:
+        stats->number_bytes += idx - start;
+        break;
+    case Token::Type::LITERAL_TRUE:
+    case Token::Type::LITERAL_FALSE:
+    case Token::Type::LITERAL_NULL:
+        stats->literal_bytes += idx - start;
+        break;
+    default:
+        break;
+    }
+}
@@ -1,4 +1,5 @@
 #include "json_object.hpp"
+#include <functional>
 
 /*
  * This method acts as a wrapper to the map<std::string, JSONObject> interface, and is used to get the value for a particular key
@@ -12,7 +13,50 @@ JSONObject &JSONObject::operator[](const std::string &s)
     return as_kv_pairs()[s];
 }
 
-JSONObject::JSONObject() : type(JSONObjectType::OBJECT), value(std::map<std::string, JSONObject>())
+/*
+ * Looks up a key without modifying the object
+ * @param key - key to find
+ * @return Pointer to the value, or nullptr if this is not an object or the key does not exist
+ */
+const JSONObject *JSONObject::find(std::string_view key) const
+{
+    auto kv = get_if<Members>();
+    if (!kv)
+        return nullptr;
+    auto it = kv->find(key);
+    if (it == kv->end())
+        return nullptr;
+    return &it->second;
+}
+
+/*
+ * Returns the value for a key, throws an access error if this is not an object or if the key
+ * does not exist
+ */
+const JSONObject &JSONObject::at(std::string_view key) const
+{
+    auto result = find(key);
+    if (!result)
+        throw json_access_error("Key \"" + std::string(key) + "\" not found");
+    return *result;
+}
+
+/*
+ * Returns the element at an index, throws an access error if this is not an array or if the index
+ * is out of range
+ */
+const JSONObject &JSONObject::at(size_t index) const
+{
+    auto elements = get_if<Elements>();
+    if (!elements || index >= elements->size())
+        throw json_access_error("Index " + std::to_string(index) + " out of range");
+    return (*elements)[index];
+}
+
+bool JSONObject::contains(std::string_view key) const { return find(key) != nullptr; }
+
+JSONObject::JSONObject()
+    : type(JSONObjectType::OBJECT), value(std::shared_ptr<JSONShared<Members>>())
 {
 }
 
@@ -38,10 +82,10 @@ JSONObject::JSONObject(JSONObjectType type) : type(type)
         value = false;
         break;
     case JSONObjectType::OBJECT:
-        value = std::map<std::string, JSONObject>();
+        value = std::shared_ptr<JSONShared<Members>>();
         break;
     case JSONObjectType::ARRAY:
-        value = std::vector<JSONObject>();
+        value = std::shared_ptr<JSONShared<Elements>>();
         break;
     default:
         break;
@@ -54,28 +98,173 @@ JSONObject::JSONObject(long double val) : type(JSONObjectType::NUMBER_REAL), val
 
 JSONObject::JSONObject(const std::string &val) : type(JSONObjectType::STRING), value(val) {}
 
-JSONObject::JSONObject(const std::vector<JSONObject> &val) : type(JSONObjectType::ARRAY), value(val)
+JSONObject::JSONObject(std::string &&val) : type(JSONObjectType::STRING), value(std::move(val)) {}
+
+JSONObject::JSONObject(const std::vector<JSONObject> &val)
+    : type(JSONObjectType::ARRAY),
+      value(val.empty() ? nullptr : std::make_shared<JSONShared<Elements>>(val))
+{
+}
+
+JSONObject::JSONObject(std::vector<JSONObject> &&val)
+    : type(JSONObjectType::ARRAY),
+      value(val.empty() ? nullptr : std::make_shared<JSONShared<Elements>>(std::move(val)))
+{
+}
+
+JSONObject::JSONObject(const Members &val)
+    : type(JSONObjectType::OBJECT),
+      value(val.empty() ? nullptr : std::make_shared<JSONShared<Members>>(val))
+{
+}
+
+JSONObject::JSONObject(Members &&val)
+    : type(JSONObjectType::OBJECT),
+      value(val.empty() ? nullptr : std::make_shared<JSONShared<Members>>(std::move(val)))
 {
 }
 
+/// Returns the container held by storage for modification. A missing container is created and a
+/// container which is shared with another object is copied first, the copy shares the children.
+/// The cached hash is cleared and the container is marked as exposed, since the caller may keep
+/// the reference and modify the container or its children at any later time
+template <typename T> static T &modifiable(std::shared_ptr<JSONShared<T>> &storage)
+{
+    if (!storage)
+        storage = std::make_shared<JSONShared<T>>();
+    else if (storage.use_count() > 1)
+        storage = std::make_shared<JSONShared<T>>(storage->items);
+    else
+        storage->hash.store(0, std::memory_order_relaxed);
+    storage->exposed = true;
+    return storage->items;
+}
+
+/// Returns the container held by storage, or an empty container if none has been allocated
+template <typename T> static const T &readable(const std::shared_ptr<JSONShared<T>> &storage)
+{
+    static const T empty;
+    return storage ? storage->items : empty;
+}
+
 JSONObject::JSONObject(bool val) : type(JSONObjectType::BOOLEAN), value(val) {}
 
+template <typename T> struct is_packed : std::false_type
+{
+};
+
+template <typename T> struct is_packed<std::shared_ptr<JSONPacked<T>>> : std::true_type
+{
+};
+
+/// Calls f with the JSONPacked of a packed array and returns true, or returns false if ob is not a
+/// packed array
+template <typename F> static bool visit_packed(const JSONObject &ob, F &&f)
+{
+    return std::visit(
+        [&f](auto &storage)
+        {
+            if constexpr (is_packed<std::decay_t<decltype(storage)>>::value)
+            {
+                f(*storage);
+                return true;
+            }
+            else
+                return false;
+        },
+        ob.value);
+}
+
+template <typename T> static std::vector<JSONObject> expand(const JSONPacked<T> &packed)
+{
+    std::vector<JSONObject> elements;
+    elements.reserve(packed.values.size());
+    for (auto value : packed.values)
+        elements.push_back(JSONObject(static_cast<T>(value)));
+    return elements;
+}
+
+/// Returns the JSONObjects of the elements of a packed array, building them on the first call.
+/// Threads which race to build them all get the ones which were stored first
+template <typename T> static const std::vector<JSONObject> &expanded(const JSONPacked<T> &packed)
+{
+    auto elements = packed.elements.load(std::memory_order_acquire);
+    if (!elements)
+    {
+        auto built = new std::vector<JSONObject>(expand(packed));
+        if (packed.elements.compare_exchange_strong(elements, built, std::memory_order_acq_rel))
+            elements = built;
+        else
+            delete built;
+    }
+    return *elements;
+}
+
+/// Returns the element at index of a packed array, without building the others
+static JSONObject packed_element(const JSONObject &ob, size_t index)
+{
+    JSONObject result;
+    visit_packed(ob,
+                 [&](auto &packed)
+                 {
+                     using T = typename std::decay_t<decltype(packed.values)>::value_type;
+                     result = JSONObject(static_cast<T>(packed.values[index]));
+                 });
+    return result;
+}
+
+/// Returns a copy of the element at an index, building only that element of a packed array
+JSONObject JSONObject::element(size_t index) const
+{
+    if (type != JSONObjectType::ARRAY || index >= size())
+        throw json_access_error("Index " + std::to_string(index) + " out of range");
+    if (packed_type() != JSONObjectType::EMPTY)
+        return packed_element(*this, index);
+    return as_vector()[index];
+}
+
 int64_t &JSONObject::as_integer() { return std::get<int64_t>(value); }
 
 bool &JSONObject::as_bool() { return std::get<bool>(value); }
 
 long double &JSONObject::as_real() { return std::get<long double>(value); }
 
+/// Returns the elements for modification, a packed array is turned back into a vector first
 std::vector<JSONObject> &JSONObject::as_vector()
 {
-    return std::get<std::vector<JSONObject>>(value);
+    std::vector<JSONObject> elements;
+    if (visit_packed(*this, [&elements](auto &packed) { elements = expand(packed); }))
+        value = std::make_shared<JSONShared<Elements>>(std::move(elements));
+    return modifiable(std::get<std::shared_ptr<JSONShared<Elements>>>(value));
 }
 
 std::string &JSONObject::as_string() { return std::get<std::string>(value); }
 
-std::map<std::string, JSONObject> &JSONObject::as_kv_pairs()
+std::map<std::string, JSONObject, std::less<>> &JSONObject::as_kv_pairs()
 {
-    return std::get<std::map<std::string, JSONObject>>(value);
+    return modifiable(std::get<std::shared_ptr<JSONShared<Members>>>(value));
+}
+
+const int64_t &JSONObject::as_integer() const { return std::get<int64_t>(value); }
+
+const bool &JSONObject::as_bool() const { return std::get<bool>(value); }
+
+const long double &JSONObject::as_real() const { return std::get<long double>(value); }
+
+/// Returns the elements, the JSONObjects of a packed array are built once, on the first call
+const std::vector<JSONObject> &JSONObject::as_vector() const
+{
+    const std::vector<JSONObject> *elements = nullptr;
+    if (visit_packed(*this, [&elements](auto &packed) { elements = &expanded(packed); }))
+        return *elements;
+    return readable(std::get<std::shared_ptr<JSONShared<Elements>>>(value));
+}
+
+const std::string &JSONObject::as_string() const { return std::get<std::string>(value); }
+
+const std::map<std::string, JSONObject, std::less<>> &JSONObject::as_kv_pairs() const
+{
+    return readable(std::get<std::shared_ptr<JSONShared<Members>>>(value));
 }
 
 /* 
@@ -83,11 +272,438 @@ std::map<std::string, JSONObject> &JSONObject::as_kv_pairs()
  * If this object is an object, returns the number of keys
  * Else throws an json_access_error
  */
-size_t JSONObject::size()
+size_t JSONObject::size() const
 {
     if (type == JSONObjectType::OBJECT)
         return as_kv_pairs().size();
     if (type == JSONObjectType::ARRAY)
+    {
+        size_t count = 0;
+        if (visit_packed(*this, [&count](auto &packed) { count = packed.values.size(); }))
+            return count;
         return as_vector().size();
+    }
     throw json_access_error();
-}
\ No newline at end of file
+}
+
+JSONObjectType JSONObject::packed_type() const
+{
+    if (packed<int64_t>())
+        return JSONObjectType::NUMBER_INT;
+    if (packed<long double>())
+        return JSONObjectType::NUMBER_REAL;
+    if (packed<bool>())
+        return JSONObjectType::BOOLEAN;
+    return JSONObjectType::EMPTY;
+}
+
+template <typename T, typename Get>
+static std::shared_ptr<JSONPacked<T>> make_packed(const JSONShared<JSONObject::Elements> &storage,
+                                                  Get get)
+{
+    std::vector<T> values;
+    values.reserve(storage.items.size());
+    for (auto &element : storage.items)
+        values.push_back(get(element));
+    auto packed = std::make_shared<JSONPacked<T>>(std::move(values));
+    packed->hash.store(storage.hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return packed;
+}
+
+/// Packs the elements of an array of integers, reals or booleans, see json_object.hpp. A hash
+/// cached for the elements stays valid, as the value of the array does not change
+bool JSONObject::pack()
+{
+    if (type != JSONObjectType::ARRAY)
+        return false;
+    if (packed_type() != JSONObjectType::EMPTY)
+        return true;
+    auto &storage = std::get<std::shared_ptr<JSONShared<Elements>>>(value);
+    if (!storage || storage->items.empty())
+        return false;
+    auto element_type = storage->items.front().type;
+    for (auto &element : storage->items)
+    {
+        if (element.type != element_type)
+            return false;
+    }
+    switch (element_type)
+    {
+    case JSONObjectType::NUMBER_INT:
+        value = make_packed<int64_t>(*storage, [](const JSONObject &ob)
+                                     { return ob.as_integer(); });
+        return true;
+    case JSONObjectType::NUMBER_REAL:
+        value = make_packed<long double>(*storage, [](const JSONObject &ob)
+                                         { return ob.as_real(); });
+        return true;
+    case JSONObjectType::BOOLEAN:
+        value = make_packed<bool>(*storage, [](const JSONObject &ob) { return ob.as_bool(); });
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t JSONMemoryUsage::string_size(size_t capacity)
+{
+    static const size_t inline_capacity = std::string().capacity();
+    return capacity > inline_capacity ? capacity + 1 : 0;
+}
+
+size_t JSONMemoryUsage::member_size()
+{
+    using Pair = std::pair<const std::string, JSONObject>;
+    // A red black tree node holds its color and three links in front of the value, in libstdc++,
+    // libc++ and the MSVC standard library alike
+    constexpr size_t links =
+        (4 * sizeof(void *) + alignof(Pair) - 1) / alignof(Pair) * alignof(Pair);
+    return links + sizeof(Pair) - sizeof(JSONObject);
+}
+
+/// Records the size of the blocks which std::make_shared allocates. The allocator is stateless like
+/// std::allocator, so that the block has the same layout as the one of std::make_shared
+template <typename T> struct JSONRecordingAllocator
+{
+    using value_type = T;
+    static inline thread_local size_t recorded = 0;
+
+    JSONRecordingAllocator() = default;
+    template <typename U> JSONRecordingAllocator(const JSONRecordingAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        JSONRecordingAllocator<char>::recorded = n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n) { std::allocator<T>().deallocate(p, n); }
+
+    template <typename U> bool operator==(const JSONRecordingAllocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const JSONRecordingAllocator<U> &) const { return false; }
+};
+
+/// The size of the control block differs between standard libraries, so it is measured once
+template <typename T> static size_t shared_block_size()
+{
+    static const size_t size = []
+    {
+        std::allocate_shared<T>(JSONRecordingAllocator<T>());
+        return JSONRecordingAllocator<char>::recorded;
+    }();
+    return size;
+}
+
+size_t JSONMemoryUsage::shared_size(JSONObjectType type)
+{
+    if (type == JSONObjectType::OBJECT)
+        return shared_block_size<JSONShared<JSONObject::Members>>();
+    if (type == JSONObjectType::ARRAY)
+        return shared_block_size<JSONShared<JSONObject::Elements>>();
+    return 0;
+}
+
+template <typename T> static size_t values_size(const std::vector<T> &values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+/// std::vector<bool> stores its bits in words of unsigned long
+static size_t values_size(const std::vector<bool> &values)
+{
+    const size_t word = sizeof(unsigned long) * 8;
+    return (values.capacity() + word - 1) / word * sizeof(unsigned long);
+}
+
+static void add_memory_usage(const JSONObject &ob, JSONMemoryUsage &usage)
+{
+    switch (ob.type)
+    {
+    case JSONObjectType::STRING:
+        usage.strings += JSONMemoryUsage::string_size(ob.as_string().capacity());
+        break;
+    case JSONObjectType::OBJECT:
+        if (!ob.as_kv_pairs().empty())
+            usage.shared += JSONMemoryUsage::shared_size(ob.type);
+        for (auto &pair : ob.as_kv_pairs())
+        {
+            usage.objects += JSONMemoryUsage::member_size();
+            usage.nodes += sizeof(JSONObject);
+            usage.strings += JSONMemoryUsage::string_size(pair.first.capacity());
+            add_memory_usage(pair.second, usage);
+        }
+        break;
+    case JSONObjectType::ARRAY:
+    {
+        auto add_packed = [&usage](auto &packed)
+        {
+            usage.shared += shared_block_size<std::decay_t<decltype(packed)>>();
+            usage.packed += values_size(packed.values);
+        };
+        if (visit_packed(ob, add_packed))
+            break;
+        auto &elements = ob.as_vector();
+        if (!elements.empty())
+            usage.shared += JSONMemoryUsage::shared_size(ob.type);
+        usage.arrays += (elements.capacity() - elements.size()) * sizeof(JSONObject);
+        usage.nodes += elements.size() * sizeof(JSONObject);
+        for (auto &element : elements)
+            add_memory_usage(element, usage);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/// Returns the heap memory held by this object and everything below it, split by what it is used
+/// for. The figures are exact for the allocations made by the standard containers, so that
+/// memory_usage().total() is what a copy of the tree allocates. The JSONObjects which the const
+/// as_vector() builds for a packed array are not counted
+JSONMemoryUsage JSONObject::memory_usage() const
+{
+    JSONMemoryUsage usage;
+    add_memory_usage(*this, usage);
+    return usage;
+}
+
+/// Copies the containers of the whole tree, so that the result shares nothing with this object,
+/// for example to release the memory of a large document of which only a part is kept
+JSONObject JSONObject::clone() const
+{
+    if (type == JSONObjectType::OBJECT)
+    {
+        Members members;
+        for (auto &pair : as_kv_pairs())
+            members.emplace_hint(members.end(), pair.first, pair.second.clone());
+        return JSONObject(std::move(members));
+    }
+    if (type == JSONObjectType::ARRAY)
+    {
+        JSONObject result(JSONObjectType::ARRAY);
+        auto copy = [&result](auto &packed)
+        {
+            auto values = packed.values;
+            using T = typename decltype(values)::value_type;
+            result.value = std::make_shared<JSONPacked<T>>(std::move(values));
+        };
+        if (visit_packed(*this, copy))
+            return result;
+
+        std::vector<JSONObject> elements;
+        elements.reserve(as_vector().size());
+        for (auto &element : as_vector())
+            elements.push_back(element.clone());
+        return JSONObject(std::move(elements));
+    }
+    return *this;
+}
+
+/// Mixes value into seed, so that the order of the combined values matters
+static uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    // The finalizer of splitmix64
+    uint64_t x = seed + 0x9E3779B97F4A7C15ULL + value;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/// Returns the cached hash of a container, or computes and caches it. Zero is reserved to mark a
+/// hash which has not been computed. The hash of an exposed container is computed every time
+template <typename T, typename Compute>
+static uint64_t cached(const std::shared_ptr<JSONShared<T>> &storage, Compute compute)
+{
+    if (!storage)
+        return compute(T());
+    if (storage->exposed)
+        return compute(storage->items);
+    uint64_t hash = storage->hash.load(std::memory_order_relaxed);
+    if (hash == 0)
+    {
+        hash = compute(storage->items);
+        if (hash == 0)
+            hash = 1;
+        storage->hash.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+/// Hashes a packed array as the same array of JSONObjects is hashed
+template <typename T> static uint64_t packed_hash(const JSONPacked<T> &packed, uint64_t seed)
+{
+    uint64_t hash = packed.hash.load(std::memory_order_relaxed);
+    if (hash == 0)
+    {
+        hash = hash_combine(seed, packed.values.size());
+        for (auto value : packed.values)
+            hash = hash_combine(hash, JSONObject(static_cast<T>(value)).hash());
+        if (hash == 0)
+            hash = 1;
+        packed.hash.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+/// Hashes leaves from their value, and containers from their size and contents in order
+size_t JSONObject::hash() const
+{
+    const auto seed = static_cast<uint64_t>(type);
+    switch (type)
+    {
+    case JSONObjectType::NUMBER_REAL:
+    {
+        // Zero and negative zero are equal, so they have to hash alike
+        long double real = as_real();
+        if (!(real < 0) && !(real > 0))
+            real = 0;
+        return hash_combine(seed, std::hash<long double>()(real));
+    }
+    case JSONObjectType::NUMBER_INT:
+        return hash_combine(seed, static_cast<uint64_t>(as_integer()));
+    case JSONObjectType::STRING:
+        return hash_combine(seed, std::hash<std::string>()(as_string()));
+    case JSONObjectType::BOOLEAN:
+        return hash_combine(seed, as_bool());
+    case JSONObjectType::OBJECT:
+        return cached(std::get<std::shared_ptr<JSONShared<Members>>>(value),
+                      [seed](const Members &members)
+                      {
+                          uint64_t hash = hash_combine(seed, members.size());
+                          for (auto &pair : members)
+                          {
+                              hash = hash_combine(hash, std::hash<std::string>()(pair.first));
+                              hash = hash_combine(hash, pair.second.hash());
+                          }
+                          return hash;
+                      });
+    case JSONObjectType::ARRAY:
+    {
+        uint64_t result = 0;
+        auto hash_packed = [seed, &result](auto &packed) { result = packed_hash(packed, seed); };
+        if (visit_packed(*this, hash_packed))
+            return result;
+        return cached(std::get<std::shared_ptr<JSONShared<Elements>>>(value),
+                      [seed](const Elements &elements)
+                      {
+                          uint64_t hash = hash_combine(seed, elements.size());
+                          for (auto &element : elements)
+                              hash = hash_combine(hash, element.hash());
+                          return hash;
+                      });
+    }
+    default:
+        return hash_combine(seed, 0);
+    }
+}
+
+/// Returns the hash cached in a container, an empty container has a fixed hash which is cheap
+template <typename T>
+static std::optional<uint64_t> cached_only(const std::shared_ptr<JSONShared<T>> &storage)
+{
+    if (!storage)
+        return std::nullopt;
+    uint64_t hash = storage->hash.load(std::memory_order_relaxed);
+    if (hash == 0)
+        return std::nullopt;
+    return hash;
+}
+
+std::optional<size_t> JSONObject::cached_hash() const
+{
+    std::optional<uint64_t> result;
+    if (type == JSONObjectType::OBJECT && size() != 0)
+        result = cached_only(std::get<std::shared_ptr<JSONShared<Members>>>(value));
+    else if (packed_type() != JSONObjectType::EMPTY)
+    {
+        visit_packed(*this,
+                     [&result](auto &packed)
+                     {
+                         if (auto hash = packed.hash.load(std::memory_order_relaxed))
+                             result = hash;
+                     });
+    }
+    else if (type == JSONObjectType::ARRAY && size() != 0)
+        result = cached_only(std::get<std::shared_ptr<JSONShared<Elements>>>(value));
+    else
+        result = hash();
+    if (!result)
+        return std::nullopt;
+    return static_cast<size_t>(*result);
+}
+
+/// Compares two containers, which are equal at once if they are shared and unequal at once if
+/// both have a cached hash and the hashes differ
+template <typename T>
+static bool equal(const std::shared_ptr<JSONShared<T>> &a, const std::shared_ptr<JSONShared<T>> &b)
+{
+    if (a == b)
+        return true;
+    if (!a || !b)
+        return (a ? a->items.size() : 0) == (b ? b->items.size() : 0);
+    auto hash_a = cached_only(a);
+    auto hash_b = cached_only(b);
+    if (hash_a && hash_b && *hash_a != *hash_b)
+        return false;
+    return a->items == b->items;
+}
+
+/// Compares two arrays of which at least one is packed, without building the JSONObjects of the
+/// packed elements
+static bool equal_packed(const JSONObject &a, const JSONObject &b)
+{
+    if (a.size() != b.size())
+        return false;
+    auto hash_a = a.cached_hash();
+    auto hash_b = b.cached_hash();
+    if (hash_a && hash_b && *hash_a != *hash_b)
+        return false;
+    if (a.packed_type() == b.packed_type())
+    {
+        if (auto integers = a.packed<int64_t>())
+            return *integers == *b.packed<int64_t>();
+        if (auto reals = a.packed<long double>())
+            return *reals == *b.packed<long double>();
+        return *a.packed<bool>() == *b.packed<bool>();
+    }
+    const JSONObject &packed = a.packed_type() != JSONObjectType::EMPTY ? a : b;
+    const JSONObject &other = a.packed_type() != JSONObjectType::EMPTY ? b : a;
+    if (other.packed_type() != JSONObjectType::EMPTY)
+        return false;
+    auto &elements = other.as_vector();
+    for (size_t i = 0; i < elements.size(); i++)
+    {
+        if (packed_element(packed, i) != elements[i])
+            return false;
+    }
+    return true;
+}
+
+bool operator==(const JSONObject &a, const JSONObject &b)
+{
+    if (a.type != b.type)
+        return false;
+    switch (a.type)
+    {
+    case JSONObjectType::NUMBER_REAL:
+        return !(a.as_real() < b.as_real()) && !(a.as_real() > b.as_real());
+    case JSONObjectType::NUMBER_INT:
+        return a.as_integer() == b.as_integer();
+    case JSONObjectType::STRING:
+        return a.as_string() == b.as_string();
+    case JSONObjectType::BOOLEAN:
+        return a.as_bool() == b.as_bool();
+    case JSONObjectType::OBJECT:
+        return equal(std::get<std::shared_ptr<JSONShared<JSONObject::Members>>>(a.value),
+                     std::get<std::shared_ptr<JSONShared<JSONObject::Members>>>(b.value));
+    case JSONObjectType::ARRAY:
+        if (a.packed_type() != JSONObjectType::EMPTY || b.packed_type() != JSONObjectType::EMPTY)
+            return equal_packed(a, b);
+        return equal(std::get<std::shared_ptr<JSONShared<JSONObject::Elements>>>(a.value),
+                     std::get<std::shared_ptr<JSONShared<JSONObject::Elements>>>(b.value));
+    default:
+        return true;
+    }
+}
+
+bool operator!=(const JSONObject &a, const JSONObject &b) { return !(a == b); }
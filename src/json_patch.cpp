@@ -0,0 +1,572 @@
+#include "json_patch.hpp"
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+void json_pointer_append(std::string &path, std::string_view key)
+{
+    path.push_back('/');
+    for (char c : key)
+    {
+        if (c == '~')
+            path.append("~0");
+        else if (c == '/')
+            path.append("~1");
+        else
+            path.push_back(c);
+    }
+}
+
+static void append_index(std::string &path, size_t index)
+{
+    path.push_back('/');
+    path.append(std::to_string(index));
+}
+
+/// Returns the elements of an array. The elements of a packed array are built into storage, which
+/// the caller frees once it is done with them, so that they are not kept next to the packed values
+static const JSONObject::Elements &elements_of(const JSONObject &array,
+                                               JSONObject::Elements &storage)
+{
+    if (array.packed_type() == JSONObjectType::EMPTY)
+        return array.as_vector();
+    storage.reserve(array.size());
+    array.for_each_element([&storage](const JSONObject &element) { storage.push_back(element); });
+    return storage;
+}
+
+/// Builds the operations of a patch, path is the JSON Pointer of the value being compared and is
+/// extended and restored while descending
+class JSONDiff
+{
+    JSONObject patch;
+    std::string path;
+    size_t max_array_cost;
+
+    void operation(const char *op, const JSONObject *value)
+    {
+        JSONObject ob;
+        ob["op"] = JSONObject(std::string(op));
+        ob["path"] = JSONObject(path);
+        if (value)
+            ob["value"] = *value;
+        patch.as_vector().push_back(std::move(ob));
+    }
+
+    void at_index(size_t index, const char *op, const JSONObject *value)
+    {
+        auto length = path.size();
+        append_index(path, index);
+        operation(op, value);
+        path.resize(length);
+    }
+
+    void compare_index(size_t index, const JSONObject &from, const JSONObject &to)
+    {
+        auto length = path.size();
+        append_index(path, index);
+        compare(from, to);
+        path.resize(length);
+    }
+
+    void compare_objects(const JSONObject::Members &from, const JSONObject::Members &to)
+    {
+        // Both maps are sorted, so they are merged like two sorted lists
+        auto a = from.begin();
+        auto b = to.begin();
+        while (a != from.end() || b != to.end())
+        {
+            auto length = path.size();
+            if (b == to.end() || (a != from.end() && a->first < b->first))
+            {
+                json_pointer_append(path, a->first);
+                operation("remove", nullptr);
+                ++a;
+            }
+            else if (a == from.end() || b->first < a->first)
+            {
+                json_pointer_append(path, b->first);
+                operation("add", &b->second);
+                ++b;
+            }
+            else
+            {
+                json_pointer_append(path, a->first);
+                compare(a->second, b->second);
+                ++a;
+                ++b;
+            }
+            path.resize(length);
+        }
+    }
+
+    // Turns from[begin, begin + n) into to[begin, begin + m). Operations are applied in order, so
+    // position tracks the index of the next element in the array as patched so far
+    void compare_arrays(const JSONObject::Elements &from, const JSONObject::Elements &to,
+                        size_t begin, size_t n, size_t m)
+    {
+        if (n == 0 || m == 0 || n > max_array_cost / m)
+        {
+            // Index by index, then remove or add what is left over
+            size_t common = std::min(n, m);
+            for (size_t i = 0; i < common; i++)
+                compare_index(begin + i, from[begin + i], to[begin + i]);
+            for (size_t i = common; i < n; i++)
+                at_index(begin + common, "remove", nullptr);
+            for (size_t i = common; i < m; i++)
+                at_index(begin + i, "add", &to[begin + i]);
+            return;
+        }
+
+        std::vector<size_t> hash_from(n);
+        std::vector<size_t> hash_to(m);
+        for (size_t i = 0; i < n; i++)
+            hash_from[i] = from[begin + i].hash();
+        for (size_t j = 0; j < m; j++)
+            hash_to[j] = to[begin + j].hash();
+        auto equal = [&](size_t i, size_t j)
+        { return hash_from[i] == hash_to[j] && from[begin + i] == to[begin + j]; };
+
+        // lcs[i * (m + 1) + j] is the length of the longest common subsequence of the elements of
+        // from from i onwards and of to from j onwards
+        std::vector<uint32_t> lcs((n + 1) * (m + 1), 0);
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t j = m; j-- > 0;)
+            {
+                if (equal(i, j))
+                    lcs[i * (m + 1) + j] = lcs[(i + 1) * (m + 1) + j + 1] + 1;
+                else
+                    lcs[i * (m + 1) + j] =
+                        std::max(lcs[(i + 1) * (m + 1) + j], lcs[i * (m + 1) + j + 1]);
+            }
+        }
+
+        // Elements removed and added between the same two common elements are paired, so that a
+        // modified element becomes a patch of that element instead of a removal and an addition
+        size_t i = 0;
+        size_t j = 0;
+        size_t position = begin;
+        while (i < n || j < m)
+        {
+            if (i < n && j < m && equal(i, j))
+            {
+                i++;
+                j++;
+                position++;
+                continue;
+            }
+            size_t removed = i;
+            size_t added = j;
+            while ((i < n || j < m) && !(i < n && j < m && equal(i, j)))
+            {
+                if (j == m || (i < n && lcs[(i + 1) * (m + 1) + j] >= lcs[i * (m + 1) + j + 1]))
+                    i++;
+                else
+                    j++;
+            }
+            size_t pairs = std::min(i - removed, j - added);
+            for (size_t k = 0; k < pairs; k++)
+                compare_index(position++, from[begin + removed + k], to[begin + added + k]);
+            for (size_t k = removed + pairs; k < i; k++)
+                at_index(position, "remove", nullptr);
+            for (size_t k = added + pairs; k < j; k++)
+                at_index(position++, "add", &to[begin + k]);
+        }
+    }
+
+    static bool same(const JSONObject &a, const JSONObject &b)
+    {
+        return a.hash() == b.hash() && a == b;
+    }
+
+  public:
+    JSONDiff(size_t max_array_cost)
+        : patch(JSONObjectType::ARRAY), max_array_cost(max_array_cost)
+    {
+    }
+
+    void compare(const JSONObject &from, const JSONObject &to)
+    {
+        if (same(from, to))
+            return;
+        if (from.type == JSONObjectType::OBJECT && to.type == JSONObjectType::OBJECT)
+        {
+            compare_objects(from.as_kv_pairs(), to.as_kv_pairs());
+        }
+        else if (from.type == JSONObjectType::ARRAY && to.type == JSONObjectType::ARRAY)
+        {
+            JSONObject::Elements from_storage;
+            JSONObject::Elements to_storage;
+            auto &a = elements_of(from, from_storage);
+            auto &b = elements_of(to, to_storage);
+            size_t prefix = 0;
+            while (prefix < a.size() && prefix < b.size() && same(a[prefix], b[prefix]))
+                prefix++;
+            size_t suffix = 0;
+            while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+                   same(a[a.size() - 1 - suffix], b[b.size() - 1 - suffix]))
+                suffix++;
+            compare_arrays(a, b, prefix, a.size() - prefix - suffix, b.size() - prefix - suffix);
+        }
+        else
+        {
+            operation("replace", &to);
+        }
+    }
+
+    JSONObject &result() { return patch; }
+};
+
+JSONObject diff(const JSONObject &from, const JSONObject &to, size_t max_array_cost)
+{
+    JSONDiff builder(max_array_cost);
+    builder.compare(from, to);
+    return std::move(builder.result());
+}
+
+/// Splits a JSON Pointer into its reference tokens, with "~1" and "~0" unescaped
+static std::vector<std::string> parse_pointer(std::string_view pointer, size_t operation)
+{
+    std::vector<std::string> tokens;
+    if (pointer.empty())
+        return tokens;
+    if (pointer[0] != '/')
+        throw json_patch_error("Invalid JSON Pointer \"" + std::string(pointer) + "\"", operation);
+    tokens.emplace_back();
+    for (size_t i = 1; i < pointer.size(); i++)
+    {
+        if (pointer[i] == '/')
+        {
+            tokens.emplace_back();
+        }
+        else if (pointer[i] == '~')
+        {
+            if (i + 1 == pointer.size() || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                throw json_patch_error("Invalid escape in JSON Pointer \"" +
+                                           std::string(pointer) + "\"",
+                                       operation);
+            tokens.back().push_back(pointer[++i] == '0' ? '~' : '/');
+        }
+        else
+        {
+            tokens.back().push_back(pointer[i]);
+        }
+    }
+    return tokens;
+}
+
+/// Applies the operations of patches to a document, and records how to undo each of them so that
+/// the document can be restored if a later operation fails. The values which an operation removes
+/// or overwrites are moved into the undo log, so nothing is copied to be able to roll back
+class JSONPatcher
+{
+    using Path = std::vector<std::string>;
+
+    enum class UndoKind
+    {
+        // Remove the value at path, which was added
+        REMOVE,
+        // Add value back at path, where it was removed
+        INSERT,
+        // Put value back at path, where it was replaced
+        REPLACE,
+        // Move the value at path back to from, and put value back at path if replaced is set
+        MOVE,
+    };
+
+    struct Undo
+    {
+        UndoKind kind;
+        Path path;
+        Path from;
+        JSONObject value;
+        bool replaced;
+    };
+
+    JSONObject &doc;
+    std::vector<Undo> log;
+    size_t operation;
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw json_patch_error(message, operation);
+    }
+
+    // Parses an array index, "-" stands for the end of the array and is only valid when adding
+    size_t index_of(const std::string &token, size_t size, bool end_allowed) const
+    {
+        if (end_allowed && token == "-")
+            return size;
+        bool digits = !token.empty() && (token.size() == 1 || token[0] != '0');
+        for (char c : token)
+            digits = digits && c >= '0' && c <= '9';
+        if (!digits)
+            fail("Invalid array index \"" + token + "\"");
+        size_t index = 0;
+        auto result = std::from_chars(token.data(), token.data() + token.size(), index);
+        if (result.ec != std::errc() || index > size || (index == size && !end_allowed))
+            fail("Array index " + token + " is out of range");
+        return index;
+    }
+
+    JSONObject &child(JSONObject &ob, const std::string &token) const
+    {
+        if (ob.type == JSONObjectType::OBJECT)
+        {
+            auto &members = ob.as_kv_pairs();
+            auto it = members.find(token);
+            if (it == members.end())
+                fail("Member \"" + token + "\" not found");
+            return it->second;
+        }
+        if (ob.type == JSONObjectType::ARRAY)
+        {
+            auto &elements = ob.as_vector();
+            return elements[index_of(token, elements.size(), false)];
+        }
+        fail("Cannot find \"" + token + "\" in a value which is not an object or array");
+    }
+
+    // Returns the value at path, or the container holding it if parent is set
+    JSONObject &locate(const Path &path, bool parent = false) const
+    {
+        JSONObject *ob = &doc;
+        for (size_t i = 0; i + (parent ? 1 : 0) < path.size(); i++)
+            ob = &child(*ob, path[i]);
+        return *ob;
+    }
+
+    // Adds value at path, and returns the value it replaced if path is an existing member of an
+    // object. An index of "-" in path is replaced by the index at which value was inserted.
+    // value is only moved from once nothing can fail anymore
+    std::optional<JSONObject> add(Path &path, JSONObject &&value)
+    {
+        if (path.empty())
+            return std::exchange(doc, std::move(value));
+        auto &container = locate(path, true);
+        if (container.type == JSONObjectType::OBJECT)
+        {
+            auto [it, inserted] = container.as_kv_pairs().try_emplace(path.back());
+            if (inserted)
+            {
+                it->second = std::move(value);
+                return std::nullopt;
+            }
+            return std::exchange(it->second, std::move(value));
+        }
+        if (container.type == JSONObjectType::ARRAY)
+        {
+            auto &elements = container.as_vector();
+            auto index = index_of(path.back(), elements.size(), true);
+            elements.insert(elements.begin() + static_cast<ptrdiff_t>(index), std::move(value));
+            path.back() = std::to_string(index);
+            return std::nullopt;
+        }
+        fail("Cannot add to a value which is not an object or array");
+    }
+
+    // Removes the value at path and returns it
+    JSONObject take(const Path &path)
+    {
+        if (path.empty())
+            fail("Cannot remove the whole document");
+        auto &container = locate(path, true);
+        JSONObject value = std::move(child(container, path.back()));
+        if (container.type == JSONObjectType::OBJECT)
+        {
+            container.as_kv_pairs().erase(path.back());
+        }
+        else
+        {
+            auto &elements = container.as_vector();
+            auto index = index_of(path.back(), elements.size(), false);
+            elements.erase(elements.begin() + static_cast<ptrdiff_t>(index));
+        }
+        return value;
+    }
+
+    const JSONObject &member(const JSONObject &op, const char *key) const
+    {
+        auto value = op.find(key);
+        if (!value)
+            fail(std::string("Missing \"") + key + "\"");
+        return *value;
+    }
+
+    Path pointer(const JSONObject &op, const char *key) const
+    {
+        auto &value = member(op, key);
+        if (value.type != JSONObjectType::STRING)
+            fail(std::string("\"") + key + "\" is not a string");
+        return parse_pointer(value.as_string(), operation);
+    }
+
+    void record_add(Path &&path, std::optional<JSONObject> &&replaced)
+    {
+        if (replaced)
+            log.push_back({UndoKind::REPLACE, std::move(path), {}, std::move(*replaced), false});
+        else
+            log.push_back({UndoKind::REMOVE, std::move(path), {}, JSONObject(), false});
+    }
+
+  public:
+    JSONPatcher(JSONObject &doc) : doc(doc), operation(0) {}
+
+    void apply(const JSONObject &op)
+    {
+        if (op.type != JSONObjectType::OBJECT)
+            fail("Operation is not an object");
+        auto name = member(op, "op").get_or<std::string_view>("");
+        auto path = pointer(op, "path");
+        if (name == "add")
+        {
+            auto replaced = add(path, JSONObject(member(op, "value")));
+            record_add(std::move(path), std::move(replaced));
+        }
+        else if (name == "remove")
+        {
+            auto value = take(path);
+            log.push_back({UndoKind::INSERT, std::move(path), {}, std::move(value), false});
+        }
+        else if (name == "replace")
+        {
+            auto &value = member(op, "value");
+            auto &target = locate(path);
+            log.push_back(
+                {UndoKind::REPLACE, std::move(path), {}, std::exchange(target, value), false});
+        }
+        else if (name == "move")
+        {
+            auto from = pointer(op, "from");
+            if (from == path)
+                return;
+            if (from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin()))
+                fail("Cannot move a value into itself");
+            // The value waits in the log, so that it is put back if it cannot be added at path.
+            // Once it is added, the entry becomes a single MOVE which also holds the value it
+            // replaced, as path may be an ancestor of from or the whole document
+            log.push_back({UndoKind::INSERT, from, {}, take(from), false});
+            auto replaced = add(path, std::move(log.back().value));
+            auto &undo = log.back();
+            undo.kind = UndoKind::MOVE;
+            undo.from = std::move(undo.path);
+            undo.path = std::move(path);
+            undo.value = replaced ? std::move(*replaced) : JSONObject();
+            undo.replaced = replaced.has_value();
+        }
+        else if (name == "copy")
+        {
+            JSONObject value = locate(pointer(op, "from"));
+            auto replaced = add(path, std::move(value));
+            record_add(std::move(path), std::move(replaced));
+        }
+        else if (name == "test")
+        {
+            if (locate(path) != member(op, "value"))
+                fail("Test failed");
+        }
+        else
+        {
+            fail("Unknown operation \"" + std::string(name) + "\"");
+        }
+    }
+
+    void apply_all(const JSONObject &patch)
+    {
+        if (patch.type != JSONObjectType::ARRAY)
+            fail("Patch is not an array");
+        for (auto &op : patch.as_vector())
+        {
+            apply(op);
+            operation++;
+        }
+    }
+
+    // Undoes every operation applied so far, in reverse order. Every step is the inverse of an
+    // operation which succeeded on the same document, so its paths resolve and nothing can fail
+    void rollback() noexcept
+    {
+        while (!log.empty())
+        {
+            auto &undo = log.back();
+            switch (undo.kind)
+            {
+            case UndoKind::REMOVE:
+                take(undo.path);
+                break;
+            case UndoKind::INSERT:
+                add(undo.path, std::move(undo.value));
+                break;
+            case UndoKind::REPLACE:
+                locate(undo.path) = std::move(undo.value);
+                break;
+            case UndoKind::MOVE:
+            {
+                JSONObject value;
+                if (undo.path.empty())
+                {
+                    value = std::exchange(doc, std::move(undo.value));
+                }
+                else
+                {
+                    value = take(undo.path);
+                    if (undo.replaced)
+                        add(undo.path, std::move(undo.value));
+                }
+                add(undo.from, std::move(value));
+                break;
+            }
+            }
+            log.pop_back();
+        }
+    }
+};
+
+void apply_patch(JSONObject &doc, const JSONObject &patch)
+{
+    JSONPatcher patcher(doc);
+    try
+    {
+        patcher.apply_all(patch);
+    }
+    catch (...)
+    {
+        patcher.rollback();
+        throw;
+    }
+}
+
+void apply_patches(JSONObject &doc, const std::vector<JSONObject> &patches)
+{
+    JSONPatcher patcher(doc);
+    try
+    {
+        for (auto &patch : patches)
+            patcher.apply_all(patch);
+    }
+    catch (...)
+    {
+        patcher.rollback();
+        throw;
+    }
+}
+
+void apply_merge_patch(JSONObject &doc, const JSONObject &patch)
+{
+    if (patch.type != JSONObjectType::OBJECT)
+    {
+        doc = patch;
+        return;
+    }
+    if (doc.type != JSONObjectType::OBJECT)
+        doc = JSONObject();
+    auto &members = doc.as_kv_pairs();
+    for (auto &pair : patch.as_kv_pairs())
+    {
+        if (pair.second.type == JSONObjectType::NULL_VALUE)
+            members.erase(pair.first);
+        else
+            apply_merge_patch(members[pair.first], pair.second);
+    }
+}
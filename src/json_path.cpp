@@ -0,0 +1,944 @@
+#include "json_path.hpp"
+#include "json_lexer.hpp"
+#include "json_parser.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+/// Parses a query into the steps and filters of a JSONPath, by recursive descent
+class JSONPathCompiler
+{
+    JSONPath &path;
+    std::string_view input;
+    size_t pos;
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw json_error_at(message, input, pos);
+    }
+
+    char current() const { return pos < input.size() ? input[pos] : '\0'; }
+
+    void skip_whitespace()
+    {
+        while (pos < input.size() && std::strchr(" \t\n\r", input[pos]) && input[pos] != '\0')
+            pos++;
+    }
+
+    bool consume(std::string_view token)
+    {
+        skip_whitespace();
+        if (input.substr(pos, token.size()) != token)
+            return false;
+        pos += token.size();
+        return true;
+    }
+
+    void expect(std::string_view token)
+    {
+        if (!consume(token))
+            fail("Expected \"" + std::string(token) + "\"");
+    }
+
+    // A member name after a dot, which may contain letters, digits, "_", "$", "-" and any non
+    // ASCII character
+    std::string name()
+    {
+        size_t begin = pos;
+        while (pos < input.size())
+        {
+            auto ch = static_cast<unsigned char>(input[pos]);
+            if (!std::isalnum(ch) && ch != '_' && ch != '$' && ch != '-' && ch < 0x80)
+                break;
+            pos++;
+        }
+        if (pos == begin)
+            fail("Expected a member name");
+        return std::string(input.substr(begin, pos - begin));
+    }
+
+    // A string in single or double quotes, where a backslash escapes the next character
+    std::string quoted()
+    {
+        skip_whitespace();
+        char quote = current();
+        if (quote != '\'' && quote != '"')
+            fail("Expected a quoted string");
+        if (quote == '"')
+        {
+            // Double quoted strings follow the JSON rules
+            size_t begin = pos++;
+            while (pos < input.size() && input[pos] != '"')
+                pos += input[pos] == '\\' ? 2u : 1u;
+            if (pos >= input.size())
+                fail("Unterminated string");
+            pos++;
+            JSONLexer lexer(std::string(input.substr(begin, pos - begin)));
+            return lexer.next().as_string();
+        }
+        std::string result;
+        for (pos++; pos < input.size() && input[pos] != '\''; pos++)
+        {
+            if (input[pos] == '\\' && pos + 1 < input.size())
+                pos++;
+            result.push_back(input[pos]);
+        }
+        if (pos >= input.size())
+            fail("Unterminated string");
+        pos++;
+        return result;
+    }
+
+    std::optional<int64_t> integer()
+    {
+        skip_whitespace();
+        int64_t value = 0;
+        auto result = std::from_chars(input.data() + pos, input.data() + input.size(), value);
+        if (result.ptr == input.data() + pos)
+            return std::nullopt;
+        if (result.ec != std::errc())
+            fail("Integer out of range");
+        pos = static_cast<size_t>(result.ptr - input.data());
+        return value;
+    }
+
+    // The contents of brackets, after the opening bracket
+    void selector(JSONPathStep &step)
+    {
+        skip_whitespace();
+        if (consume("*"))
+        {
+            step.kind = JSONPathStep::Kind::WILDCARD;
+        }
+        else if (consume("?"))
+        {
+            step.kind = JSONPathStep::Kind::FILTER;
+            step.filter = condition();
+        }
+        else if (current() == '\'' || current() == '"')
+        {
+            step.kind = JSONPathStep::Kind::NAMES;
+            do
+                step.names.push_back(quoted());
+            while (consume(","));
+            // A union selects each member once, and the tree visits them in key order
+            std::sort(step.names.begin(), step.names.end());
+            step.names.erase(std::unique(step.names.begin(), step.names.end()), step.names.end());
+        }
+        else
+        {
+            auto first = integer();
+            skip_whitespace();
+            if (current() == ':')
+            {
+                step.kind = JSONPathStep::Kind::SLICE;
+                step.start = first;
+                expect(":");
+                step.end = integer();
+                if (consume(":"))
+                {
+                    auto increment = integer();
+                    step.step = increment ? *increment : 1;
+                    if (step.step <= 0)
+                        fail("The step of a slice must be positive");
+                }
+            }
+            else
+            {
+                if (!first)
+                    fail("Expected a selector");
+                step.kind = JSONPathStep::Kind::INDICES;
+                step.indices.push_back(*first);
+                while (consume(","))
+                {
+                    auto index = integer();
+                    if (!index)
+                        fail("Expected an index");
+                    step.indices.push_back(*index);
+                }
+            }
+        }
+        expect("]");
+    }
+
+    size_t add(JSONPathFilter &&filter)
+    {
+        path.filters.push_back(std::move(filter));
+        return path.filters.size() - 1;
+    }
+
+    size_t combine(JSONPathFilter::Kind kind, size_t first, size_t second)
+    {
+        JSONPathFilter filter;
+        filter.kind = kind;
+        filter.first = first;
+        filter.second = second;
+        return add(std::move(filter));
+    }
+
+    // or = and ("||" and)*
+    size_t condition()
+    {
+        size_t result = conjunction();
+        while (consume("||"))
+            result = combine(JSONPathFilter::Kind::OR, result, conjunction());
+        return result;
+    }
+
+    // and = unary ("&&" unary)*
+    size_t conjunction()
+    {
+        size_t result = unary();
+        while (consume("&&"))
+            result = combine(JSONPathFilter::Kind::AND, result, unary());
+        return result;
+    }
+
+    // unary = "!" unary | "(" or ")" | operand [comparison operand]
+    size_t unary()
+    {
+        if (consume("!"))
+            return combine(JSONPathFilter::Kind::NOT, unary(), 0);
+        if (consume("("))
+        {
+            size_t result = condition();
+            expect(")");
+            return result;
+        }
+        JSONPathFilter filter;
+        filter.left = operand();
+        static const std::pair<const char *, JSONPathFilter::Compare> comparisons[] = {
+            {"==", JSONPathFilter::Compare::EQ}, {"!=", JSONPathFilter::Compare::NE},
+            {"<=", JSONPathFilter::Compare::LE}, {">=", JSONPathFilter::Compare::GE},
+            {"<", JSONPathFilter::Compare::LT},  {">", JSONPathFilter::Compare::GT},
+        };
+        for (auto &comparison : comparisons)
+        {
+            if (consume(comparison.first))
+            {
+                filter.kind = JSONPathFilter::Kind::COMPARE;
+                filter.compare = comparison.second;
+                filter.right = operand();
+                return add(std::move(filter));
+            }
+        }
+        if (!filter.left.is_path)
+            fail("Expected a comparison");
+        filter.kind = JSONPathFilter::Kind::EXISTS;
+        return add(std::move(filter));
+    }
+
+    JSONPathOperand operand()
+    {
+        JSONPathOperand result;
+        skip_whitespace();
+        if (consume("@"))
+        {
+            result.is_path = true;
+            while (true)
+            {
+                if (current() == '.')
+                {
+                    pos++;
+                    result.path.push_back(name());
+                }
+                else if (current() == '[')
+                {
+                    pos++;
+                    skip_whitespace();
+                    if (current() == '\'' || current() == '"')
+                    {
+                        result.path.push_back(quoted());
+                    }
+                    else
+                    {
+                        auto index = integer();
+                        if (!index)
+                            fail("Expected an index or a quoted name");
+                        result.path.push_back(*index);
+                    }
+                    expect("]");
+                }
+                else
+                {
+                    return result;
+                }
+            }
+        }
+        if (current() == '\'' || current() == '"')
+        {
+            result.literal = JSONObject(quoted());
+            return result;
+        }
+        // Numbers and the literals true, false and null are read as JSON
+        size_t begin = pos;
+        while (pos < input.size() &&
+               (std::isalnum(static_cast<unsigned char>(input[pos])) ||
+                std::strchr("+-.", input[pos])) &&
+               input[pos] != '\0')
+            pos++;
+        if (pos == begin)
+            fail("Expected a value");
+        try
+        {
+            JSONParser parser(std::string(input.substr(begin, pos - begin)));
+            result.literal = std::move(parser.get_tree());
+        }
+        catch (const json_parse_error &)
+        {
+            pos = begin;
+            fail("Invalid literal");
+        }
+        if (result.literal.type == JSONObjectType::OBJECT ||
+            result.literal.type == JSONObjectType::ARRAY)
+            fail("Expected a value");
+        return result;
+    }
+
+  public:
+    JSONPathCompiler(JSONPath &path) : path(path), input(path.source), pos(0) {}
+
+    void compile()
+    {
+        skip_whitespace();
+        expect("$");
+        while (pos < input.size())
+        {
+            JSONPathStep step;
+            step.kind = JSONPathStep::Kind::NAMES;
+            if (input.substr(pos, 2) == "..")
+            {
+                pos += 2;
+                step.descendant = true;
+                if (current() == '[')
+                {
+                    pos++;
+                    selector(step);
+                }
+                else if (current() == '*')
+                {
+                    pos++;
+                    step.kind = JSONPathStep::Kind::WILDCARD;
+                }
+                else
+                {
+                    step.names.push_back(name());
+                }
+            }
+            else if (current() == '.')
+            {
+                pos++;
+                if (current() == '*')
+                {
+                    pos++;
+                    step.kind = JSONPathStep::Kind::WILDCARD;
+                }
+                else
+                {
+                    step.names.push_back(name());
+                }
+            }
+            else if (current() == '[')
+            {
+                pos++;
+                selector(step);
+            }
+            else
+            {
+                skip_whitespace();
+                if (pos == input.size())
+                    break;
+                fail("Expected \".\" or \"[\"");
+            }
+            path.steps.push_back(std::move(step));
+        }
+    }
+};
+
+/// Normalizes an index which may count from the end, returns false if it is out of range
+static bool normalize(int64_t index, size_t size, size_t &out)
+{
+    if (index < 0)
+        index += static_cast<int64_t>(size);
+    if (index < 0 || static_cast<uint64_t>(index) >= size)
+        return false;
+    out = static_cast<size_t>(index);
+    return true;
+}
+
+/// Start and end of a slice of an array with size elements
+static std::pair<size_t, size_t> slice_bounds(const JSONPathStep &step, size_t size)
+{
+    auto bound = [size](std::optional<int64_t> value, size_t otherwise)
+    {
+        if (!value)
+            return otherwise;
+        int64_t index = *value < 0 ? *value + static_cast<int64_t>(size) : *value;
+        return static_cast<size_t>(std::clamp<int64_t>(index, 0, static_cast<int64_t>(size)));
+    };
+    return {bound(step.start, 0), bound(step.end, size)};
+}
+
+static bool in_slice(const JSONPathStep &step, std::pair<size_t, size_t> bounds, size_t index)
+{
+    return index >= bounds.first && index < bounds.second &&
+           (index - bounds.first) % static_cast<size_t>(step.step) == 0;
+}
+
+static bool is_number(const JSONObject *ob)
+{
+    return ob->type == JSONObjectType::NUMBER_INT || ob->type == JSONObjectType::NUMBER_REAL;
+}
+
+/// Equality of filter operands, integers and reals are compared by value
+static bool equal(const JSONObject *a, const JSONObject *b)
+{
+    if (!a || !b)
+        return a == b;
+    if (is_number(a) && is_number(b))
+    {
+        auto x = a->get<long double>();
+        auto y = b->get<long double>();
+        return !(x < y) && !(x > y);
+    }
+    return *a == *b;
+}
+
+static bool compare(const JSONObject *a, const JSONObject *b, JSONPathFilter::Compare op)
+{
+    using Compare = JSONPathFilter::Compare;
+    if (op == Compare::EQ)
+        return equal(a, b);
+    if (op == Compare::NE)
+        return !equal(a, b);
+    if (!a || !b)
+        return false;
+    int order = 0;
+    if (is_number(a) && is_number(b))
+    {
+        auto x = a->get<long double>();
+        auto y = b->get<long double>();
+        order = x < y ? -1 : x > y ? 1 : 0;
+    }
+    else if (a->type == JSONObjectType::STRING && b->type == JSONObjectType::STRING)
+    {
+        order = a->as_string().compare(b->as_string());
+    }
+    else
+    {
+        return false;
+    }
+    switch (op)
+    {
+    case Compare::LT:
+        return order < 0;
+    case Compare::LE:
+        return order <= 0;
+    case Compare::GT:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+/// Runs a compiled query, over a tree or over the text of a document
+class JSONPathEvaluator
+{
+    const JSONPath &path;
+    std::string_view text;
+    JSONParser parser;
+
+    // Returns the value of an operand in a tree, an element of a packed array is built in storage
+    const JSONObject *resolve(const JSONPathOperand &operand, const JSONObject &current,
+                              JSONObject &storage) const
+    {
+        if (!operand.is_path)
+            return &operand.literal;
+        const JSONObject *ob = &current;
+        for (auto &key : operand.path)
+        {
+            if (auto name = std::get_if<std::string>(&key))
+            {
+                ob = ob->find(*name);
+            }
+            else
+            {
+                size_t index = 0;
+                if (ob->type != JSONObjectType::ARRAY ||
+                    !normalize(std::get<int64_t>(key), ob->size(), index))
+                    return nullptr;
+                if (ob->packed_type() != JSONObjectType::EMPTY)
+                {
+                    storage = ob->element(index);
+                    ob = &storage;
+                }
+                else
+                {
+                    ob = &ob->as_vector()[index];
+                }
+            }
+            if (!ob)
+                return nullptr;
+        }
+        return ob;
+    }
+
+    // Evaluates a filter, where resolve(operand, storage) returns the value of an operand or
+    // nullptr if it does not exist, using storage for a value which it had to parse
+    template <typename Resolve> bool evaluate(size_t index, Resolve &resolve) const
+    {
+        auto &filter = path.filters[index];
+        JSONObject left;
+        JSONObject right;
+        switch (filter.kind)
+        {
+        case JSONPathFilter::Kind::OR:
+            return evaluate(filter.first, resolve) || evaluate(filter.second, resolve);
+        case JSONPathFilter::Kind::AND:
+            return evaluate(filter.first, resolve) && evaluate(filter.second, resolve);
+        case JSONPathFilter::Kind::NOT:
+            return !evaluate(filter.first, resolve);
+        case JSONPathFilter::Kind::EXISTS:
+            return resolve(filter.left, left) != nullptr;
+        default:
+            return compare(resolve(filter.left, left), resolve(filter.right, right),
+                           filter.compare);
+        }
+    }
+
+    bool test(size_t index, const JSONObject &current) const
+    {
+        auto resolve = [&](const JSONPathOperand &operand, JSONObject &storage)
+        { return this->resolve(operand, current, storage); };
+        return evaluate(index, resolve);
+    }
+
+    // Tests a filter on the value at offset, parsing only the values which it compares
+    bool test(size_t index, size_t offset)
+    {
+        auto resolve = [&](const JSONPathOperand &operand,
+                           JSONObject &storage) -> const JSONObject *
+        {
+            if (!operand.is_path)
+                return &operand.literal;
+            size_t found = locate(operand.path, offset);
+            if (found == std::string_view::npos)
+                return nullptr;
+            storage = materialize(found);
+            return &storage;
+        };
+        return evaluate(index, resolve);
+    }
+
+    [[noreturn]] void fail(const std::string &message, size_t offset) const
+    {
+        throw json_error_at(message, text, offset);
+    }
+
+    char at(size_t offset) const { return offset < text.size() ? text[offset] : '\0'; }
+
+    size_t skip_whitespace(size_t offset) const
+    {
+        while (offset < text.size() && (text[offset] == ' ' || text[offset] == '\n' ||
+                                        text[offset] == '\t' || text[offset] == '\r'))
+            offset++;
+        return offset;
+    }
+
+    // Returns the offset after the closing quote of the string which starts at offset
+    size_t skip_string(size_t offset) const
+    {
+        offset++;
+        while (true)
+        {
+            offset = text.find_first_of("\"\\", offset);
+            if (offset == std::string_view::npos)
+                fail("Unterminated string", text.size());
+            if (text[offset] == '"')
+                return offset + 1;
+            offset += 2;
+        }
+    }
+
+    // Returns the offset after the value which starts at offset, by matching brackets
+    size_t skip_value(size_t offset) const
+    {
+        char ch = at(offset);
+        if (ch == '"')
+            return skip_string(offset);
+        if (ch == '{' || ch == '[')
+        {
+            size_t depth = 0;
+            while (offset < text.size())
+            {
+                ch = text[offset];
+                if (ch == '"')
+                {
+                    offset = skip_string(offset);
+                    continue;
+                }
+                if (ch == '{' || ch == '[')
+                    depth++;
+                else if ((ch == '}' || ch == ']') && --depth == 0)
+                    return offset + 1;
+                offset++;
+            }
+            fail("Unexpected end of input", offset);
+        }
+        size_t begin = offset;
+        while (offset < text.size() && !std::strchr(",:}] \t\n\r", text[offset]) &&
+               text[offset] != '\0')
+            offset++;
+        if (offset == begin)
+            fail("Expected value", offset);
+        return offset;
+    }
+
+    // Calls f(key, offset of the value) for every member of the object which starts at offset,
+    // where key is the quoted key as it appears in the text, until f returns false
+    template <typename F> void members(size_t offset, F f) const
+    {
+        offset = skip_whitespace(offset + 1);
+        if (at(offset) == '}')
+            return;
+        while (true)
+        {
+            if (at(offset) != '"')
+                fail("Expected string key", offset);
+            size_t end = skip_string(offset);
+            auto key = text.substr(offset, end - offset);
+            offset = skip_whitespace(end);
+            if (at(offset) != ':')
+                fail("Expected \":\"", offset);
+            offset = skip_whitespace(offset + 1);
+            if (!f(key, offset))
+                return;
+            offset = skip_whitespace(skip_value(offset));
+            if (at(offset) == '}')
+                return;
+            if (at(offset) != ',')
+                fail("Expected \",\" or \"}\"", offset);
+            offset = skip_whitespace(offset + 1);
+        }
+    }
+
+    // Calls f(index, offset of the element) for every element of the array which starts at
+    // offset, until f returns false
+    template <typename F> void elements(size_t offset, F f) const
+    {
+        offset = skip_whitespace(offset + 1);
+        if (at(offset) == ']')
+            return;
+        for (size_t index = 0;; index++)
+        {
+            if (!f(index, offset))
+                return;
+            offset = skip_whitespace(skip_value(offset));
+            if (at(offset) == ']')
+                return;
+            if (at(offset) != ',')
+                fail("Expected \",\" or \"]\"", offset);
+            offset = skip_whitespace(offset + 1);
+        }
+    }
+
+    // Compares a quoted key of the text with a name, decoding the key only if it has escapes
+    static bool key_matches(std::string_view key, std::string_view name)
+    {
+        auto raw = key.substr(1, key.size() - 2);
+        if (raw.find('\\') == std::string_view::npos)
+            return raw == name;
+        JSONLexer lexer{std::string(key)};
+        return lexer.next().as_string() == name;
+    }
+
+    static bool key_matches(std::string_view key, const std::vector<std::string> &names)
+    {
+        for (auto &name : names)
+        {
+            if (key_matches(key, name))
+                return true;
+        }
+        return false;
+    }
+
+    // Returns the offset of the value at a relative path below the value at offset, or npos if
+    // there is none
+    size_t locate(const std::vector<JSONPathKey> &keys, size_t offset) const
+    {
+        for (auto &key : keys)
+        {
+            offset = skip_whitespace(offset);
+            size_t found = std::string_view::npos;
+            if (auto name = std::get_if<std::string>(&key))
+            {
+                if (at(offset) != '{')
+                    return std::string_view::npos;
+                members(offset,
+                        [&](std::string_view member, size_t value)
+                        {
+                            if (key_matches(member, *name))
+                                found = value;
+                            return found == std::string_view::npos;
+                        });
+            }
+            else
+            {
+                if (at(offset) != '[')
+                    return std::string_view::npos;
+                int64_t wanted = std::get<int64_t>(key);
+                if (wanted < 0)
+                {
+                    size_t size = 0;
+                    elements(offset,
+                             [&](size_t, size_t)
+                             {
+                                 size++;
+                                 return true;
+                             });
+                    wanted += static_cast<int64_t>(size);
+                }
+                elements(offset,
+                         [&](size_t index, size_t value)
+                         {
+                             if (wanted >= 0 && index == static_cast<uint64_t>(wanted))
+                                 found = value;
+                             return found == std::string_view::npos;
+                         });
+            }
+            if (found == std::string_view::npos)
+                return found;
+            offset = found;
+        }
+        return offset;
+    }
+
+    JSONObject materialize(size_t offset)
+    {
+        size_t end = skip_value(offset);
+        try
+        {
+            parser.parse(std::string(text.substr(offset, end - offset)));
+        }
+        catch (const json_parse_error &e)
+        {
+            size_t error = e.offset() == std::string::npos ? 0 : e.offset();
+            fail("Invalid value", offset + error);
+        }
+        return std::move(parser.get_tree());
+    }
+
+  public:
+    JSONPathEvaluator(const JSONPath &path, std::string_view text = {}) : path(path), text(text) {}
+
+    void select(const JSONObject &ob, size_t step, std::vector<const JSONObject *> &out) const
+    {
+        if (step == path.steps.size())
+        {
+            out.push_back(&ob);
+            return;
+        }
+        auto &s = path.steps[step];
+        if (ob.type == JSONObjectType::OBJECT)
+        {
+            if (s.kind == JSONPathStep::Kind::NAMES)
+            {
+                for (auto &name : s.names)
+                {
+                    if (auto value = ob.find(name))
+                        select(*value, step + 1, out);
+                }
+            }
+            else if (s.kind == JSONPathStep::Kind::WILDCARD || s.kind == JSONPathStep::Kind::FILTER)
+            {
+                for (auto &pair : ob.as_kv_pairs())
+                {
+                    if (s.kind == JSONPathStep::Kind::WILDCARD || test(s.filter, pair.second))
+                        select(pair.second, step + 1, out);
+                }
+            }
+        }
+        else if (ob.type == JSONObjectType::ARRAY)
+        {
+            // The elements of a packed array are scalars, so nothing below them can be selected.
+            // They are tested one at a time, and as the results point into the tree, the elements
+            // are only built when one of them is the result
+            bool packed = ob.packed_type() != JSONObjectType::EMPTY;
+            bool last = step + 1 == path.steps.size();
+            auto select_index = [&](size_t i)
+            {
+                if (!packed || last)
+                    select(ob.as_vector()[i], step + 1, out);
+            };
+            size_t size = ob.size();
+            size_t index = 0;
+            switch (s.kind)
+            {
+            case JSONPathStep::Kind::INDICES:
+            {
+                // Each element is selected once and in order, as the text selects them
+                std::vector<size_t> selected;
+                for (auto i : s.indices)
+                {
+                    if (normalize(i, size, index))
+                        selected.push_back(index);
+                }
+                std::sort(selected.begin(), selected.end());
+                selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+                for (auto i : selected)
+                    select_index(i);
+                break;
+            }
+            case JSONPathStep::Kind::SLICE:
+            {
+                auto bounds = slice_bounds(s, size);
+                for (index = bounds.first; index < bounds.second;
+                     index += static_cast<size_t>(s.step))
+                    select_index(index);
+                break;
+            }
+            case JSONPathStep::Kind::WILDCARD:
+            case JSONPathStep::Kind::FILTER:
+                for (index = 0; index < size; index++)
+                {
+                    if (s.kind == JSONPathStep::Kind::FILTER &&
+                        !(packed ? test(s.filter, ob.element(index))
+                                 : test(s.filter, ob.as_vector()[index])))
+                        continue;
+                    select_index(index);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if (!s.descendant)
+            return;
+        if (ob.type == JSONObjectType::OBJECT)
+        {
+            for (auto &pair : ob.as_kv_pairs())
+                select(pair.second, step, out);
+        }
+        else if (ob.type == JSONObjectType::ARRAY && ob.packed_type() == JSONObjectType::EMPTY)
+        {
+            for (auto &element : ob.as_vector())
+                select(element, step, out);
+        }
+    }
+
+    void select(size_t offset, size_t step, std::vector<JSONObject> &out)
+    {
+        offset = skip_whitespace(offset);
+        if (step == path.steps.size())
+        {
+            out.push_back(materialize(offset));
+            return;
+        }
+        auto &s = path.steps[step];
+        char ch = at(offset);
+        if (ch == '{')
+        {
+            members(offset,
+                    [&](std::string_view key, size_t value)
+                    {
+                        if ((s.kind == JSONPathStep::Kind::NAMES && key_matches(key, s.names)) ||
+                            s.kind == JSONPathStep::Kind::WILDCARD ||
+                            (s.kind == JSONPathStep::Kind::FILTER && test(s.filter, value)))
+                            select(value, step + 1, out);
+                        return true;
+                    });
+        }
+        else if (ch == '[')
+        {
+            // Negative indices need the size of the array, which takes a pass to count
+            size_t size = std::numeric_limits<int64_t>::max();
+            bool negative = false;
+            for (auto i : s.indices)
+                negative = negative || i < 0;
+            negative = negative || (s.kind == JSONPathStep::Kind::SLICE &&
+                                    ((s.start && *s.start < 0) || (s.end && *s.end < 0)));
+            if (negative)
+            {
+                size = 0;
+                elements(offset,
+                         [&](size_t, size_t)
+                         {
+                             size++;
+                             return true;
+                         });
+            }
+            auto bounds = slice_bounds(s, size);
+            elements(offset,
+                     [&](size_t index, size_t value)
+                     {
+                         bool selected = s.kind == JSONPathStep::Kind::WILDCARD;
+                         if (s.kind == JSONPathStep::Kind::INDICES)
+                         {
+                             for (auto i : s.indices)
+                             {
+                                 size_t normalized = 0;
+                                 if (normalize(i, size, normalized) &&
+                                     normalized == index)
+                                     selected = true;
+                             }
+                         }
+                         else if (s.kind == JSONPathStep::Kind::SLICE)
+                         {
+                             selected = in_slice(s, bounds, index);
+                         }
+                         else if (s.kind == JSONPathStep::Kind::FILTER)
+                         {
+                             selected = test(s.filter, value);
+                         }
+                         if (selected)
+                             select(value, step + 1, out);
+                         return true;
+                     });
+        }
+        if (!s.descendant)
+            return;
+        if (ch == '{')
+        {
+            members(offset,
+                    [&](std::string_view, size_t value)
+                    {
+                        select(value, step, out);
+                        return true;
+                    });
+        }
+        else if (ch == '[')
+        {
+            elements(offset,
+                     [&](size_t, size_t value)
+                     {
+                         select(value, step, out);
+                         return true;
+                     });
+        }
+    }
+};
+
+JSONPath::JSONPath(std::string_view expression) : source(expression)
+{
+    JSONPathCompiler compiler(*this);
+    compiler.compile();
+}
+
+std::vector<const JSONObject *> JSONPath::select(const JSONObject &root) const
+{
+    std::vector<const JSONObject *> out;
+    JSONPathEvaluator evaluator(*this);
+    evaluator.select(root, 0, out);
+    return out;
+}
+
+std::vector<JSONObject> JSONPath::select_text(std::string_view document) const
+{
+    std::vector<JSONObject> out;
+    JSONPathEvaluator evaluator(*this, document);
+    evaluator.select(size_t(0), 0, out);
+    return out;
+}
+
+const std::string &JSONPath::expression() const { return source; }
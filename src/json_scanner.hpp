@@ -0,0 +1,541 @@
+#pragma once
+#include "json_limits.hpp"
+#include "json_utf8.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_SCANNER_SSE2
+#endif
+
+/*
+ * Checks JSON text without building tokens or a tree, and reports the structure of the text to a
+ * handler as it goes. It accepts exactly what JSONParser::parse() accepts, including the
+ * extensions listed in the README, and applies the same ParseLimits except max_allocated_bytes.
+ * UTF-8 is checked as with JSONParser::set_validate_utf8(true) when it is asked for.
+ * The only memory used is one bit per level of nesting, plus a count per level when
+ * max_container_size is set.
+ *
+ * The handler receives the raw text of every token, so that it can copy or reformat the input:
+ *   begin_container(char open)              at { and [
+ *   end_container(char close, bool empty)   at } and ]
+ *   key(const char *text, size_t length)    a key, including its quotes
+ *   scalar(const char *text, size_t length) a string (with quotes), number or literal
+ *   separator(char c)                       at , and :
+ */
+
+// Handler which ignores everything, used to only validate the text
+struct JSONNullHandler
+{
+    void begin_container(char) {}
+    void end_container(char, bool) {}
+    void key(const char *, size_t) {}
+    void scalar(const char *, size_t) {}
+    void separator(char) {}
+};
+
+template <typename Handler> class JSONScanner
+{
+    const char *data;
+    size_t size;
+    size_t idx;
+    const ParseLimits &limits;
+    Handler &handler;
+
+    // Kind of every open container, a set bit is an object. The first 256 levels are stored
+    // inline, so that most documents are checked without allocating
+    uint64_t inline_kinds[4];
+    std::vector<uint64_t> more_kinds;
+    size_t depth;
+
+    // Members or elements of every open container, only kept if the size is limited
+    std::vector<size_t> counts;
+
+    size_t nodes;
+
+    const char *error_message;
+    size_t error_offset;
+
+    bool check_utf8;
+
+    bool fail(const char *message, size_t offset)
+    {
+        error_message = message;
+        error_offset = offset;
+        return false;
+    }
+
+    static bool is_whitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    // Characters which may follow a number or a literal, see JSONLexer::is_stop()
+    static bool is_stop(char c) { return is_whitespace(c) || c == '}' || c == ']' || c == ','; }
+
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    void skip_whitespace()
+    {
+        while (idx < size && is_whitespace(data[idx]))
+            idx++;
+    }
+
+    bool is_object() const
+    {
+        size_t level = depth - 1;
+        uint64_t word = level < 256 ? inline_kinds[level / 64] : more_kinds[level / 64 - 4];
+        return (word >> (level % 64)) & 1;
+    }
+
+    bool open(char c)
+    {
+        if (++depth > limits.max_depth)
+            return fail("Exceeded max_depth", idx);
+        size_t level = depth - 1;
+        uint64_t bit = uint64_t(c == '{') << (level % 64);
+        if (level < 256)
+        {
+            uint64_t &word = inline_kinds[level / 64];
+            word = (word & ~(uint64_t(1) << (level % 64))) | bit;
+        }
+        else
+        {
+            if (level / 64 - 4 >= more_kinds.size())
+                more_kinds.push_back(0);
+            uint64_t &word = more_kinds[level / 64 - 4];
+            word = (word & ~(uint64_t(1) << (level % 64))) | bit;
+        }
+        if (limits.max_container_size != ParseLimits::unlimited)
+            counts.push_back(0);
+        handler.begin_container(c);
+        idx++;
+        return true;
+    }
+
+    void close(bool empty)
+    {
+        handler.end_container(data[idx], empty);
+        idx++;
+        depth--;
+        if (limits.max_container_size != ParseLimits::unlimited)
+            counts.pop_back();
+    }
+
+    // Counts a member or element of the innermost container, before it is scanned
+    bool count_member()
+    {
+        if (limits.max_container_size == ParseLimits::unlimited)
+            return true;
+        if (++counts.back() > limits.max_container_size)
+            return fail("Exceeded max_container_size", idx);
+        return true;
+    }
+
+    // Returns the offset of the next '"' or '\\' at or after i, or size
+    size_t find_quote_or_escape(size_t i) const
+    {
+#if defined(JSON_SCANNER_SSE2)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i escape = _mm_set1_epi8('\\');
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            int mask = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, escape)));
+            // The loop below finds the position within the block
+            if (mask)
+                break;
+        }
+#else
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t low_bits = 0x7F7F7F7F7F7F7F7FULL;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            uint64_t q = word ^ (ones * '"');
+            uint64_t e = word ^ (ones * '\\');
+            // The high bit of a byte is set if that byte of q or e is zero, see count_newlines()
+            uint64_t found = ~(((q & low_bits) + low_bits) | q | low_bits) |
+                             ~(((e & low_bits) + low_bits) | e | low_bits);
+            if (found)
+                break;
+        }
+#endif
+        while (i < size && data[i] != '"' && data[i] != '\\')
+            i++;
+        return i;
+    }
+
+    static int hex_digit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // Reads the four hex digits after the u at idx, returns -1 if they are missing or invalid
+    long read_hex4(size_t u) const
+    {
+        if (size - u < 5)
+            return -1;
+        long value = 0;
+        for (size_t k = 1; k <= 4; k++)
+        {
+            int digit = hex_digit(data[u + k]);
+            if (digit < 0)
+                return -1;
+            value = value * 16 + digit;
+        }
+        return value;
+    }
+
+    // Scans the string starting at the quote at idx, computing its length after decoding escapes
+    bool scan_string(bool is_key)
+    {
+        const size_t start = idx;
+        size_t length = 0;
+        idx++;
+        while (true)
+        {
+            size_t end = find_quote_or_escape(idx);
+            length += end - idx;
+            idx = end;
+            if (idx == size)
+                return fail("Unterminated string literal", start);
+            if (data[idx] == '"')
+                break;
+
+            // An escape sequence
+            if (idx + 1 == size)
+                return fail("Unterminated string literal", start);
+            char c = data[idx + 1];
+            if (c == 'u')
+            {
+                long code_point = read_hex4(idx + 1);
+                if (code_point < 0)
+                    return fail("Invalid unicode escape", idx);
+                if (code_point >= 0xDC00 && code_point <= 0xDFFF)
+                    return fail("Unpaired unicode surrogate", idx);
+                if (code_point >= 0xD800 && code_point <= 0xDBFF)
+                {
+                    long low = -1;
+                    if (size - idx > 7 && data[idx + 6] == '\\' && data[idx + 7] == 'u')
+                        low = read_hex4(idx + 7);
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        return fail("Unpaired unicode surrogate", idx);
+                    length += 4;
+                    idx += 12;
+                }
+                else
+                {
+                    length += code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : 3;
+                    idx += 6;
+                }
+            }
+            else if (c == '"' || c == '\\' || c == '/' || c == 'b' || c == 'f' || c == 'n' ||
+                     c == 'r' || c == 't')
+            {
+                length++;
+                idx += 2;
+            }
+            else
+            {
+                return fail("Invalid escape character", idx);
+            }
+        }
+        idx++;
+        if (length > limits.max_string_length)
+            return fail("Exceeded max_string_length", start);
+        if (is_key)
+            handler.key(data + start, idx - start);
+        else
+            handler.scalar(data + start, idx - start);
+        return true;
+    }
+
+    // Checks that an integer fits in int64_t, as std::stoll requires
+    static bool integer_in_range(const char *text, size_t length)
+    {
+        bool negative = *text == '-';
+        if (negative)
+        {
+            text++;
+            length--;
+        }
+        while (length > 1 && *text == '0')
+        {
+            text++;
+            length--;
+        }
+        const char *largest = negative ? "9223372036854775808" : "9223372036854775807";
+        if (length != 19)
+            return length < 19;
+        return std::memcmp(text, largest, 19) <= 0;
+    }
+
+    // Checks that std::stold does not report a real as out of range. The decimal exponent of the
+    // first significant digit is estimated from the text, and only values within a few orders of
+    // magnitude of the limits of long double are converted to be sure
+    static bool real_in_range(const char *text, size_t length)
+    {
+        size_t i = *text == '-' ? 1 : 0;
+        int64_t exponent = -1;
+        bool significant = false;
+        bool point = false;
+        // The mantissa, as far as strtold reads it
+        for (; i < length; i++)
+        {
+            char c = text[i];
+            if (c == '.' && !point)
+            {
+                point = true;
+                continue;
+            }
+            if (!is_digit(c))
+                break;
+            if (!significant && c != '0')
+                significant = true;
+            if (!point && significant)
+                exponent++;
+            else if (point && !significant)
+                exponent--;
+        }
+        if (!significant)
+            return true;
+
+        // The exponent is only read if at least one digit follows e and the optional sign
+        if (i < length && (text[i] == 'e' || text[i] == 'E'))
+        {
+            size_t j = i + 1;
+            bool negative = false;
+            if (j < length && (text[j] == '+' || text[j] == '-'))
+                negative = text[j++] == '-';
+            int64_t value = 0;
+            for (; j < length && is_digit(text[j]); j++)
+                value = std::min<int64_t>(value * 10 + (text[j] - '0'), 1000000000);
+            exponent += negative ? -value : value;
+        }
+
+        const int64_t margin = 2;
+        if (exponent > std::numeric_limits<long double>::min_exponent10 + margin &&
+            exponent < std::numeric_limits<long double>::max_exponent10 - margin)
+            return true;
+
+        std::string copy(text, length);
+        errno = 0;
+        std::strtold(copy.c_str(), nullptr);
+        return errno != ERANGE;
+    }
+
+    // Scans a number with the same rules as JSONLexer::lex_number()
+    bool scan_number()
+    {
+        const size_t start = idx;
+        if (data[idx] == '-')
+        {
+            idx++;
+            if (idx == size || !is_digit(data[idx]))
+                return fail("Invalid literal \"-\"", start);
+        }
+        bool point = false;
+        bool exponent = false;
+        char last = data[idx];
+        while (idx < size)
+        {
+            char c = data[idx];
+            if (is_digit(c))
+            {
+            }
+            else if ((last == 'e' || last == 'E') && (c == '-' || c == '+'))
+            {
+            }
+            else if (!point && c == '.')
+            {
+                point = true;
+            }
+            else if (!exponent && (c == 'e' || c == 'E'))
+            {
+                exponent = true;
+            }
+            else if (is_stop(c))
+            {
+                break;
+            }
+            else
+            {
+                return fail("Invalid literal for number", idx);
+            }
+            last = c;
+            idx++;
+        }
+        const size_t length = idx - start;
+        if (length > limits.max_number_length)
+            return fail("Exceeded max_number_length", start);
+        if (point || exponent)
+        {
+            if (last == 'e' || last == 'E' || last == '+' || last == '-')
+                return fail("Incomplete number", start);
+            if (!real_in_range(data + start, length))
+                return fail("Number out of range", start);
+        }
+        else if (!integer_in_range(data + start, length))
+        {
+            return fail("Number out of range", start);
+        }
+        handler.scalar(data + start, length);
+        return true;
+    }
+
+    // A literal extends to the next stop character, see JSONLexer::lex_literal()
+    bool scan_literal()
+    {
+        const size_t start = idx;
+        while (idx < size && !is_stop(data[idx]))
+            idx++;
+        const size_t length = idx - start;
+        if ((length == 4 && (std::memcmp(data + start, "null", 4) == 0 ||
+                             std::memcmp(data + start, "true", 4) == 0)) ||
+            (length == 5 && std::memcmp(data + start, "false", 5) == 0))
+        {
+            handler.scalar(data + start, length);
+            return true;
+        }
+        return fail("Invalid literal", start);
+    }
+
+    // Scans a key and the colon after it, idx is at the first character of the key
+    bool scan_key()
+    {
+        if (idx == size)
+            return fail("Unexpected end of input", idx);
+        if (data[idx] != '"')
+            return fail("Expected string key", idx);
+        if (!scan_string(true))
+            return false;
+        skip_whitespace();
+        if (idx == size)
+            return fail("Unexpected end of input", idx);
+        if (data[idx] != ':')
+            return fail("Invalid key-value pair, expected \":\"", idx);
+        handler.separator(':');
+        idx++;
+        return true;
+    }
+
+    // Scans the value at idx. An object or array is only opened, and its first key is scanned.
+    // Sets closed if the value is complete, i.e. it is a scalar or an empty container
+    bool scan_value(bool &closed)
+    {
+        skip_whitespace();
+        if (idx == size)
+            return fail("Unexpected end of input", idx);
+        if (++nodes > limits.max_nodes)
+            return fail("Exceeded max_nodes", idx);
+
+        closed = true;
+        char c = data[idx];
+        if (c == '{' || c == '[')
+        {
+            if (!open(c))
+                return false;
+            skip_whitespace();
+            if (idx < size && data[idx] == (c == '{' ? '}' : ']'))
+            {
+                close(true);
+                return true;
+            }
+            closed = false;
+            if (!count_member())
+                return false;
+            return c == '[' || scan_key();
+        }
+        if (c == '"')
+            return scan_string(false);
+        if (c == '-' || is_digit(c))
+            return scan_number();
+        if (c == '}' || c == ']' || c == ',' || c == ':')
+            return fail("Expected value", idx);
+        return scan_literal();
+    }
+
+  public:
+    // If check_utf8 is set, the text must also be well formed UTF-8
+    JSONScanner(const char *data, size_t size, const ParseLimits &limits, Handler &handler,
+                bool check_utf8)
+        : data(data), size(size), idx(0), limits(limits), handler(handler), inline_kinds(),
+          depth(0), nodes(0), error_message(nullptr), error_offset(0), check_utf8(check_utf8)
+    {
+    }
+
+    // Returns true if the whole text is a single valid JSON value
+    bool scan()
+    {
+        if (size > limits.max_bytes)
+            return fail("Exceeded max_bytes", limits.max_bytes);
+        if (check_utf8)
+        {
+            size_t invalid = json_validate_utf8(data, size);
+            if (invalid != size)
+                return fail("Invalid UTF-8", invalid);
+        }
+
+        while (true)
+        {
+            bool closed;
+            if (!scan_value(closed))
+                return false;
+            if (!closed)
+                continue;
+
+            // After a value, close containers until one has more members or elements
+            while (true)
+            {
+                skip_whitespace();
+                if (depth == 0)
+                {
+                    if (idx != size)
+                        return fail("Extra tokens after parsing JSON", idx);
+                    return true;
+                }
+                if (idx == size)
+                    return fail("Unexpected end of input", idx);
+
+                char c = data[idx];
+                bool object = is_object();
+                if (c == ',')
+                {
+                    handler.separator(',');
+                    idx++;
+                    if (!count_member())
+                        return false;
+                    if (object)
+                    {
+                        skip_whitespace();
+                        if (!scan_key())
+                            return false;
+                    }
+                    break;
+                }
+                if (c == (object ? '}' : ']'))
+                {
+                    close(false);
+                    continue;
+                }
+                return fail(object ? "Expected \"}\"" : "Expected \"]\"", idx);
+            }
+        }
+    }
+
+    const char *message() const { return error_message; }
+
+    size_t offset() const { return error_offset; }
+};
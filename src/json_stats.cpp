@@ -0,0 +1,25 @@
+#include "json_stats.hpp"
+
+ParseStats::ParseStats() { reset(); }
+
+/// Clears all counters, this is done by the parser before each document
+void ParseStats::reset()
+{
+#ifdef JSONPARSER_STATS
+    enabled = true;
+#else
+    enabled = false;
+#endif
+    tokens.fill(0);
+    string_bytes = number_bytes = literal_bytes = whitespace_bytes = 0;
+    escapes = 0;
+    max_depth = 0;
+    objects = arrays = object_members = array_elements = max_object_size = max_array_size = 0;
+    allocations = 0;
+    whitespace_cycles = string_cycles = number_cycles = literal_cycles = total_cycles = 0;
+}
+
+uint64_t ParseStats::token_count(Token::Type type) const
+{
+    return tokens[static_cast<size_t>(type)];
+}
@@ -0,0 +1,136 @@
+#include "json_utf8.hpp"
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_UTF8_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define JSON_UTF8_NEON
+#endif
+
+void json_utf8_append(std::string &out, uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        out.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else if (code_point < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+/// Returns the offset of the first byte at or after i which is not ASCII, or size.
+/// JSON text is mostly ASCII, so nearly all of the input is consumed here. Four blocks of 16 bytes
+/// are combined before testing their high bits, so that the loop has a single branch per 64 bytes
+static size_t skip_ascii(const char *data, size_t size, size_t i)
+{
+#if defined(JSON_UTF8_SSE2)
+    for (; i + 64 <= size; i += 64)
+    {
+        const __m128i *p = reinterpret_cast<const __m128i *>(data + i);
+        __m128i a = _mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+        __m128i b = _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+        if (_mm_movemask_epi8(_mm_or_si128(a, b)))
+            break;
+    }
+    for (; i + 16 <= size; i += 16)
+    {
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))))
+            break;
+    }
+#elif defined(JSON_UTF8_NEON)
+    for (; i + 64 <= size; i += 64)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data + i);
+        uint8x16_t a = vorrq_u8(vld1q_u8(p), vld1q_u8(p + 16));
+        uint8x16_t b = vorrq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48));
+        if (vmaxvq_u8(vorrq_u8(a, b)) >= 0x80)
+            break;
+    }
+    for (; i + 16 <= size; i += 16)
+    {
+        if (vmaxvq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(data + i))) >= 0x80)
+            break;
+    }
+#else
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word & 0x8080808080808080ULL)
+            break;
+    }
+#endif
+    while (i < size && static_cast<unsigned char>(data[i]) < 0x80)
+        i++;
+    return i;
+}
+
+size_t json_validate_utf8(const char *data, size_t size)
+{
+    size_t i = 0;
+    while (true)
+    {
+        i = skip_ascii(data, size, i);
+        if (i == size)
+            return size;
+
+        // Decode one multibyte sequence
+        auto lead = static_cast<unsigned char>(data[i]);
+        size_t length;
+        uint32_t code_point;
+        uint32_t smallest;
+        if ((lead & 0xE0) == 0xC0)
+        {
+            length = 2;
+            code_point = lead & 0x1Fu;
+            smallest = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            length = 3;
+            code_point = lead & 0x0Fu;
+            smallest = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            length = 4;
+            code_point = lead & 0x07u;
+            smallest = 0x10000;
+        }
+        else
+        {
+            // A continuation byte without a lead byte, or a byte which never appears in UTF-8
+            return i;
+        }
+
+        if (size - i < length)
+            return i;
+        for (size_t k = 1; k < length; k++)
+        {
+            auto byte = static_cast<unsigned char>(data[i + k]);
+            if ((byte & 0xC0) != 0x80)
+                return i;
+            code_point = (code_point << 6) | (byte & 0x3Fu);
+        }
+        if (code_point < smallest || code_point > 0x10FFFF ||
+            (code_point >= 0xD800 && code_point <= 0xDFFF))
+            return i;
+        i += length;
+    }
+}
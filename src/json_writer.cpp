@@ -0,0 +1,366 @@
+#include "json_writer.hpp"
+#include "json_lexer.hpp"
+#include "json_scanner.hpp"
+#include <charconv>
+#include <cmath>
+
+/// @brief Appends a quoted string. Runs of characters which need no escaping are appended with a
+/// single call, so that clean strings are copied in bulk.
+void json_write_string(std::string &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char ch = static_cast<unsigned char>(s[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+        out.append(s.data() + run, i - run);
+        run = i + 1;
+        out.push_back('\\');
+        switch (ch)
+        {
+        case '"':
+            out.push_back('"');
+            break;
+        case '\\':
+            out.push_back('\\');
+            break;
+        case '\b':
+            out.push_back('b');
+            break;
+        case '\f':
+            out.push_back('f');
+            break;
+        case '\n':
+            out.push_back('n');
+            break;
+        case '\r':
+            out.push_back('r');
+            break;
+        case '\t':
+            out.push_back('t');
+            break;
+        default:
+            out.append("u00");
+            out.push_back(hex[ch >> 4]);
+            out.push_back(hex[ch & 0xF]);
+            break;
+        }
+    }
+    out.append(s.data() + run, s.size() - run);
+    out.push_back('"');
+}
+
+void json_write_integer(std::string &out, int64_t value)
+{
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void json_write_unsigned(std::string &out, uint64_t value)
+{
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// Writes the shortest round trip representation of a floating point value
+template <typename T> static void write_floating(std::string &out, T value)
+{
+    if (!std::isfinite(value))
+    {
+        out.append("null");
+        return;
+    }
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    bool is_integral = true;
+    for (char *p = buffer; p != result.ptr; p++)
+    {
+        if (*p == '.' || *p == 'e')
+            is_integral = false;
+    }
+    out.append(buffer, result.ptr);
+    if (is_integral)
+        out.append(".0");
+}
+
+void json_write_real(std::string &out, long double value) { write_floating(out, value); }
+
+void json_write_real(std::string &out, double value) { write_floating(out, value); }
+
+static void write_scalar(std::string &out, int64_t value) { json_write_integer(out, value); }
+
+static void write_scalar(std::string &out, long double value) { json_write_real(out, value); }
+
+static void write_scalar(std::string &out, bool value) { out.append(value ? "true" : "false"); }
+
+/// Writes a packed array from its values, without building the JSONObjects of the elements
+template <typename T> static void write_packed(std::string &out, const std::vector<T> &values)
+{
+    out.push_back('[');
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i)
+            out.push_back(',');
+        write_scalar(out, static_cast<T>(values[i]));
+    }
+    out.push_back(']');
+}
+
+void json_write_tree(std::string &out, const JSONObject &ob)
+{
+    switch (ob.type)
+    {
+    case JSONObjectType::NUMBER_REAL:
+        json_write_real(out, ob.as_real());
+        break;
+    case JSONObjectType::NUMBER_INT:
+        json_write_integer(out, ob.as_integer());
+        break;
+    case JSONObjectType::STRING:
+        json_write_string(out, ob.as_string());
+        break;
+    case JSONObjectType::BOOLEAN:
+        out.append(ob.as_bool() ? "true" : "false");
+        break;
+    case JSONObjectType::OBJECT:
+    {
+        out.push_back('{');
+        bool first = true;
+        for (auto &pair : ob.as_kv_pairs())
+        {
+            if (!first)
+                out.push_back(',');
+            first = false;
+            json_write_string(out, pair.first);
+            out.push_back(':');
+            json_write_tree(out, pair.second);
+        }
+        out.push_back('}');
+        break;
+    }
+    case JSONObjectType::ARRAY:
+    {
+        if (auto integers = ob.packed<int64_t>())
+        {
+            write_packed(out, *integers);
+            break;
+        }
+        if (auto reals = ob.packed<long double>())
+        {
+            write_packed(out, *reals);
+            break;
+        }
+        if (auto booleans = ob.packed<bool>())
+        {
+            write_packed(out, *booleans);
+            break;
+        }
+        out.push_back('[');
+        bool first = true;
+        for (auto &element : ob.as_vector())
+        {
+            if (!first)
+                out.push_back(',');
+            first = false;
+            json_write_tree(out, element);
+        }
+        out.push_back(']');
+        break;
+    }
+    default:
+        // Empty objects are only used internally, write them as null
+        out.append("null");
+        break;
+    }
+}
+
+std::string to_json(const JSONObject &ob)
+{
+    std::string out;
+    json_write_tree(out, ob);
+    return out;
+}
+
+/// Output of the reformatting handlers, which appends to a string and optionally moves the string
+/// to a stream whenever it grows past a block, whatever was appended
+class ReformatOutput
+{
+    std::string &out;
+    std::ostream *stream;
+    size_t start;
+
+  public:
+    ReformatOutput(std::string &out, std::ostream *stream)
+        : out(out), stream(stream), start(out.size())
+    {
+    }
+
+    void append(const char *text, size_t length)
+    {
+        out.append(text, length);
+        flush(false);
+    }
+
+    void push_back(char c)
+    {
+        out.push_back(c);
+        flush(false);
+    }
+
+    void flush(bool always)
+    {
+        const size_t block = 1 << 16;
+        if (stream && (always || out.size() >= block))
+        {
+            stream->write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+
+    // Called when the input turns out to be invalid
+    void discard()
+    {
+        if (stream)
+            flush(true);
+        else
+            out.resize(start);
+    }
+};
+
+/// Copies every token with no whitespace in between
+class MinifyHandler
+{
+    ReformatOutput &out;
+
+  public:
+    MinifyHandler(ReformatOutput &out) : out(out) {}
+
+    void begin_container(char c) { out.push_back(c); }
+
+    void end_container(char c, bool) { out.push_back(c); }
+
+    void key(const char *text, size_t length) { out.append(text, length); }
+
+    void scalar(const char *text, size_t length) { out.append(text, length); }
+
+    void separator(char c) { out.push_back(c); }
+};
+
+/// Starts a new line for every member and element, and one before a non empty container closes
+class PrettifyHandler
+{
+    ReformatOutput &out;
+    size_t indent;
+    size_t depth;
+    // Set after a colon, the value which follows stays on the line of its key
+    bool after_key;
+
+    void newline()
+    {
+        out.push_back('\n');
+        for (size_t i = 0; i < depth * indent; i++)
+            out.push_back(' ');
+    }
+
+    void before_value()
+    {
+        if (!after_key && depth > 0)
+            newline();
+        after_key = false;
+    }
+
+  public:
+    PrettifyHandler(ReformatOutput &out, size_t indent)
+        : out(out), indent(indent), depth(0), after_key(false)
+    {
+    }
+
+    void begin_container(char c)
+    {
+        before_value();
+        out.push_back(c);
+        depth++;
+    }
+
+    void end_container(char c, bool empty)
+    {
+        depth--;
+        if (!empty)
+            newline();
+        out.push_back(c);
+    }
+
+    void key(const char *text, size_t length)
+    {
+        newline();
+        out.append(text, length);
+    }
+
+    void scalar(const char *text, size_t length)
+    {
+        before_value();
+        out.append(text, length);
+    }
+
+    void separator(char c)
+    {
+        if (c == ':')
+        {
+            out.append(": ", 2);
+            after_key = true;
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+};
+
+template <typename Handler>
+static void reformat(std::string_view in, Handler &handler, ReformatOutput &output)
+{
+    ParseLimits limits;
+    JSONScanner<Handler> scanner(in.data(), in.size(), limits, handler, false);
+    if (!scanner.scan())
+    {
+        output.discard();
+        throw json_error_at(scanner.message(), in, scanner.offset());
+    }
+    output.flush(true);
+}
+
+void minify(std::string_view in, std::string &out)
+{
+    out.reserve(out.size() + in.size());
+    ReformatOutput output(out, nullptr);
+    MinifyHandler handler(output);
+    reformat(in, handler, output);
+}
+
+void minify(std::string_view in, std::ostream &out)
+{
+    std::string buffer;
+    ReformatOutput output(buffer, &out);
+    MinifyHandler handler(output);
+    reformat(in, handler, output);
+}
+
+void prettify(std::string_view in, std::string &out, size_t indent)
+{
+    ReformatOutput output(out, nullptr);
+    PrettifyHandler handler(output, indent);
+    reformat(in, handler, output);
+}
+
+void prettify(std::string_view in, std::ostream &out, size_t indent)
+{
+    std::string buffer;
+    ReformatOutput output(buffer, &out);
+    PrettifyHandler handler(output, indent);
+    reformat(in, handler, output);
+}
@@ -1,6 +1,6 @@
 #include "token.hpp"
 
-Token::Token() : type(Token::Type::UNKNOWN), is_value_present(false) {}
+Token::Token() : type(Token::Type::UNKNOWN), is_value_present(false), offset(0) {}
 
 int64_t &Token::as_integer() { return std::get<int64_t>(value); }
 
@@ -0,0 +1,125 @@
+#include "json_batch.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+
+static std::vector<std::string> messages(size_t count)
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string id = std::to_string(i);
+        if (i % 10 == 3)
+            result.push_back(R"({"id": )" + id + R"(, "bad": tru})");
+        else
+            result.push_back(R"({"id": )" + id + R"(, "tags": ["a message tag", "b"], )" +
+                             R"("values": [)" + id + ", " + id + R"(.5, null]})");
+    }
+    return result;
+}
+
+TEST(JSONBatchParser, Order)
+{
+    auto documents = messages(1000);
+    std::vector<std::string_view> views(documents.begin(), documents.end());
+
+    for (size_t threads : {1u, 4u})
+    {
+        JSONBatchParser batch(threads);
+        ASSERT_EQ(batch.threads(), threads);
+        // The parsers are reused for the following batches
+        for (int round = 0; round < 2; round++)
+        {
+            auto results = batch.parse(views);
+            ASSERT_EQ(results.size(), documents.size());
+            for (size_t i = 0; i < documents.size(); i++)
+            {
+                if (i % 10 == 3)
+                {
+                    ASSERT_FALSE(results[i].ok());
+                    ASSERT_EQ(results[i].error->offset(), documents[i].find("tru"));
+                    continue;
+                }
+                ASSERT_TRUE(results[i].ok()) << results[i].error->what();
+                ASSERT_EQ(to_json(results[i].tree), to_json(JSONParser(documents[i]).get_tree()));
+            }
+        }
+    }
+    ASSERT_TRUE(JSONBatchParser(0).parse({}).empty());
+    ASSERT_EQ(JSONBatchParser(0).threads(), 1);
+}
+
+TEST(JSONBatchParser, Callback)
+{
+    auto documents = messages(500);
+    std::vector<std::string_view> views(documents.begin(), documents.end());
+    JSONBatchParser batch(3);
+
+    std::vector<std::atomic<int>> calls(documents.size());
+    std::atomic<int64_t> sum(0);
+    batch.parse(views,
+                [&](size_t index, JSONBatchResult &result)
+                {
+                    calls[index]++;
+                    if (result.ok())
+                    {
+                        JSONObject tree = std::move(result.tree);
+                        sum += tree.at("id").get<int64_t>();
+                    }
+                });
+    int64_t expected = 0;
+    for (size_t i = 0; i < documents.size(); i++)
+    {
+        ASSERT_EQ(calls[i], 1);
+        if (i % 10 != 3)
+            expected += static_cast<int64_t>(i);
+    }
+    ASSERT_EQ(sum, expected);
+
+    // An exception thrown by the callback stops the batch and is rethrown, the pool stays usable
+    std::atomic<int> count(0);
+    ASSERT_THROW(batch.parse(views,
+                             [&](size_t index, JSONBatchResult &)
+                             {
+                                 count++;
+                                 if (index == 100)
+                                     throw std::runtime_error("stop");
+                             }),
+                 std::runtime_error);
+    ASSERT_LT(count, static_cast<int>(documents.size()));
+    ASSERT_EQ(batch.parse(views).size(), documents.size());
+}
+
+TEST(JSONBatchParser, NumbersOutOfRange)
+{
+    JSONBatchParser batch(2);
+    std::vector<std::string_view> views = {"1", "99999999999999999999", "[1]", "[1e999999]"};
+    auto results = batch.parse(views);
+    ASSERT_EQ(results[0].tree.get<int>(), 1);
+    ASSERT_FALSE(results[1].ok());
+    ASSERT_EQ(results[1].error->offset(), 0);
+    ASSERT_EQ(results[2].tree.size(), 1);
+    ASSERT_FALSE(results[3].ok());
+    ASSERT_EQ(results[3].error->offset(), 1);
+}
+
+TEST(JSONBatchParser, Settings)
+{
+    JSONBatchParser batch(2);
+    ParseLimits limits;
+    limits.max_depth = 2;
+    batch.set_limits(limits);
+    batch.set_pack_arrays(true);
+
+    std::vector<std::string_view> views = {"[1, 2, 3]", "[[[1]]]", R"({"a": [true, false]})"};
+    auto results = batch.parse(views);
+    ASSERT_EQ(results[0].tree.packed<int64_t>()->size(), 3);
+    ASSERT_FALSE(results[1].ok());
+    ASSERT_NE(std::string(results[1].error->what()).find("max_depth"), std::string::npos);
+    ASSERT_EQ(results[2].tree.at("a").packed_type(), JSONObjectType::BOOLEAN);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,234 @@
+#include "json_binary.hpp"
+#include "json_parser.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+
+static const char *sample = R"(
+    {
+        "int": 42, "neg": -300, "big": 9000000000, "min": -9223372036854775808,
+        "real": 1.5, "frac": -0.15625, "whole": 2.0,
+        "flag": true, "off": false, "nothing": null,
+        "text": "hello world, this string is longer than thirty one bytes",
+        "list": [1, [2, [3, []]], {}], "nested": {"a": {"b": "c"}}
+    }
+)";
+
+TEST(JSONBinary, RoundTrip)
+{
+    JSONParser parser(sample);
+    auto tree = parser.get_tree();
+    auto expected = to_json(tree);
+
+    auto cbor = to_cbor(tree);
+    auto from_c = from_cbor(cbor);
+    ASSERT_EQ(to_json(from_c), expected);
+    ASSERT_EQ(from_c.at("whole").type, JSONObjectType::NUMBER_REAL);
+    ASSERT_EQ(from_c.at("int").type, JSONObjectType::NUMBER_INT);
+
+    auto msgpack = to_msgpack(tree);
+    auto from_m = from_msgpack(msgpack);
+    ASSERT_EQ(to_json(from_m), expected);
+    ASSERT_EQ(from_m.at("whole").type, JSONObjectType::NUMBER_REAL);
+    ASSERT_EQ(from_m.at("min").as_integer(), INT64_MIN);
+
+    // Reals are narrowed to double precision
+    parser.parse("3.141592653589793");
+    ASSERT_NEAR(from_cbor(to_cbor(parser.get_tree())).as_real(), 3.141592653589793, 1e-15);
+    ASSERT_NEAR(from_msgpack(to_msgpack(parser.get_tree())).as_real(), 3.141592653589793, 1e-15);
+
+    ASSERT_LT(cbor.size(), expected.size());
+    ASSERT_LT(msgpack.size(), expected.size());
+}
+
+TEST(JSONBinary, CBORKnownEncodings)
+{
+    JSONParser parser;
+    auto encode = [&](const std::string &json)
+    {
+        parser.parse(json);
+        return to_cbor(parser.get_tree());
+    };
+    ASSERT_EQ(encode("0"), std::vector<uint8_t>({0x00}));
+    ASSERT_EQ(encode("24"), std::vector<uint8_t>({0x18, 0x18}));
+    ASSERT_EQ(encode("-1"), std::vector<uint8_t>({0x20}));
+    ASSERT_EQ(encode("-1000"), std::vector<uint8_t>({0x39, 0x03, 0xe7}));
+    ASSERT_EQ(encode("1.5"), std::vector<uint8_t>({0xfa, 0x3f, 0xc0, 0x00, 0x00}));
+    ASSERT_EQ(encode("1.1"),
+              std::vector<uint8_t>({0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}));
+    ASSERT_EQ(encode("[1, 2, 3]"), std::vector<uint8_t>({0x83, 0x01, 0x02, 0x03}));
+    ASSERT_EQ(encode(R"({"a": 1})"), std::vector<uint8_t>({0xa1, 0x61, 0x61, 0x01}));
+
+    // Half precision floats, indefinite length containers and tags are accepted when decoding
+    ASSERT_NEAR(from_cbor({0xf9, 0x3e, 0x00}).as_real(), 1.5, 1e-9);
+    ASSERT_NEAR(from_cbor({0xf9, 0x00, 0x01}).as_real(), 5.960464477539063e-8, 1e-20);
+    auto indefinite = from_cbor({0x9f, 0x01, 0x7f, 0x61, 0x61, 0x61, 0x62, 0xff, 0xff});
+    ASSERT_EQ(to_json(indefinite), R"([1,"ab"])");
+    ASSERT_EQ(from_cbor({0xbf, 0x61, 0x61, 0xf5, 0xff}).at("a").as_bool(), true);
+    ASSERT_EQ(from_cbor({0xc1, 0x1a, 0x51, 0x4b, 0x67, 0xb0}).as_integer(), 1363896240);
+
+    EXPECT_THROW(from_cbor({0x83, 0x01}), json_parse_error);
+    EXPECT_THROW(from_cbor({0x41, 0x00}), json_parse_error);
+    EXPECT_THROW(from_cbor({0xa1, 0x01, 0x01}), json_parse_error);
+    EXPECT_THROW(from_cbor({0x01, 0x01}), json_parse_error);
+    EXPECT_THROW(from_cbor({0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}),
+                 json_parse_error);
+}
+
+TEST(JSONBinary, MessagePackKnownEncodings)
+{
+    JSONParser parser(R"({"compact": true, "schema": 0})");
+    std::vector<uint8_t> expected = {0x82, 0xa7, 'c', 'o', 'm', 'p', 'a', 'c', 't', 0xc3,
+                                     0xa6, 's',  'c', 'h', 'e', 'm', 'a', 0x00};
+    ASSERT_EQ(to_msgpack(parser.get_tree()), expected);
+
+    parser.parse("[-33, 255, 65536, -129]");
+    ASSERT_EQ(to_msgpack(parser.get_tree()),
+              std::vector<uint8_t>({0x94, 0xd0, 0xdf, 0xcc, 0xff, 0xce, 0x00, 0x01, 0x00, 0x00,
+                                    0xd1, 0xff, 0x7f}));
+
+    EXPECT_THROW(from_msgpack({0x92, 0x01}), json_parse_error);
+    EXPECT_THROW(from_msgpack({0xc1}), json_parse_error);
+    EXPECT_THROW(from_msgpack({0x81, 0x01, 0x01}), json_parse_error);
+}
+
+TEST(JSONBinary, Streaming)
+{
+    JSONParser parser(sample);
+    for (auto format : {BinaryFormat::CBOR, BinaryFormat::MESSAGEPACK})
+    {
+        auto item = format == BinaryFormat::CBOR ? to_cbor(parser.get_tree())
+                                                 : to_msgpack(parser.get_tree());
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < 3; i++)
+            stream.insert(stream.end(), item.begin(), item.end());
+
+        JSONStreamDecoder decoder(format);
+        JSONObject out;
+        int decoded = 0;
+        for (size_t i = 0; i < stream.size(); i += 7)
+        {
+            decoder.feed(stream.data() + i, std::min<size_t>(7, stream.size() - i));
+            while (decoder.next(out))
+            {
+                ASSERT_EQ(to_json(out), to_json(parser.get_tree()));
+                decoded++;
+            }
+        }
+        ASSERT_EQ(decoded, 3);
+        ASSERT_EQ(decoder.pending(), 0);
+    }
+
+    JSONStreamDecoder decoder(BinaryFormat::CBOR);
+    std::vector<uint8_t> bad = {0x01, 0x02, 0x1c};
+    decoder.feed(bad.data(), bad.size());
+    JSONObject out;
+    ASSERT_TRUE(decoder.next(out));
+    ASSERT_TRUE(decoder.next(out));
+    try
+    {
+        decoder.next(out);
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 2);
+    }
+}
+
+TEST(JSONBinary, StreamingResumes)
+{
+    // One large item fed in small chunks is decoded once, from where each call stopped
+    JSONObject::Elements elements;
+    for (int64_t i = 0; i < 200000; i++)
+        elements.emplace_back(i % 3 == 0 ? JSONObject(i) : JSONObject(std::to_string(i)));
+    JSONObject::Members members;
+    members["list"] = JSONObject(std::move(elements));
+    members["tail"] = JSONObject(true);
+    JSONObject tree(std::move(members));
+    for (auto format : {BinaryFormat::CBOR, BinaryFormat::MESSAGEPACK})
+    {
+        auto item = format == BinaryFormat::CBOR ? to_cbor(tree) : to_msgpack(tree);
+        JSONStreamDecoder decoder(format);
+        JSONObject out;
+        size_t decoded = 0;
+        for (size_t i = 0; i < item.size(); i += 16)
+        {
+            size_t size = std::min<size_t>(16, item.size() - i);
+            decoder.feed(item.data() + i, size);
+            ASSERT_EQ(decoder.pending(), i + size);
+            if (decoder.next(out))
+                decoded++;
+        }
+        ASSERT_EQ(decoded, 1);
+        ASSERT_TRUE(out == tree);
+        ASSERT_EQ(decoder.pending(), 0);
+    }
+
+    // Indefinite lengths and tags are resumed as well
+    std::vector<uint8_t> indefinite = {0xbf, 0x61, 0x61, 0x9f, 0x01, 0xc1, 0x7f, 0x61,
+                                       0x61, 0x61, 0x62, 0xff, 0xff, 0xff};
+    JSONStreamDecoder decoder(BinaryFormat::CBOR);
+    JSONObject out;
+    for (size_t i = 0; i < indefinite.size(); i++)
+    {
+        decoder.feed(&indefinite[i], 1);
+        ASSERT_EQ(decoder.next(out), i + 1 == indefinite.size());
+    }
+    ASSERT_EQ(to_json(out), R"({"a":[1,"ab"]})");
+}
+
+TEST(JSONBinary, StreamingMaxItemSize)
+{
+    auto rejects = [](BinaryFormat format, const std::vector<uint8_t> &bytes, size_t offset)
+    {
+        JSONStreamDecoder decoder(format);
+        decoder.set_max_item_size(64);
+        decoder.feed(bytes.data(), bytes.size());
+        JSONObject out;
+        try
+        {
+            while (decoder.next(out))
+                ;
+            FAIL() << "Expected json_limit_error";
+        }
+        catch (const json_limit_error &e)
+        {
+            ASSERT_EQ(e.limit(), "max_item_size");
+            ASSERT_EQ(e.offset(), offset);
+        }
+    };
+    // Declared lengths are rejected before their bytes arrive
+    rejects(BinaryFormat::CBOR, {0x7b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, 0);
+    rejects(BinaryFormat::CBOR, {0x01, 0x82, 0x01, 0x78, 0x40}, 3);
+    rejects(BinaryFormat::CBOR, {0x9a, 0x00, 0x01, 0x00, 0x00}, 0);
+    rejects(BinaryFormat::MESSAGEPACK, {0xdb, 0x7f, 0xff, 0xff, 0xff}, 0);
+    rejects(BinaryFormat::MESSAGEPACK, {0xdf, 0x00, 0x00, 0x00, 0x21}, 0);
+    // An item without a declared length is rejected once it grows past the limit
+    std::vector<uint8_t> endless = {0x9f};
+    endless.resize(100, 0x01);
+    rejects(BinaryFormat::CBOR, endless, 64);
+
+    // Every item is measured on its own
+    JSONParser parser(R"({"a": [1, 2, 3], "b": "text"})");
+    auto item = to_cbor(parser.get_tree());
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 10; i++)
+        stream.insert(stream.end(), item.begin(), item.end());
+    JSONStreamDecoder decoder(BinaryFormat::CBOR);
+    decoder.set_max_item_size(item.size());
+    JSONObject out;
+    int decoded = 0;
+    for (size_t i = 0; i < stream.size(); i += 5)
+    {
+        decoder.feed(stream.data() + i, std::min<size_t>(5, stream.size() - i));
+        while (decoder.next(out))
+            decoded++;
+    }
+    ASSERT_EQ(decoded, 10);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+#include "json_bind.hpp"
+#include "json_parser.hpp"
+#include "gtest/gtest.h"
+
+struct Address
+{
+    std::string city;
+    std::optional<std::string> zip;
+};
+
+template <> struct json_fields<Address>
+{
+    static constexpr auto value =
+        std::make_tuple(JSON_FIELD(Address, city), JSON_FIELD(Address, zip));
+};
+
+struct Record
+{
+    int64_t id = 0;
+    std::string name;
+    double score = 0;
+    bool active = false;
+    std::vector<int> tags;
+    Address address;
+    std::map<std::string, int> counts;
+    JSONObject extra;
+};
+
+template <> struct json_fields<Record>
+{
+    static constexpr auto value = std::make_tuple(
+        JSON_FIELD(Record, id), JSON_FIELD(Record, name), JSON_FIELD(Record, score),
+        json_field("is_active", &Record::active), JSON_FIELD(Record, tags),
+        JSON_FIELD(Record, address), JSON_FIELD(Record, counts), JSON_FIELD(Record, extra));
+};
+
+TEST(JSONBind, KeyDispatch)
+{
+    using dispatch = json_key_dispatch<Record>;
+    static_assert(dispatch::table.seed != 0, "expected a perfect hash for Record");
+    ASSERT_EQ(dispatch::lookup("id"), 0);
+    ASSERT_EQ(dispatch::lookup("is_active"), 3);
+    ASSERT_EQ(dispatch::lookup("extra"), 7);
+    ASSERT_EQ(dispatch::lookup("active"), dispatch::count);
+    ASSERT_EQ(dispatch::lookup(""), dispatch::count);
+}
+
+TEST(JSONBind, Struct)
+{
+    auto record = from_json<Record>(R"(
+        {
+            "id": 42,
+            "name": "widget",
+            "unknown": {"nested": [1, {"a": []}], "x": null},
+            "score": 3,
+            "is_active": true,
+            "tags": [1, 2, 3],
+            "address": {"city": "Pune", "zip": null},
+            "counts": {"a": 1, "b": 2},
+            "extra": {"k": [1.5, "v"]}
+        }
+    )");
+    ASSERT_EQ(record.id, 42);
+    ASSERT_EQ(record.name, "widget");
+    ASSERT_DOUBLE_EQ(record.score, 3.0);
+    ASSERT_EQ(record.active, true);
+    ASSERT_EQ(record.tags, std::vector<int>({1, 2, 3}));
+    ASSERT_EQ(record.address.city, "Pune");
+    ASSERT_EQ(record.address.zip, std::nullopt);
+    ASSERT_EQ(record.counts.size(), 2);
+    ASSERT_EQ(record.counts["b"], 2);
+    ASSERT_EQ(record.extra.at("k").at(1).as_string(), "v");
+}
+
+TEST(JSONBind, VectorOfStructs)
+{
+    auto records = from_json<std::vector<Record>>(
+        R"( [{"id": 1, "address": {"city": "a", "zip": "1"}}, {"name": "b"}, {}] )");
+    ASSERT_EQ(records.size(), 3);
+    ASSERT_EQ(records[0].id, 1);
+    ASSERT_EQ(records[0].address.zip, "1");
+    ASSERT_EQ(records[1].id, 0);
+    ASSERT_EQ(records[1].name, "b");
+    ASSERT_EQ(from_json<std::vector<Record>>("[]").size(), 0);
+    ASSERT_EQ(from_json<std::vector<bool>>("[true, false]"), (std::vector<bool>{true, false}));
+}
+
+TEST(JSONBind, Errors)
+{
+    EXPECT_THROW(from_json<Record>(R"( {"id": "x"} )"), json_parse_error);
+    EXPECT_THROW(from_json<Record>(R"( {"id": 1.5} )"), json_parse_error);
+    EXPECT_THROW(from_json<Record>(R"( {"tags": [1, 2 3]} )"), json_parse_error);
+    EXPECT_THROW(from_json<Record>(R"( {"id": 1 )"), json_parse_error);
+    EXPECT_THROW(from_json<Record>(R"( {"id": 1} {} )"), json_parse_error);
+    EXPECT_THROW(from_json<Record>(R"( {"unknown": [1, 2}} )"), json_parse_error);
+    // Unknown members are skipped with the grammar of the parser
+    for (const char *invalid :
+         {R"({"unknown": [1 2 :]})", R"({"unknown": {"x" 1 , }})", R"({"unknown": [1, ]})",
+          R"({"unknown": {"x": 1, }})", R"({"unknown": {1: 2}})", R"({"unknown": [:]})",
+          R"({"unknown": {"x": }})", R"({"unknown": [1, , 2]})", R"({"unknown": {"x": 1 "y": 2}})"})
+        EXPECT_THROW(from_json<Record>(invalid), json_parse_error) << invalid;
+    EXPECT_NO_THROW(from_json<Record>(R"({"unknown": [[], {}, {"x": [1, {"y": null}]}, "z"]})"));
+    EXPECT_THROW(from_json<std::vector<uint8_t>>("[1, 300]"), json_parse_error);
+    EXPECT_THROW(from_json<std::vector<double>>("[1, 1e4000]"), json_parse_error);
+    EXPECT_THROW(from_json<std::vector<float>>("[1e300]"), json_parse_error);
+}
+
+struct Escaped
+{
+    int a = 1;
+};
+
+template <> struct json_fields<Escaped>
+{
+    static constexpr auto value = std::make_tuple(json_field("quote\"back\\slash\n", &Escaped::a));
+};
+
+TEST(JSONBind, Serialize)
+{
+    Record record;
+    record.id = 7;
+    record.name = "line\n\"quoted\"";
+    record.score = 2;
+    record.active = true;
+    record.tags = {1, 2};
+    record.address.city = "Pune";
+    record.counts = {{"x", 1}};
+    record.extra = JSONObject(JSONObjectType::ARRAY);
+
+    auto text = to_json(record);
+    ASSERT_EQ(text, R"({"id":7,"name":"line\n\"quoted\"","score":2.0,"is_active":true,)"
+                    R"("tags":[1,2],"address":{"city":"Pune","zip":null},"counts":{"x":1},)"
+                    R"("extra":[]})");
+
+    auto copy = from_json<Record>(text);
+    ASSERT_EQ(copy.name, record.name);
+    ASSERT_EQ(copy.tags, record.tags);
+    ASSERT_EQ(copy.address.zip, std::nullopt);
+
+    std::vector<Record> records(2);
+    std::string out = "prefix:";
+    to_json(records, out);
+    ASSERT_EQ(out.rfind("prefix:[{\"id\":0", 0), 0);
+    ASSERT_EQ(from_json<std::vector<Record>>(out.substr(7)).size(), 2);
+
+    ASSERT_EQ(to_json(Escaped()), R"({"quote\"back\\slash\u000a":1})");
+    ASSERT_EQ(from_json<Escaped>(R"({"quote\"back\\slash\n": 5})").a, 5);
+}
+
+TEST(JSONBind, WriteTree)
+{
+    // Control characters are allowed within strings by the lexer
+    JSONParser parser("{\"b\": [1, 2.5, -3e2, true, null, \"\\t\x01\"], \"a\": {}}");
+    ASSERT_EQ(to_json(parser.get_tree()), R"({"a":{},"b":[1,2.5,-300.0,true,null,"\t\u0001"]})");
+
+    std::string out;
+    json_write_real(out, 0.1L);
+    ASSERT_EQ(out, "0.1");
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,229 @@
+#include "json_columns.hpp"
+#include "gtest/gtest.h"
+
+static void expect_same(const JSONTable &a, const JSONTable &b)
+{
+    ASSERT_EQ(a.rows, b.rows);
+    ASSERT_EQ(a.columns.size(), b.columns.size());
+    for (size_t i = 0; i < a.columns.size(); i++)
+    {
+        auto &x = a.columns[i];
+        auto &y = b.columns[i];
+        ASSERT_EQ(x.name, y.name);
+        ASSERT_EQ(x.type, y.type);
+        ASSERT_EQ(x.booleans, y.booleans);
+        ASSERT_EQ(x.integers, y.integers);
+        ASSERT_EQ(x.reals, y.reals);
+        ASSERT_EQ(x.offsets, y.offsets);
+        ASSERT_EQ(x.bytes, y.bytes);
+        ASSERT_EQ(x.validity, y.validity);
+        ASSERT_EQ(x.null_count, y.null_count);
+    }
+}
+
+TEST(JSONColumns, Infer)
+{
+    auto table = json_read_columns(R"(
+        [
+            {"ts": 1, "v": 2, "name": "a", "ok": true, "none": null},
+            {"v": 2.5, "ts": 2, "name": "b\né"},
+            {"ts": 3, "v": null, "name": "", "ok": false, "late": "x"},
+            {}
+        ]
+    )");
+    ASSERT_EQ(table.rows, 4);
+    ASSERT_EQ(table.columns.size(), 6);
+
+    auto ts = table.column("ts");
+    ASSERT_EQ(ts->type, JSONColumnType::INTEGER);
+    ASSERT_EQ(ts->integers, (std::vector<int64_t>{1, 2, 3, 0}));
+    ASSERT_EQ(ts->validity, (std::vector<uint8_t>{0x7}));
+    ASSERT_EQ(ts->null_count, 1);
+
+    auto v = table.column("v");
+    ASSERT_EQ(v->type, JSONColumnType::REAL);
+    ASSERT_TRUE(v->integers.empty());
+    ASSERT_EQ(v->reals, (std::vector<double>{2, 2.5, 0, 0}));
+    ASSERT_TRUE(v->is_valid(1));
+    ASSERT_FALSE(v->is_valid(2));
+
+    auto name = table.column("name");
+    ASSERT_EQ(name->type, JSONColumnType::STRING);
+    ASSERT_EQ(name->offsets, (std::vector<uint64_t>{0, 1, 5, 5, 5}));
+    ASSERT_EQ(name->string(1), "b\n\xc3\xa9");
+    ASSERT_EQ(name->string(2), "");
+    ASSERT_TRUE(name->is_valid(2));
+    ASSERT_FALSE(name->is_valid(3));
+    ASSERT_THROW(ts->string(0), json_access_error);
+
+    auto ok = table.column("ok");
+    ASSERT_EQ(ok->type, JSONColumnType::BOOLEAN);
+    ASSERT_EQ(ok->booleans, (std::vector<uint8_t>{1, 0, 0, 0}));
+    ASSERT_EQ(ok->validity, (std::vector<uint8_t>{0x5}));
+
+    ASSERT_EQ(table.column("none")->type, JSONColumnType::NULL_VALUE);
+    ASSERT_EQ(table.column("none")->null_count, 4);
+
+    auto late = table.column("late");
+    ASSERT_EQ(table.columns.back().name, "late");
+    ASSERT_EQ(late->offsets, (std::vector<uint64_t>{0, 0, 0, 1, 1}));
+    ASSERT_EQ(late->validity, (std::vector<uint8_t>{0x4}));
+
+    ASSERT_EQ(table.column("missing"), nullptr);
+    ASSERT_EQ(json_read_columns(" [ ] ").rows, 0);
+}
+
+TEST(JSONColumns, Schema)
+{
+    JSONColumnOptions options;
+    options.schema = {{"v", JSONColumnType::REAL}, {"id", JSONColumnType::INTEGER}};
+    auto table = json_read_columns(
+        R"([{"id": 1, "tags": [1, {"a": []}], "v": 3}, {"v": 1.5, "other": {"x": "y"}}])", options);
+    ASSERT_EQ(table.rows, 2);
+    ASSERT_EQ(table.columns.size(), 2);
+    ASSERT_EQ(table.columns[0].name, "v");
+    ASSERT_EQ(table.columns[0].reals, (std::vector<double>{3, 1.5}));
+    ASSERT_EQ(table.columns[1].integers, (std::vector<int64_t>{1, 0}));
+    ASSERT_EQ(table.columns[1].null_count, 1);
+
+    try
+    {
+        json_read_columns(R"([{"id": 1.5}])", options);
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 8);
+        ASSERT_NE(std::string(e.what()).find("Cannot store real in integer column \"id\""),
+                  std::string::npos);
+    }
+}
+
+TEST(JSONColumns, Errors)
+{
+    struct s
+    {
+        std::string input;
+        size_t offset;
+    };
+
+    std::vector<s> inputs = {
+        {R"({"a": 1})", 0},
+        {R"(  )", 2},
+        {R"([{"a": 1}] x)", 11},
+        {R"([)", 0},
+        {R"([{"a": 1}, 2])", 11},
+        {R"([{"a": 1},])", 10},
+        {R"([{"a": 1} {"a": 2}])", 10},
+        {R"([{"a": {"b": 1}}])", 7},
+        {R"([{"a": 1}, {"a": "x"}])", 17},
+        {R"([{"a": 1, "a": 2}])", 10},
+        {R"([{"a": tru}])", 7},
+        {R"([{"a": 1, }])", 10},
+        {R"([{"a" 1}])", 6},
+    };
+    for (auto &input : inputs)
+    {
+        try
+        {
+            json_read_columns(input.input);
+            FAIL() << "Expected json_parse_error for " << input.input;
+        }
+        catch (const json_parse_error &e)
+        {
+            ASSERT_EQ(e.offset(), input.offset) << input.input << ": " << e.what();
+        }
+    }
+
+    // Errors found by the lexer keep its message
+    std::vector<std::pair<std::string, std::string>> messages = {
+        {R"([{"a": 1}, {"a": "\q"}])", "Invalid escape character at offset 18"},
+        {R"([{"a": 99999999999999999999}])", "Number out of range at offset 7"},
+        {R"([{"a": 1e999999}])", "Number out of range at offset 7"},
+    };
+    for (auto &message : messages)
+    {
+        try
+        {
+            json_read_columns(message.first);
+            FAIL() << "Expected json_parse_error for " << message.first;
+        }
+        catch (const json_parse_error &e)
+        {
+            ASSERT_EQ(std::string(e.what()).find(message.second), 0) << e.what();
+        }
+    }
+}
+
+TEST(JSONColumns, Chunks)
+{
+    std::string text = "[";
+    for (int i = 0; i < 3000; i++)
+    {
+        if (i)
+            text += ",\n";
+        text += "{\"id\": " + std::to_string(i) + ", \"s\": \"a,]}\\\"" + std::to_string(i) + "\"";
+        if (i % 7)
+            text += ", \"v\": " + (i < 1500 ? std::to_string(i) : std::to_string(i) + ".5");
+        if (i > 2000)
+            text += ", \"late\": " + std::string(i % 2 ? "true" : "null");
+        text += ", \"n\": [{\"x\": [1, \"]\"]}]}";
+    }
+    text += "]";
+
+    JSONColumnOptions options;
+    options.schema = {{"id", JSONColumnType::INTEGER},
+                      {"s", JSONColumnType::STRING},
+                      {"v", JSONColumnType::REAL},
+                      {"late", JSONColumnType::BOOLEAN}};
+    auto expected = json_read_columns(text, options);
+    ASSERT_EQ(expected.rows, 3000);
+    ASSERT_EQ(expected.columns[1].string(12), "a,]}\"12");
+    ASSERT_EQ(expected.columns[2].reals[1501], 1501.5);
+
+    options.threads = 4;
+    options.min_chunk_size = 1000;
+    expect_same(json_read_columns(text, options), expected);
+
+    // Without the nested values the columns can be inferred, each chunk infers its own types
+    std::string flat = text;
+    std::string nested = ", \"n\": [{\"x\": [1, \"]\"]}]";
+    for (size_t at = flat.find(nested); at != std::string::npos; at = flat.find(nested, at))
+        flat.erase(at, nested.size());
+    auto inferred = json_read_columns(flat);
+    ASSERT_EQ(inferred.column("v")->type, JSONColumnType::REAL);
+    ASSERT_EQ(inferred.column("late")->null_count, 2000 + 500);
+    options.schema.clear();
+    expect_same(json_read_columns(flat, options), inferred);
+
+    // Errors are reported at their offset in the whole input, whichever chunk they are in
+    std::string mixed = flat;
+    size_t at = mixed.rfind("\"id\": 2999") + 6;
+    mixed.replace(at, 4, "\"x\"");
+    std::string invalid = flat;
+    invalid.replace(invalid.rfind("true"), 4, "tru");
+    for (size_t threads : {1u, 4u})
+    {
+        options.threads = threads;
+        std::vector<std::pair<std::string, size_t>> errors = {{mixed, at},
+                                                              {invalid, flat.rfind("true")}};
+        for (auto &error : errors)
+        {
+            try
+            {
+                json_read_columns(error.first, options);
+                FAIL() << "Expected json_parse_error";
+            }
+            catch (const json_parse_error &e)
+            {
+                ASSERT_EQ(e.offset(), error.second) << e.what();
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -32,6 +32,140 @@ TEST(JSONErrors, CheckInvalidJSON)
     }
 }
 
+TEST(JSONErrors, ErrorLocation)
+{
+    JSONParser parser;
+    std::string input = "{\n  \"a\": 1,\n  \"b\": [1, 2,, 3]\n}";
+    try
+    {
+        parser.parse(input);
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), input.find(",,") + 1);
+        auto loc = parser.location(e.offset());
+        ASSERT_EQ(loc.line, 3);
+        ASSERT_EQ(loc.column, 14);
+        ASSERT_NE(e.excerpt().find("[1, 2,, 3]"), std::string::npos);
+        ASSERT_EQ(std::string(e.what()).rfind(e.message(), 0), 0);
+        ASSERT_EQ(e.message().find("offset"), std::string::npos);
+    }
+
+    JSONLexer lexer("\n\n   \"unterminated");
+    try
+    {
+        lexer.next();
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 5);
+        auto loc = lexer.location(e.offset());
+        ASSERT_EQ(loc.line, 3);
+        ASSERT_EQ(loc.column, 4);
+    }
+
+    // Newlines are counted a word at a time, check a long input with a tail
+    std::string lines(1003, '\n');
+    lines += "[x]";
+    lexer.load(lines);
+    ASSERT_EQ(lexer.next().type, Token::Type::LEFT_SQUARE);
+    try
+    {
+        lexer.next();
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 1004);
+        ASSERT_EQ(lexer.location(e.offset()).line, 1004);
+        ASSERT_EQ(lexer.location(e.offset()).column, 2);
+    }
+}
+
+// Parses input with a limit set to value and returns the name of the limit which was exceeded, or
+// an empty string if the input was accepted
+static std::string exceeded(const std::string &input, size_t ParseLimits::*limit, size_t value)
+{
+    ParseLimits limits;
+    limits.*limit = value;
+    JSONParser parser(limits);
+    try
+    {
+        parser.parse(input);
+        return "";
+    }
+    catch (const json_limit_error &e)
+    {
+        return e.limit();
+    }
+}
+
+TEST(JSONErrors, Limits)
+{
+    const std::string input = R"({"a": [1, [2, 3], {"b": "hello"}], "key": -12.5e3, "c": [[[]]]})";
+
+    struct s
+    {
+        const char *name;
+        size_t ParseLimits::*limit;
+        size_t value;
+    };
+
+    // The smallest value of each limit which accepts the input
+    std::vector<s> limits = {
+        {"max_bytes", &ParseLimits::max_bytes, input.size()},
+        {"max_depth", &ParseLimits::max_depth, 4},
+        {"max_nodes", &ParseLimits::max_nodes, 12},
+        {"max_string_length", &ParseLimits::max_string_length, 5},
+        {"max_number_length", &ParseLimits::max_number_length, 7},
+        {"max_container_size", &ParseLimits::max_container_size, 3},
+        {"max_allocated_bytes", &ParseLimits::max_allocated_bytes,
+         JSONParser(input).get_tree().memory_usage().total()},
+    };
+    for (auto &limit : limits)
+    {
+        ASSERT_EQ(exceeded(input, limit.limit, limit.value), "") << limit.name;
+        ASSERT_EQ(exceeded(input, limit.limit, limit.value - 1), limit.name) << limit.name;
+    }
+
+    // Escapes count after decoding, and the length of the runs of escapes and of plain characters
+    // adds up
+    ASSERT_EQ(exceeded(R"(["\né😁"])", &ParseLimits::max_string_length, 7), "");
+    ASSERT_EQ(exceeded(R"(["\né😁"])", &ParseLimits::max_string_length, 6),
+              "max_string_length");
+    ASSERT_EQ(exceeded(R"(["ab\n\tcd\"ef"])", &ParseLimits::max_string_length, 9), "");
+    ASSERT_EQ(exceeded(R"(["ab\n\tcd\"ef"])", &ParseLimits::max_string_length, 8),
+              "max_string_length");
+    ParseLimits strings;
+    strings.max_string_length = 4;
+    JSONParser parser(strings);
+    parser.parse("[\"abcd\"]");
+    try
+    {
+        parser.parse("[\"abcdefgh\", 1, 2]");
+        FAIL() << "Expected json_limit_error";
+    }
+    catch (const json_limit_error &e)
+    {
+        ASSERT_EQ(e.offset(), 1);
+        ASSERT_NE(std::string(e.what()).find("max_string_length of 4"), std::string::npos);
+    }
+    // A failed parse keeps the previous tree, and the parser can be used again
+    ASSERT_EQ(parser.get_tree().at(0).as_string(), "abcd");
+    parser.parse("[\"dcba\"]");
+    ASSERT_EQ(parser.get_tree().at(0).as_string(), "dcba");
+
+    // Limit errors are parse errors, so existing handlers catch them
+    ParseLimits depth;
+    depth.max_depth = 64;
+    parser.set_limits(depth);
+    EXPECT_THROW(parser.parse(std::string(100000, '[')), json_parse_error);
+    EXPECT_THROW(parser.parse(std::string(65, '[') + std::string(65, ']')), json_limit_error);
+    ASSERT_NO_THROW(parser.parse(std::string(64, '[') + std::string(64, ']')));
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,7 @@
 #include "json_lexer.hpp"
+#include "json_utf8.hpp"
 #include "gtest/gtest.h"
+#include <limits>
 
 TEST(JSONLexer, Empty)
 {
@@ -186,6 +188,97 @@ TEST(JSONLexer, StringWithEscapeCharactersError)
     EXPECT_THROW(lexer.next(), json_parse_error);
 }
 
+TEST(JSONLexer, UnicodeEscapes)
+{
+    JSONLexer lexer;
+
+    struct s
+    {
+        std::string s1;
+        std::string s2;
+    };
+
+    std::vector<s> escaped = {
+        {R"( "\u0041" )", "A"},
+        {R"( "\u00e9\u00E9" )", "\xC3\xA9\xC3\xA9"},
+        {R"( "\u20AC" )", "\xE2\x82\xAC"},
+        {R"( "\uFFFF" )", "\xEF\xBF\xBF"},
+        {R"( "\uD83D\uDE01" )", "\xF0\x9F\x98\x81"},
+        {R"( "\uDBFF\uDFFF" )", "\xF4\x8F\xBF\xBF"},
+        {R"( "a\u0000b" )", std::string("a\0b", 3)},
+        {R"( "\u0022\u005C\n" )", "\"\\\n"},
+    };
+    for (auto &e : escaped)
+    {
+        lexer.load(e.s1);
+        auto token = lexer.next();
+        ASSERT_EQ(token.type, Token::Type::STRING);
+        ASSERT_EQ(token.as_string(), e.s2);
+    }
+
+    std::vector<std::string> invalid = {
+        R"( "\u12" )",         R"( "\u12G4" )",       R"( "\uD83D" )",
+        R"( "\uD83Dx" )",      R"( "\uD83D\n" )",     R"( "\uD83DA" )",
+        R"( "\uDE01\uD83D" )", R"( "\u" )",
+    };
+    for (auto &e : invalid)
+    {
+        lexer.load(e);
+        EXPECT_THROW(lexer.next(), json_parse_error) << e;
+    }
+}
+
+TEST(JSONLexer, ValidateUTF8)
+{
+    struct s
+    {
+        std::string text;
+        size_t invalid;
+    };
+
+    std::vector<s> inputs = {
+        {"", 0},
+        {"plain ascii", 11},
+        {"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x81", 9},
+        {"ab\x80", 2},
+        {"ab\xC3", 2},
+        {"ab\xC3(", 2},
+        {"\xC0\xAF", 0},
+        {"\xE0\x80\xAF", 0},
+        {"\xED\xA0\x80", 0},
+        {"\xF4\x90\x80\x80", 0},
+        {"\xFF", 0},
+    };
+    for (auto &input : inputs)
+        ASSERT_EQ(json_validate_utf8(input.text.data(), input.text.size()), input.invalid)
+            << input.text;
+
+    // The error is found wherever it is relative to the blocks checked at once
+    for (size_t length = 0; length < 200; length++)
+    {
+        std::string text(length, 'a');
+        ASSERT_EQ(json_validate_utf8(text.data(), text.size()), length);
+        text += "\xE2\x82\xAC";
+        text += std::string(length % 70, 'b');
+        ASSERT_EQ(json_validate_utf8(text.data(), text.size()), text.size());
+        text += "\xE2\x82";
+        ASSERT_EQ(json_validate_utf8(text.data(), text.size()), text.size() - 2);
+    }
+
+    JSONLexer lexer("[\"\xC3\xA9\", \"\xC3\xA9\"]");
+    lexer.validate_utf8();
+    try
+    {
+        lexer.load("[\"\xC3\xA9\", \"\xC3\"]");
+        lexer.validate_utf8();
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 8);
+    }
+}
+
 TEST(JSONLexer, SampleJSON)
 {
     JSONLexer lexer;
@@ -287,6 +380,25 @@ TEST(JSONLexer, InvalidNumbers)
 
     lexer.load("0xfffa");
     EXPECT_THROW(lexer.next(), json_parse_error);
+
+    // Numbers which cannot be represented are parse errors at the start of the number
+    for (auto number : {"99999999999999999999", "-9223372036854775809", "1e999999", "2.5e-999999"})
+    {
+        lexer.load(std::string("[") + number + "]");
+        lexer.next();
+        try
+        {
+            lexer.next();
+            FAIL() << "Expected json_parse_error for " << number;
+        }
+        catch (const json_parse_error &e)
+        {
+            EXPECT_EQ(e.offset(), 1);
+            EXPECT_NE(std::string(e.what()).find("Number out of range"), std::string::npos);
+        }
+    }
+    lexer.load("-9223372036854775808");
+    EXPECT_EQ(lexer.next().as_integer(), std::numeric_limits<int64_t>::min());
 }
 
 TEST(JSONLexer, Literals)
@@ -0,0 +1,452 @@
+#include "json_allocations.hpp"
+#include "json_binary.hpp"
+#include "json_canonical.hpp"
+#include "json_parser.hpp"
+#include "json_patch.hpp"
+#include "json_path.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+#include <thread>
+#include <unordered_set>
+
+TEST(JSONObject, Lookup)
+{
+    JSONParser parser(R"( {"a": 1, "b": {"c": "value"}, "d": [true, null]} )");
+    const JSONObject &tree = parser.get_tree();
+
+    ASSERT_TRUE(tree.contains("a"));
+    ASSERT_FALSE(tree.contains("missing"));
+    ASSERT_EQ(tree.find("missing"), nullptr);
+    ASSERT_EQ(tree.size(), 3);
+
+    ASSERT_EQ(tree.at("a").as_integer(), 1);
+    ASSERT_EQ(tree.at("b").at("c").as_string(), "value");
+    ASSERT_EQ(tree.at("d").at(0).as_bool(), true);
+    ASSERT_EQ(tree.at("d").at(1).type, JSONObjectType::NULL_VALUE);
+
+    std::string_view key = "b";
+    ASSERT_NE(tree.find(key), nullptr);
+    ASSERT_EQ(tree.find(key)->find("c")->as_string(), "value");
+
+    EXPECT_THROW(tree.at("missing"), json_access_error);
+    EXPECT_THROW(tree.at("d").at(2), json_access_error);
+    EXPECT_THROW(tree.at("a").at("x"), json_access_error);
+    ASSERT_EQ(tree.at("a").find("x"), nullptr);
+
+    // Lookups must not insert missing keys
+    ASSERT_EQ(tree.size(), 3);
+}
+
+TEST(JSONObject, GetIf)
+{
+    JSONParser parser(R"( {"a": 1, "b": 2.5, "c": "s"} )");
+    const JSONObject &tree = parser.get_tree();
+
+    ASSERT_NE(tree.at("a").get_if<int64_t>(), nullptr);
+    ASSERT_EQ(*tree.at("a").get_if<int64_t>(), 1);
+    ASSERT_EQ(tree.at("a").get_if<long double>(), nullptr);
+    ASSERT_NE(tree.at("b").get_if<long double>(), nullptr);
+    ASSERT_EQ(*tree.at("c").get_if<std::string>(), "s");
+    ASSERT_EQ(tree.at("c").get_if<bool>(), nullptr);
+    for (auto type : {JSONObjectType::NULL_VALUE, JSONObjectType::EMPTY})
+    {
+        JSONObject ob(type);
+        ASSERT_EQ(ob.get_if<std::string>(), nullptr);
+        ASSERT_EQ(ob.get_if<int64_t>(), nullptr);
+        ASSERT_EQ(ob.get_if<long double>(), nullptr);
+        ASSERT_EQ(ob.get_if<bool>(), nullptr);
+        ASSERT_EQ(ob.get_if<JSONObject::Members>(), nullptr);
+        ASSERT_EQ(ob.get_if<JSONObject::Elements>(), nullptr);
+    }
+}
+
+TEST(JSONObject, ConcurrentReads)
+{
+    JSONParser parser(R"( {"a": {"b": [1, 2, 3]}, "c": "value"} )");
+    const JSONObject &tree = parser.get_tree();
+
+    std::vector<std::thread> readers;
+    std::vector<int64_t> sums(8, 0);
+    for (size_t i = 0; i < sums.size(); i++)
+    {
+        readers.emplace_back(
+            [&tree, &sums, i]()
+            {
+                for (int j = 0; j < 1000; j++)
+                {
+                    for (auto &element : tree.at("a").at("b").as_vector())
+                        sums[i] += element.as_integer();
+                    if (tree.contains("missing"))
+                        sums[i] = -1;
+                }
+            });
+    }
+    for (auto &reader : readers)
+        reader.join();
+    for (auto sum : sums)
+        ASSERT_EQ(sum, 6000);
+    ASSERT_EQ(tree.size(), 2);
+}
+
+struct Point
+{
+    double x;
+    double y;
+};
+
+template <> struct json_converter<Point>
+{
+    static bool convert(const JSONObject &ob, Point &out)
+    {
+        auto x = ob.find("x");
+        auto y = ob.find("y");
+        return x && y && json_converter<double>::convert(*x, out.x) &&
+               json_converter<double>::convert(*y, out.y);
+    }
+};
+
+TEST(JSONObject, TypedAccessors)
+{
+    JSONParser parser(R"( {"int": 300, "neg": -5, "real": 2.5, "flag": true, "name": "abc",
+                           "list": [1, 2, 3], "mixed": [1, "a"], "nothing": null,
+                           "point": {"x": 1, "y": 2.5}, "points": [{"x": 0, "y": 0}]} )");
+    const JSONObject &tree = parser.get_tree();
+
+    ASSERT_EQ(tree.at("int").get<int64_t>(), 300);
+    ASSERT_EQ(tree.at("int").get<int>(), 300);
+    ASSERT_EQ(tree.at("int").get<uint16_t>(), 300);
+    EXPECT_THROW(tree.at("int").get<int8_t>(), json_access_error);
+    EXPECT_THROW(tree.at("neg").get<unsigned>(), json_access_error);
+    ASSERT_EQ(tree.at("neg").get<int8_t>(), -5);
+
+    // Integers widen to floating point, but reals never narrow to integers
+    ASSERT_DOUBLE_EQ(tree.at("int").get<double>(), 300.0);
+    ASSERT_DOUBLE_EQ(tree.at("real").get<double>(), 2.5);
+    EXPECT_THROW(tree.at("real").get<int64_t>(), json_access_error);
+
+    // Reals outside the finite range of the type are rejected, as integers which do not fit are
+    JSONParser large(R"([1e4000, -1e4000, 1e300, 3.4e38])");
+    auto &reals = large.get_tree().as_vector();
+    EXPECT_THROW(reals[0].get<double>(), json_access_error);
+    EXPECT_THROW(reals[1].get<double>(), json_access_error);
+    ASSERT_DOUBLE_EQ(reals[2].get<double>(), 1e300);
+    EXPECT_THROW(reals[2].get<float>(), json_access_error);
+    ASSERT_FLOAT_EQ(reals[3].get<float>(), 3.4e38f);
+    ASSERT_EQ(reals[0].get<long double>(), reals[0].as_real());
+
+    ASSERT_EQ(tree.at("flag").get<bool>(), true);
+    EXPECT_THROW(tree.at("int").get<bool>(), json_access_error);
+
+    ASSERT_EQ(tree.at("name").get<std::string>(), "abc");
+    ASSERT_EQ(tree.at("name").get<std::string_view>(), "abc");
+    EXPECT_THROW(tree.at("nothing").get<std::string>(), json_access_error);
+
+    ASSERT_EQ(tree.at("list").get<std::vector<int>>(), std::vector<int>({1, 2, 3}));
+    EXPECT_THROW(tree.at("mixed").get<std::vector<int>>(), json_access_error);
+    JSONParser flags("[true, false, true]");
+    ASSERT_EQ(flags.get_tree().get<std::vector<bool>>(), (std::vector<bool>{true, false, true}));
+    EXPECT_THROW(tree.at("list").get<std::vector<bool>>(), json_access_error);
+
+    ASSERT_EQ(tree.at("nothing").get<std::optional<int>>(), std::nullopt);
+    ASSERT_EQ(tree.at("int").get<std::optional<int>>(), 300);
+    EXPECT_THROW(tree.at("name").get<std::optional<int>>(), json_access_error);
+
+    ASSERT_EQ(tree.at("name").get_or<int>(7), 7);
+    ASSERT_EQ(tree.at("int").get_or<int>(7), 300);
+    ASSERT_EQ(tree.at("name").try_get<int>(), std::nullopt);
+    ASSERT_EQ(tree.at("int").try_get<int>(), 300);
+
+    auto point = tree.at("point").get<Point>();
+    ASSERT_DOUBLE_EQ(point.x, 1.0);
+    ASSERT_DOUBLE_EQ(point.y, 2.5);
+    ASSERT_EQ(tree.at("points").get<std::vector<Point>>().size(), 1);
+    ASSERT_EQ(tree.at("int").try_get<Point>().has_value(), false);
+}
+
+TEST(JSONObject, MemoryUsage)
+{
+    const std::string key = "a key which is too long for the small string buffer";
+    const std::string text = "a string value which is also too long to be stored inline";
+    const std::string buffer = "{\"short\": \"abc\", \"" + key + "\": [1, 2, 3], " +
+                               "\"nested\": {\"s\": \"" + text + "\"}, \"empty\": []}";
+    JSONParser parser(buffer);
+    auto &tree = parser.get_tree();
+
+    auto usage = tree.memory_usage();
+    // Five members and three elements
+    ASSERT_EQ(usage.nodes, 8 * sizeof(JSONObject));
+    ASSERT_EQ(usage.strings, key.size() + 1 + text.size() + 1);
+    ASSERT_EQ(usage.arrays, 0);
+    ASSERT_GT(usage.objects, 0);
+    ASSERT_EQ(JSONObject(int64_t(1)).memory_usage().total(), 0);
+
+    // A copy shares the containers, a clone allocates exactly what the tree holds: five map nodes,
+    // one array, two strings and the shared blocks of two maps and one array
+    JSONAllocationCounter counter;
+    JSONObject copy = tree;
+    ASSERT_EQ(counter.count(), 0);
+    copy = tree.clone();
+    ASSERT_EQ(counter.count(), 11);
+    ASSERT_EQ(counter.bytes(), usage.total());
+    ASSERT_EQ(usage.shared, 2 * JSONMemoryUsage::shared_size(JSONObjectType::OBJECT) +
+                                JSONMemoryUsage::shared_size(JSONObjectType::ARRAY));
+
+    // Spare capacity of arrays is reported separately
+    auto &elements = copy[key].as_vector();
+    elements.push_back(JSONObject(int64_t(4)));
+    auto grown = copy.memory_usage();
+    ASSERT_EQ(grown.nodes, usage.nodes + sizeof(JSONObject));
+    ASSERT_EQ(grown.arrays, (elements.capacity() - elements.size()) * sizeof(JSONObject));
+
+    // Growing the elements while parsing, and the array of the tree
+    counter.reset();
+    parser.parse("[1, 2, 3]");
+    ASSERT_LE(counter.count(), 4);
+}
+
+TEST(JSONObject, CopyOnWrite)
+{
+    JSONParser parser(R"({"config": {"hosts": ["a", "b"], "port": 80}, "users": [{"name": "x"}]})");
+    const JSONObject original = parser.get_tree();
+
+    JSONAllocationCounter counter;
+    JSONObject copy = original;
+    ASSERT_EQ(counter.count(), 0);
+    ASSERT_EQ(&copy.at("config").at("hosts"), &original.at("config").at("hosts"));
+
+    // Only the containers on the path to the modified value are copied
+    copy["config"]["hosts"].as_vector().push_back(JSONObject(std::string("c")));
+    ASSERT_EQ(original.at("config").at("hosts").size(), 2);
+    ASSERT_EQ(copy.at("config").at("hosts").size(), 3);
+    ASSERT_EQ(&copy.at("users").as_vector(), &original.at("users").as_vector());
+    ASSERT_NE(&copy.at("config").as_kv_pairs(), &original.at("config").as_kv_pairs());
+
+    // Every copy can be modified on its own
+    std::vector<JSONObject> copies(3, original);
+    for (size_t i = 0; i < copies.size(); i++)
+        copies[i]["config"]["port"].as_integer() = static_cast<int64_t>(i);
+    for (size_t i = 0; i < copies.size(); i++)
+        ASSERT_EQ(copies[i].at("config").at("port").get<int64_t>(), i);
+    ASSERT_EQ(original.at("config").at("port").get<int64_t>(), 80);
+    ASSERT_EQ(parser.get_tree().at("config").at("port").get<int64_t>(), 80);
+
+    // A clone shares nothing, empty containers are not allocated
+    auto clone = original.clone();
+    ASSERT_NE(&clone.at("users").as_vector(), &original.at("users").as_vector());
+    counter.reset();
+    JSONObject empty_object;
+    JSONObject empty_array(JSONObjectType::ARRAY);
+    ASSERT_EQ(empty_object.size() + empty_array.size(), 0);
+    ASSERT_EQ(counter.count(), 0);
+}
+
+TEST(JSONObject, Equality)
+{
+    std::vector<std::pair<std::string, std::string>> equal = {
+        {"null", "null"},
+        {"[1, 2.5, \"a\", true]", "[1,2.5,\"a\",true]"},
+        {R"({"a": 1, "b": {"c": []}})", R"({"b": {"c": []}, "a": 1})"},
+        {"{}", "{}"},
+        {"[0.0]", "[-0.0]"},
+    };
+    JSONParser parser;
+    for (auto &pair : equal)
+    {
+        parser.parse(pair.first);
+        JSONObject a = parser.get_tree();
+        parser.parse(pair.second);
+        JSONObject b = parser.get_tree();
+        ASSERT_TRUE(a == b) << pair.first;
+        ASSERT_EQ(a.hash(), b.hash()) << pair.first;
+    }
+
+    std::vector<std::string> distinct = {"null",  "true",  "false", "1",      "1.0",   "\"1\"",
+                                         "[]",    "{}",    "[1]",   "[[1]]",  "[1, 2]", "[2, 1]",
+                                         "[null]", "[{}]", "[\"\"]", "{\"a\": 1}", "{\"a\": 2}",
+                                         "{\"b\": 1}"};
+    std::unordered_set<JSONObject> set;
+    for (auto &text : distinct)
+    {
+        parser.parse(text);
+        ASSERT_TRUE(set.insert(parser.get_tree()).second) << text;
+    }
+    for (auto &text : distinct)
+    {
+        parser.parse(text);
+        ASSERT_EQ(set.count(parser.get_tree()), 1) << text;
+    }
+    for (size_t i = 0; i < distinct.size(); i++)
+    {
+        for (size_t j = 0; j < distinct.size(); j++)
+        {
+            parser.parse(distinct[i]);
+            JSONObject a = parser.get_tree();
+            parser.parse(distinct[j]);
+            ASSERT_EQ(a == parser.get_tree(), i == j) << distinct[i] << " " << distinct[j];
+        }
+    }
+}
+
+TEST(JSONObject, CachedHash)
+{
+    JSONParser parser(R"({"list": [1, 2, {"deep": "x"}], "n": 1})");
+    JSONObject tree = parser.get_tree();
+    ASSERT_FALSE(tree.cached_hash());
+    ASSERT_TRUE(JSONObject(int64_t(1)).cached_hash());
+
+    auto hash = tree.hash();
+    ASSERT_EQ(tree.cached_hash(), hash);
+    ASSERT_TRUE(tree.at("list").at(2).cached_hash());
+    // Copies share the cache, and compare equal without being walked
+    JSONObject copy = tree;
+    ASSERT_EQ(copy.cached_hash(), hash);
+    ASSERT_TRUE(copy == tree);
+
+    // A modification clears the hashes on the path to the modified value only
+    copy["list"].as_vector()[2]["deep"] = JSONObject(std::string("y"));
+    ASSERT_FALSE(copy.cached_hash());
+    ASSERT_FALSE(copy.at("list").cached_hash());
+    ASSERT_EQ(tree.cached_hash(), hash);
+    ASSERT_NE(copy.hash(), hash);
+    ASSERT_TRUE(copy != tree);
+    copy["list"].as_vector()[2]["deep"] = JSONObject(std::string("x"));
+    ASSERT_EQ(copy.hash(), hash);
+    ASSERT_TRUE(copy == tree);
+}
+
+TEST(JSONObject, HashWithHeldReference)
+{
+    // A reference to a child kept across a hash modifies the child without passing through its
+    // parent, which therefore never caches its hash
+    JSONObject a;
+    JSONObject &x = a["x"];
+    x = JSONObject(JSONObjectType::OBJECT);
+    JSONObject b = a.clone();
+    a.hash();
+    b.hash();
+    ASSERT_TRUE(b.cached_hash());
+    x["y"] = JSONObject(int64_t(2));
+    b["x"]["y"] = JSONObject(int64_t(2));
+    ASSERT_EQ(a.hash(), b.hash());
+    ASSERT_TRUE(a == b);
+    x = JSONObject(int64_t(3));
+    ASSERT_NE(a.hash(), b.hash());
+    ASSERT_TRUE(a != b);
+
+    // The trees built by the parser and by clone() cache every hash
+    JSONParser parser(R"({"a": {"b": [1, {"c": 2}]}})");
+    auto &tree = parser.get_tree();
+    tree.hash();
+    ASSERT_TRUE(tree.at("a").at("b").at(1).cached_hash());
+    JSONObject copy = a.clone();
+    copy.hash();
+    ASSERT_TRUE(copy.cached_hash());
+    ASSERT_FALSE(a.cached_hash());
+}
+
+TEST(JSONObject, PackedArrays)
+{
+    JSONParser parser(R"([[1, 2, 3], [1.5, -0.0], [true, false, true], [1, 2.5], ["a"], []])");
+    auto &tree = parser.get_tree();
+    std::vector<bool> packable = {true, true, true, false, false, false};
+    for (size_t i = 0; i < packable.size(); i++)
+    {
+        JSONObject copy = tree.at(i);
+        ASSERT_EQ(copy.pack(), packable[i]);
+        ASSERT_EQ(copy.packed_type() != JSONObjectType::EMPTY, packable[i]);
+        ASSERT_EQ(copy.size(), tree.at(i).size());
+        ASSERT_EQ(copy.hash(), tree.at(i).hash());
+        ASSERT_TRUE(copy == tree.at(i));
+        ASSERT_TRUE(tree.at(i) == copy);
+        ASSERT_EQ(to_json(copy), to_json(tree.at(i)));
+    }
+    JSONObject scalar = tree.at(0).at(0);
+    ASSERT_FALSE(scalar.pack());
+
+    // An array which has been emptied holds an empty vector rather than none
+    JSONObject emptied(JSONObjectType::ARRAY);
+    emptied.as_vector();
+    ASSERT_FALSE(emptied.pack());
+    JSONObject cleared = tree.at(0);
+    cleared.as_vector().clear();
+    ASSERT_FALSE(cleared.pack());
+    ASSERT_EQ(cleared.size(), 0);
+
+    JSONObject integers = tree.at(0);
+    ASSERT_TRUE(integers.pack());
+    ASSERT_EQ(integers.packed_type(), JSONObjectType::NUMBER_INT);
+    ASSERT_EQ(*integers.packed<int64_t>(), (std::vector<int64_t>{1, 2, 3}));
+    ASSERT_EQ(integers.packed<long double>(), nullptr);
+    ASSERT_EQ(integers.get<std::vector<int>>(), (std::vector<int>{1, 2, 3}));
+    ASSERT_FALSE(integers.try_get<std::vector<std::string>>());
+    auto usage = integers.memory_usage();
+    ASSERT_EQ(usage.packed, 3 * sizeof(int64_t));
+    ASSERT_EQ(usage.nodes, 0);
+    JSONObject cloned = integers.clone();
+    ASSERT_NE(cloned.packed<int64_t>(), integers.packed<int64_t>());
+    ASSERT_EQ(*cloned.packed<int64_t>(), *integers.packed<int64_t>());
+    ASSERT_EQ(cloned.memory_usage().total(), usage.total());
+
+    // Reading the elements builds them once, modifying them unpacks the array of that copy only
+    const JSONObject &view = integers;
+    ASSERT_EQ(view.at(1).as_integer(), 2);
+    ASSERT_EQ(&view.as_vector(), &view.as_vector());
+    JSONObject modified = integers;
+    modified.as_vector().push_back(JSONObject(int64_t(4)));
+    ASSERT_EQ(modified.packed_type(), JSONObjectType::EMPTY);
+    ASSERT_EQ(to_json(modified), "[1,2,3,4]");
+    ASSERT_EQ(to_json(integers), "[1,2,3]");
+    ASSERT_TRUE(modified.pack());
+    ASSERT_TRUE(modified != integers);
+
+    // element(), for_each_element(), the writers, the binary formats, diff() and JSONPath read a
+    // packed array in place, without building the JSONObjects of its elements
+    JSONObject document;
+    document["samples"] = tree.at(0);
+    document["samples"].pack();
+    const JSONObject &samples = document.at("samples");
+    auto &storage = std::get<std::shared_ptr<JSONPacked<int64_t>>>(samples.value);
+    auto built = [&storage] { return storage->elements.load(); };
+    ASSERT_EQ(samples.element(2).as_integer(), 3);
+    ASSERT_THROW(samples.element(3), json_access_error);
+    ASSERT_EQ(tree.at(3).element(1).as_real(), 2.5);
+    std::vector<int64_t> seen;
+    samples.for_each_element([&seen](const JSONObject &element)
+                             { seen.push_back(element.as_integer()); });
+    ASSERT_EQ(seen, (std::vector<int64_t>{1, 2, 3}));
+    ASSERT_EQ(to_json(samples), "[1,2,3]");
+    ASSERT_EQ(to_canonical_json(samples), "[1,2,3]");
+    ASSERT_TRUE(from_cbor(to_cbor(samples)) == samples);
+    ASSERT_TRUE(from_msgpack(to_msgpack(samples)) == samples);
+    ASSERT_EQ(to_json(diff(samples, tree.at(3))),
+              R"([{"op":"replace","path":"/1","value":2.5},{"op":"remove","path":"/2"}])");
+    ASSERT_EQ(JSONPath("$[?(@[1] == 2)]").select(document).size(), 1);
+    ASSERT_TRUE(JSONPath("$.samples[?(@ > 5)]").select(document).empty());
+    ASSERT_TRUE(JSONPath("$..x").select(document).empty());
+    ASSERT_EQ(built(), nullptr);
+    // The results of a query point into the tree, so selecting elements builds them
+    ASSERT_EQ(JSONPath("$.samples[1:]").select(document).size(), 2);
+    ASSERT_NE(built(), nullptr);
+
+    JSONObject reals = tree.at(1);
+    reals.pack();
+    ASSERT_EQ(reals.packed_type(), JSONObjectType::NUMBER_REAL);
+    ASSERT_EQ(reals.get<std::vector<double>>(), (std::vector<double>{1.5, 0}));
+    JSONObject zeroes = reals;
+    zeroes.as_vector()[1] = JSONObject(static_cast<long double>(0));
+    ASSERT_TRUE(zeroes == reals);
+    ASSERT_EQ(zeroes.hash(), reals.hash());
+
+    JSONObject booleans = tree.at(2);
+    booleans.pack();
+    ASSERT_EQ(*booleans.packed<bool>(), (std::vector<bool>{true, false, true}));
+    ASSERT_EQ(booleans.get<std::vector<bool>>(), (std::vector<bool>{true, false, true}));
+    ASSERT_EQ(to_json(booleans), "[true,false,true]");
+    ASSERT_TRUE(booleans != integers);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,5 +1,9 @@
+#include "json_allocations.hpp"
 #include "json_parser.hpp"
+#include "json_writer.hpp"
 #include "gtest/gtest.h"
+#include <fstream>
+#include <sstream>
 
 TEST(JSONParser, Empty)
 {
@@ -183,6 +187,298 @@ TEST(JSONParser, IntegrationTest)
     ASSERT_EQ(vals[5].as_integer(), 84);
 }
 
+TEST(JSONParser, PassFiles)
+{
+    JSONParser parser;
+    parser.set_validate_utf8(true);
+    for (int i = 1; i <= 3; i++)
+    {
+        std::string filename = "tests/json_tests/pass" + std::to_string(i) + ".json";
+        std::ifstream ifs(filename);
+        ASSERT_EQ(!ifs, 0);
+
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        ASSERT_NO_THROW(parser.parse(ss.str())) << filename;
+    }
+
+    // The escapes of pass1.json
+    auto &tree = parser.get_tree();
+    parser.parse(R"(["\u0123\u4567\u89AB\uCDEF\uabcd\uef4A", "\u0022 %22"])");
+    ASSERT_EQ(tree.at(0).as_string(), "\xC4\xA3\xE4\x95\xA7\xE8\xA6\xAB\xEC\xB7\xAF\xEA\xAF\x8D"
+                                      "\xEE\xBD\x8A");
+    ASSERT_EQ(tree.at(1).as_string(), "\" %22");
+
+    EXPECT_THROW(parser.parse("[\"\xC3\"]"), json_parse_error);
+    parser.set_validate_utf8(false);
+    ASSERT_NO_THROW(parser.parse("[\"\xC3\"]"));
+}
+
+// Returns true if parse() accepts the input when it also checks UTF-8
+static bool parses(const std::string &input, const ParseLimits &limits = ParseLimits())
+{
+    JSONParser parser(limits);
+    parser.set_validate_utf8(true);
+    try
+    {
+        parser.parse(input);
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+TEST(JSONParser, Validate)
+{
+    std::vector<std::string> inputs = {
+        "", " ", "null", " true ", "false", "nul", "nullx", "null:", "[null]", "[true,false]",
+        "0", "-", "-0", "007", "-a", "1.", "1.5", ".5", "1e5", "1e", "1e+", "1e-5", "1E+5",
+        "1e5.3", "1e.5", "1.2.3", "1e5e5", "1x", "1\"", "[1:2]", "1 2", "[1 2]",
+        "9223372036854775807", "9223372036854775808", "-9223372036854775808",
+        "-9223372036854775809", "00000000000000000000009", "1e4000", "1e5000", "1e-5000",
+        "0e99999", "0.000000000000000000001e-4940", "123456789e4920",
+        R"("")", R"("abc)", R"("a\"b")", R"("\q")", R"("é")", R"("\u00g9")",
+        R"("😁")", R"("\uD83D")", R"("\uDE01")", R"("\uD83DA")", "\"\xC3\xA9\"",
+        "\"\xC3\"", "\"\xED\xA0\x80\"", "\"line\nbreak\"", "\"tab\there\"", "\"\\",
+        "{}", "{ }", "{", "}", "[", "]", "[]", "[,]", "[1,]", "[,1]", "[1,,2]", "{\"a\"}",
+        "{\"a\":}", "{\"a\":1,}", "{\"a\":1 \"b\":2}", "{\"a\" : 1 , \"b\" : [ ] }", "{1:2}",
+        "{\"a\":1}}", "[[[]]]", "[[[]]", "[{}]", "[{]}", "{\"a\":[1,{\"b\":null}]}", "\"a\"\"b\"",
+        "[\"a\" , \"b\"]", "[true false]", "[1,2]x", "  [1]  \n", "[\"" + std::string(100, 'a'),
+        "[\"" + std::string(100, 'a') + "\\\"\"]", "{\"" + std::string(40, 'k') + "\":\"v\"}",
+        std::string(300, '[') + std::string(300, ']'),
+        std::string(300, '[') + std::string(299, ']'),
+    };
+    for (int i = 1; i <= 33; i++)
+    {
+        std::ifstream ifs("tests/json_tests/fail" + std::to_string(i) + ".json");
+        if (!ifs)
+            ifs.open("tests/json_tests/ok-fail" + std::to_string(i) + ".json");
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        inputs.push_back(ss.str());
+    }
+    for (int i = 1; i <= 3; i++)
+    {
+        std::ifstream ifs("tests/json_tests/pass" + std::to_string(i) + ".json");
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        inputs.push_back(ss.str());
+    }
+
+    JSONParser parser;
+    for (auto &input : inputs)
+        ASSERT_EQ(parser.validate(input), parses(input)) << input;
+
+    // Limits apply as they do to parse()
+    const std::string document = R"({"a": [1, [2, 3], {"b": "héllo"}], "key": -12.5e3})";
+    for (size_t value = 0; value < 20; value++)
+    {
+        for (size_t ParseLimits::*limit :
+             {&ParseLimits::max_bytes, &ParseLimits::max_depth, &ParseLimits::max_nodes,
+              &ParseLimits::max_string_length, &ParseLimits::max_number_length,
+              &ParseLimits::max_container_size})
+        {
+            ParseLimits limited;
+            limited.*limit = value;
+            parser.set_limits(limited);
+            ASSERT_EQ(parser.validate(document), parses(document, limited)) << value;
+        }
+    }
+}
+
+TEST(JSONParser, Stats)
+{
+    JSONParser parser;
+    parser.parse("{\"a\": [1, 2.5, true, null], \"b\": {\"c\": \"x\\ny\"}, \"d\": []}");
+    auto &stats = parser.stats();
+    if (!stats.enabled)
+    {
+        ASSERT_EQ(stats.token_count(Token::Type::STRING), 0);
+        GTEST_SKIP() << "Built without JSONPARSER_STATS";
+    }
+    ASSERT_EQ(stats.token_count(Token::Type::STRING), 5);
+    ASSERT_EQ(stats.token_count(Token::Type::NUMBER_INTEGER), 1);
+    ASSERT_EQ(stats.token_count(Token::Type::NUMBER_REAL), 1);
+    ASSERT_EQ(stats.token_count(Token::Type::LEFT_BRACE), 2);
+    ASSERT_EQ(stats.token_count(Token::Type::COMMA), 5);
+    ASSERT_EQ(stats.string_bytes, 18);
+    ASSERT_EQ(stats.number_bytes, 4);
+    ASSERT_EQ(stats.literal_bytes, 8);
+    ASSERT_EQ(stats.whitespace_bytes, 9);
+    ASSERT_EQ(stats.escapes, 1);
+    ASSERT_EQ(stats.max_depth, 2);
+    ASSERT_EQ(stats.objects, 2);
+    ASSERT_EQ(stats.arrays, 2);
+    ASSERT_EQ(stats.object_members, 4);
+    ASSERT_EQ(stats.array_elements, 4);
+    ASSERT_EQ(stats.max_object_size, 3);
+    ASSERT_EQ(stats.max_array_size, 4);
+    ASSERT_EQ(stats.allocations, 8);
+    ASSERT_GE(stats.total_cycles, stats.string_cycles);
+
+    // Statistics describe only the last document
+    parser.parse("[]");
+    ASSERT_EQ(parser.stats().token_count(Token::Type::STRING), 0);
+    ASSERT_EQ(parser.stats().max_depth, 1);
+}
+
+TEST(JSONParser, Deduplicate)
+{
+    std::string input = "[";
+    for (int i = 0; i < 100; i++)
+    {
+        input += i ? "," : "";
+        input += R"({"id": )" + std::to_string(i) + R"(, "address": {"city": "Springfield", )" +
+                 R"("tags": ["a", "b"]}, "flags": [true, false]})";
+    }
+    input += "]";
+
+    JSONParser plain(input);
+    JSONParser parser;
+    parser.set_deduplicate(true);
+    parser.parse(input);
+    auto &tree = parser.get_tree();
+    ASSERT_TRUE(tree == plain.get_tree());
+
+    auto &records = tree.as_vector();
+    for (auto &record : records)
+    {
+        ASSERT_EQ(&record.at("address").as_kv_pairs(), &records[0].at("address").as_kv_pairs());
+        ASSERT_EQ(&record.at("flags").as_vector(), &records[0].at("flags").as_vector());
+    }
+    ASSERT_NE(&records[0].as_kv_pairs(), &records[1].as_kv_pairs());
+
+    // Modifying one record leaves the others unchanged
+    JSONObject copy = tree;
+    copy.as_vector()[5]["address"]["city"] = JSONObject(std::string("Shelbyville"));
+    ASSERT_EQ(copy.at(5).at("address").at("city").get<std::string>(), "Shelbyville");
+    ASSERT_EQ(copy.at(6).at("address").at("city").get<std::string>(), "Springfield");
+    ASSERT_EQ(tree.at(5).at("address").at("city").get<std::string>(), "Springfield");
+
+    // Containers are only shared within a document
+    const JSONObject previous = tree;
+    parser.parse(R"({"city": "Springfield", "tags": ["a", "b"]})");
+    ASSERT_NE(&parser.get_tree().as_kv_pairs(), &previous.at(0).at("address").as_kv_pairs());
+
+    // Containers which are equal but not identical are kept apart
+    parser.parse(R"([[0.0], [-0.0], {"a": 0.0}, {"a": -0.0}, [[0.0]], [[-0.0]], [1], [1.0]])");
+    ASSERT_EQ(to_json(parser.get_tree()),
+              R"([[0.0],[-0.0],{"a":0.0},{"a":-0.0},[[0.0]],[[-0.0]],[1],[1.0]])");
+    parser.set_pack_arrays(true);
+    parser.parse("[[0.0, 1.5], [-0.0, 1.5], [0.0, 1.5]]");
+    ASSERT_EQ(to_json(parser.get_tree()), "[[0.0,1.5],[-0.0,1.5],[0.0,1.5]]");
+    ASSERT_EQ(parser.get_tree().at(0).packed<long double>(),
+              parser.get_tree().at(2).packed<long double>());
+}
+
+TEST(JSONParser, PackArrays)
+{
+    std::string input = R"({"type": "LineString", "ids": [)";
+    for (int i = 0; i < 1000; i++)
+        input += (i ? ", " : "") + std::to_string(i * 7);
+    input += R"(], "coordinates": [)";
+    for (int i = 0; i < 1000; i++)
+        input += (i ? ", [" : "[") + std::to_string(i * 0.25) + ", " + std::to_string(-i * 0.5) +
+                 "]";
+    input += "]}";
+
+    JSONParser plain(input);
+    JSONParser parser;
+    parser.set_pack_arrays(true);
+    parser.parse(input);
+    auto &tree = parser.get_tree();
+    ASSERT_TRUE(tree == plain.get_tree());
+    ASSERT_EQ(tree.hash(), plain.get_tree().hash());
+    ASSERT_EQ(to_json(tree), to_json(plain.get_tree()));
+
+    ASSERT_EQ(tree.at("ids").packed<int64_t>()->size(), 1000);
+    ASSERT_EQ(tree.at("coordinates").packed_type(), JSONObjectType::EMPTY);
+    ASSERT_EQ((*tree.at("coordinates").at(999).packed<long double>())[1], -499.5);
+
+    auto packed = tree.at("ids").memory_usage().total();
+    ASSERT_LT(packed * 7, plain.get_tree().at("ids").memory_usage().total());
+    packed = tree.at("coordinates").memory_usage().total();
+    ASSERT_LT(packed * 3, plain.get_tree().at("coordinates").memory_usage().total() * 2);
+
+    // Packed arrays are deduplicated like any other
+    parser.set_deduplicate(true);
+    parser.parse("[[1, 2], [1, 2], [1, 2.5]]");
+    auto &arrays = parser.get_tree();
+    ASSERT_EQ(arrays.at(0).packed<int64_t>(), arrays.at(1).packed<int64_t>());
+    ASSERT_EQ(arrays.at(2).packed_type(), JSONObjectType::EMPTY);
+}
+
+TEST(JSONParser, Reuse)
+{
+    std::string large = R"({"id": 1, "name": "a name longer than the small string buffer", )"
+                        R"("tags": ["x", "y", "a tag longer than the small string buffer"], )"
+                        R"("nested": {"values": [1, 2.5, [true, null, {}], []], "id": 2}, "version": 3})";
+    std::string small = R"([{"key which is long enough to allocate": [1, 2]}, "s", 7])";
+
+    JSONParser parser;
+    parser.parse(large);
+    const JSONObject first = parser.take_tree();
+    ASSERT_EQ(parser.get_tree().size(), 0);
+
+    // Once the parser has seen a document, parsing it or a smaller one only allocates the tree,
+    // which is what a clone of the tree allocates
+    for (auto &input : {large, small, large})
+    {
+        JSONParser fresh(input);
+        JSONAllocationCounter counter;
+        JSONObject expected = fresh.get_tree().clone();
+        uint64_t tree_allocations = counter.count();
+        expected = JSONObject();
+
+        counter.reset();
+        parser.parse(input);
+        ASSERT_EQ(counter.count(), tree_allocations) << input;
+        ASSERT_TRUE(parser.get_tree() == fresh.get_tree());
+        if (parser.stats().enabled)
+        {
+            ASSERT_EQ(parser.stats().allocations, tree_allocations);
+        }
+    }
+    ASSERT_EQ(parser.get_tree().at("version").get<int>(), 3);
+
+    // A document followed by anything but whitespace is rejected, and keeps the previous tree
+    ASSERT_THROW(parser.parse(R"({"a": 1} x)"), json_parse_error);
+    ASSERT_EQ(parser.get_tree().at("version").get<int>(), 3);
+
+    // A failed parse frees what it has built, only the stacks keep their capacity. The first
+    // attempt may grow them, the second one allocates nothing which outlives it
+    std::string failing = R"({"a": [1, {"key which is long enough to allocate": [2, "x"]}, 3)";
+    ASSERT_THROW(parser.parse(failing), json_parse_error);
+    {
+        JSONAllocationCounter counter;
+        ASSERT_THROW(parser.parse(failing), json_parse_error);
+        ASSERT_GT(counter.count(), 0);
+        ASSERT_EQ(counter.releases(), counter.count());
+    }
+    ParseLimits limits;
+    limits.max_depth = 3;
+    parser.set_limits(limits);
+    std::string deep = R"([{"a": ["a string longer than the small string buffer", [[1]]]}])";
+    ASSERT_THROW(parser.parse(deep), json_limit_error);
+    {
+        JSONAllocationCounter counter;
+        ASSERT_THROW(parser.parse(deep), json_limit_error);
+        ASSERT_EQ(counter.releases(), counter.count());
+    }
+    parser.set_limits(ParseLimits());
+
+    // A failed parse leaves nothing behind for the next one
+    ASSERT_THROW(parser.parse(R"({"a": [1, {"b": [2, 3)"), json_parse_error);
+    parser.parse(small);
+    ASSERT_EQ(to_json(parser.get_tree()), to_json(JSONParser(small).get_tree()));
+
+    // The tree which was taken is not affected by the following documents
+    ASSERT_EQ(first.at("name").get<std::string>(), "a name longer than the small string buffer");
+    ASSERT_EQ(first.at("nested").at("values").at(2).size(), 3);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,283 @@
+#include "json_parser.hpp"
+#include "json_patch.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+
+static JSONObject parse(const std::string &text)
+{
+    JSONParser parser(text);
+    return parser.get_tree();
+}
+
+TEST(JSONPatch, Pointer)
+{
+    std::string path;
+    json_pointer_append(path, "a/b");
+    json_pointer_append(path, "m~n");
+    json_pointer_append(path, "");
+    ASSERT_EQ(path, "/a~1b/m~0n/");
+}
+
+TEST(JSONPatch, Diff)
+{
+    struct s
+    {
+        std::string from;
+        std::string to;
+        std::string patch;
+    };
+
+    std::vector<s> inputs = {
+        {R"({"a": 1})", R"({"a": 1})", R"([])"},
+        {R"(1)", R"("x")", R"([{"op":"replace","path":"","value":"x"}])"},
+        {R"(1)", R"(1.0)", R"([{"op":"replace","path":"","value":1.0}])"},
+        {R"({"a": 1, "b": 2})", R"({"b": 3, "c": 4})",
+         R"([{"op":"remove","path":"/a"},{"op":"replace","path":"/b","value":3},)"
+         R"({"op":"add","path":"/c","value":4}])"},
+        {R"({"a/b": {"x": [1]}})", R"({"a/b": {"x": [1, 2]}})",
+         R"([{"op":"add","path":"/a~1b/x/1","value":2}])"},
+        {R"([1, 2, 3, 4])", R"([1, 3, 4])", R"([{"op":"remove","path":"/1"}])"},
+        {R"([1, 2, 3])", R"([0, 1, 2, 3])", R"([{"op":"add","path":"/0","value":0}])"},
+        {R"([1, 2, 3, 4, 5])", R"([1, 9, 3, 5, 6])",
+         R"([{"op":"replace","path":"/1","value":9},{"op":"remove","path":"/3"},)"
+         R"({"op":"add","path":"/4","value":6}])"},
+        {R"([{"id": 1, "n": "a"}, {"id": 2, "n": "b"}, {"id": 3, "n": "c"}])",
+         R"([{"id": 1, "n": "a"}, {"id": 2, "n": "B"}, {"id": 3, "n": "c"}])",
+         R"([{"op":"replace","path":"/1/n","value":"B"}])"},
+        {R"([1, 2])", R"([])",
+         R"([{"op":"remove","path":"/0"},{"op":"remove","path":"/0"}])"},
+        {R"({"a": []})", R"({"a": {}})", R"([{"op":"replace","path":"/a","value":{}}])"},
+    };
+    for (auto &input : inputs)
+        ASSERT_EQ(to_json(diff(parse(input.from), parse(input.to))), input.patch) << input.from;
+}
+
+TEST(JSONPatch, DiffCostBound)
+{
+    auto from = parse("[0, 1, 2, 3, 4, 5, 100]");
+    auto to = parse("[1, 2, 3, 4, 5, 200]");
+
+    // The common subsequence finds the removed element
+    ASSERT_EQ(to_json(diff(from, to)),
+              R"([{"op":"remove","path":"/0"},{"op":"replace","path":"/5","value":200}])");
+
+    // Without it the elements are compared index by index
+    ASSERT_EQ(to_json(diff(from, to, 41)),
+              R"([{"op":"replace","path":"/0","value":1},{"op":"replace","path":"/1","value":2},)"
+              R"({"op":"replace","path":"/2","value":3},{"op":"replace","path":"/3","value":4},)"
+              R"({"op":"replace","path":"/4","value":5},{"op":"replace","path":"/5","value":200},)"
+              R"({"op":"remove","path":"/6"}])");
+    ASSERT_EQ(diff(from, to, 42).size(), 2);
+}
+
+TEST(JSONPatch, Apply)
+{
+    struct s
+    {
+        std::string doc;
+        std::string patch;
+        std::string result;
+    };
+
+    // Examples from RFC 6902, appendix A
+    std::vector<s> inputs = {
+        {R"({"foo": "bar"})", R"([{"op": "add", "path": "/baz", "value": "qux"}])",
+         R"({"baz":"qux","foo":"bar"})"},
+        {R"({"foo": ["bar", "baz"]})", R"([{"op": "add", "path": "/foo/1", "value": "qux"}])",
+         R"({"foo":["bar","qux","baz"]})"},
+        {R"({"baz": "qux", "foo": "bar"})", R"([{"op": "remove", "path": "/baz"}])",
+         R"({"foo":"bar"})"},
+        {R"({"foo": ["bar", "qux", "baz"]})", R"([{"op": "remove", "path": "/foo/1"}])",
+         R"({"foo":["bar","baz"]})"},
+        {R"({"baz": "qux", "foo": "bar"})",
+         R"([{"op": "replace", "path": "/baz", "value": "boo"}])", R"({"baz":"boo","foo":"bar"})"},
+        {R"({"foo": {"bar": "baz", "waldo": "fred"}, "qux": {"corge": "grault"}})",
+         R"([{"op": "move", "from": "/foo/waldo", "path": "/qux/thud"}])",
+         R"({"foo":{"bar":"baz"},"qux":{"corge":"grault","thud":"fred"}})"},
+        {R"({"foo": ["all", "grass", "cows", "eat"]})",
+         R"([{"op": "move", "from": "/foo/1", "path": "/foo/3"}])",
+         R"({"foo":["all","cows","eat","grass"]})"},
+        {R"({"baz": "qux", "foo": ["a", 2, "c"]})",
+         R"([{"op": "test", "path": "/baz", "value": "qux"},
+             {"op": "test", "path": "/foo/1", "value": 2}])",
+         R"({"baz":"qux","foo":["a",2,"c"]})"},
+        {R"({"foo": "bar"})",
+         R"([{"op": "add", "path": "/child", "value": {"grandchild": {}}}])",
+         R"({"child":{"grandchild":{}},"foo":"bar"})"},
+        {R"({"foo": ["bar"]})", R"([{"op": "add", "path": "/foo/-", "value": ["abc", "def"]}])",
+         R"({"foo":["bar",["abc","def"]]})"},
+        {R"({"/": 1, "m~n": 2})",
+         R"([{"op": "copy", "from": "/~1", "path": "/m~0n"}, {"op": "add", "path": "", "value":
+             {"replaced": true}}, {"op": "replace", "path": "/replaced", "value": null}])",
+         R"({"replaced":null})"},
+    };
+    for (auto &input : inputs)
+    {
+        auto doc = parse(input.doc);
+        apply_patch(doc, parse(input.patch));
+        ASSERT_EQ(to_json(doc), input.result) << input.patch;
+    }
+}
+
+TEST(JSONPatch, Rollback)
+{
+    const std::string original =
+        R"({"a": {"b": [1, 2, 3]}, "c": "d", "e": {"f": "g"}, "list": [{"x": 1}, {"x": 2}]})";
+    std::vector<std::string> failing = {
+        R"([{"op": "test", "path": "/c", "value": "x"}])",
+        R"([{"op": "remove", "path": "/a/b/0"}, {"op": "remove", "path": "/missing"}])",
+        R"([{"op": "add", "path": "/a/b/-", "value": 4}, {"op": "add", "path": "/a/b/9",
+            "value": 5}])",
+        R"([{"op": "replace", "path": "/c", "value": 1}, {"op": "move", "from": "/e",
+            "path": "/a/b/0"}, {"op": "add", "path": "/e/h", "value": 1}])",
+        R"([{"op": "move", "from": "/e/f", "path": "/c"}, {"op": "copy", "from": "/a",
+            "path": "/list/0/y"}, {"op": "remove", "path": "/list/1"}, {"op": "bad",
+            "path": ""}])",
+        R"([{"op": "add", "path": "", "value": 1}, {"op": "add", "path": "/x", "value": 1}])",
+        R"([{"op": "move", "from": "/a", "path": "/a/b/1"}])",
+        R"([{"op": "remove", "path": "/list/01"}])",
+        R"([{"op": "add", "path": "a", "value": 1}])",
+        R"([{"op": "add", "path": "/~2", "value": 1}])",
+        R"([{"op": "add", "path": "/a/b/0"}])",
+        R"([{"op": "remove", "path": ""}])",
+        R"({"op": "remove", "path": "/a"})",
+    };
+    auto expected = parse(original);
+    for (auto &patch : failing)
+    {
+        auto doc = parse(original);
+        ASSERT_THROW(apply_patch(doc, parse(patch)), json_patch_error) << patch;
+        ASSERT_TRUE(doc == expected) << patch << " " << to_json(doc);
+    }
+
+    // The index of the failing operation counts across a batch
+    auto doc = parse(original);
+    try
+    {
+        apply_patches(doc, {parse(R"([{"op": "remove", "path": "/c"}])"),
+                            parse(R"([{"op": "add", "path": "/c", "value": 1},
+                                      {"op": "remove", "path": "/c/d"}])")});
+        FAIL() << "Expected json_patch_error";
+    }
+    catch (const json_patch_error &e)
+    {
+        ASSERT_EQ(e.operation(), 2);
+    }
+    ASSERT_TRUE(doc == expected);
+
+    apply_patches(doc, {parse(R"([{"op": "remove", "path": "/c"}])"),
+                        parse(R"([{"op": "add", "path": "/c", "value": 1}])")});
+    ASSERT_EQ(doc.at("c").get<int>(), 1);
+}
+
+TEST(JSONPatch, RollbackMove)
+{
+    // A move into an ancestor of from or onto the whole document replaces the value it came from
+    const std::string original = R"({"a": {"b": 1, "c": 2}, "d": [1, 2]})";
+    std::vector<std::string> failing = {
+        R"([{"op": "move", "from": "/a/b", "path": "/a"}, {"op": "test", "path": "/zz",
+            "value": 1}])",
+        R"([{"op": "move", "from": "/a", "path": ""}, {"op": "test", "path": "/zz", "value": 1}])",
+        R"([{"op": "move", "from": "/d/1", "path": ""}, {"op": "remove", "path": "/zz"}])",
+        R"([{"op": "move", "from": "/d/0", "path": "/d/1"}, {"op": "move", "from": "/a/c",
+            "path": "/d"}, {"op": "move", "from": "/a", "path": ""}, {"op": "bad", "path": ""}])",
+    };
+    auto expected = parse(original);
+    for (auto &patch : failing)
+    {
+        auto doc = parse(original);
+        try
+        {
+            apply_patch(doc, parse(patch));
+            FAIL() << "Expected json_patch_error for " << patch;
+        }
+        catch (const json_patch_error &e)
+        {
+            // The error is the one of the failing operation, not one raised by the rollback
+            ASSERT_NE(e.operation(), 0) << patch << " " << e.what();
+        }
+        ASSERT_TRUE(doc == expected) << patch << " " << to_json(doc);
+    }
+}
+
+TEST(JSONPatch, MoveKeepsSubtree)
+{
+    auto doc = parse(R"({"a": {"big": [1, 2, 3]}, "b": {}})");
+    auto storage = &doc.at("a").at("big").as_vector();
+    apply_patch(doc, parse(R"([{"op": "move", "from": "/a/big", "path": "/b/big"}])"));
+    ASSERT_EQ(&doc.at("b").at("big").as_vector(), storage);
+    ASSERT_FALSE(doc.at("a").contains("big"));
+}
+
+TEST(JSONPatch, DiffRoundTrip)
+{
+    std::vector<std::string> documents = {
+        R"({"a": 1, "b": [1, 2, 3], "c": {"d": "e"}})",
+        R"({"a": 2, "b": [3, 1, 2, 4], "c": {"d": "f", "g": null}})",
+        R"({"b": [], "c": [1, {"x": 1}], "h/i": "~"})",
+        R"([{"id": 1}, {"id": 2}, {"id": 3}, {"id": 4}, 5, 6, 7])",
+        R"([{"id": 2}, 7, {"id": 4, "n": 1}, 6, 5, {"id": 1}])",
+        R"([[1, 2], [3], [], [4, [5, 6]]])",
+        R"("text")",
+    };
+    for (auto &from : documents)
+    {
+        for (auto &to : documents)
+        {
+            for (size_t cost : {size_t(0), size_t(1) << 20})
+            {
+                auto doc = parse(from);
+                auto target = parse(to);
+                apply_patch(doc, diff(doc, target, cost));
+                ASSERT_TRUE(doc == target) << from << " -> " << to;
+            }
+        }
+    }
+}
+
+TEST(JSONPatch, MergePatch)
+{
+    struct s
+    {
+        std::string doc;
+        std::string patch;
+        std::string result;
+    };
+
+    // Examples from RFC 7386, appendix A
+    std::vector<s> inputs = {
+        {R"({"a":"b"})", R"({"a":"c"})", R"({"a":"c"})"},
+        {R"({"a":"b"})", R"({"b":"c"})", R"({"a":"b","b":"c"})"},
+        {R"({"a":"b"})", R"({"a":null})", R"({})"},
+        {R"({"a":"b","b":"c"})", R"({"a":null})", R"({"b":"c"})"},
+        {R"({"a":["b"]})", R"({"a":"c"})", R"({"a":"c"})"},
+        {R"({"a":"c"})", R"({"a":["b"]})", R"({"a":["b"]})"},
+        {R"({"a":{"b":"c"}})", R"({"a":{"b":"d","c":null}})", R"({"a":{"b":"d"}})"},
+        {R"({"a":[{"b":"c"}]})", R"({"a":[1]})", R"({"a":[1]})"},
+        {R"(["a","b"])", R"(["c","d"])", R"(["c","d"])"},
+        {R"({"a":"b"})", R"(["c"])", R"(["c"])"},
+        {R"({"a":"foo"})", R"(null)", R"(null)"},
+        {R"({"a":"foo"})", R"("bar")", R"("bar")"},
+        {R"({"e":null})", R"({"a":1})", R"({"a":1,"e":null})"},
+        {R"([1,2])", R"({"a":"b","c":null})", R"({"a":"b"})"},
+        {R"({})", R"({"a":{"bb":{"ccc":null}}})", R"({"a":{"bb":{}}})"},
+    };
+    for (auto &input : inputs)
+    {
+        auto doc = parse(input.doc);
+        apply_merge_patch(doc, parse(input.patch));
+        ASSERT_EQ(to_json(doc), input.result) << input.patch;
+    }
+
+    // The patch is not modified, and the document shares its values
+    auto patch = parse(R"({"a": {"b": [1, 2]}})");
+    auto doc = parse("{}");
+    apply_merge_patch(doc, patch);
+    ASSERT_EQ(&doc.at("a").at("b").as_vector(), &patch.at("a").at("b").as_vector());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,177 @@
+#include "json_parser.hpp"
+#include "json_path.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+
+static const std::string store = R"({"store": {
+    "book": [
+        {"category": "reference", "author": "Nigel Rees", "title": "Sayings of the Century",
+         "price": 8.95},
+        {"category": "fiction", "author": "Evelyn Waugh", "title": "Sword of Honour",
+         "price": 12.99},
+        {"category": "fiction", "author": "Herman Melville", "title": "Moby Dick",
+         "isbn": "0-553-21311-3", "price": 8.99},
+        {"category": "fiction", "author": "J. R. R. Tolkien", "title": "The Lord of the Rings",
+         "isbn": "0-395-19395-8", "price": 22}
+    ],
+    "bicycle": {"color": "red", "price": 19.95}
+}, "expensive": 10, "odd \"key\"": [1, 2]})";
+
+// Runs a query over the tree and over the text, and checks that both find the same values
+static std::vector<std::string> query(const std::string &expression, const std::string &document)
+{
+    JSONPath path(expression);
+    JSONParser parser(document);
+    std::vector<std::string> from_tree;
+    for (auto value : path.select(parser.get_tree()))
+        from_tree.push_back(to_json(*value));
+    std::vector<std::string> from_text;
+    for (auto &value : path.select_text(document))
+        from_text.push_back(to_json(value));
+
+    auto sorted_tree = from_tree;
+    std::sort(sorted_tree.begin(), sorted_tree.end());
+    std::sort(from_text.begin(), from_text.end());
+    EXPECT_EQ(sorted_tree, from_text) << expression;
+    return from_tree;
+}
+
+TEST(JSONPath, Select)
+{
+    struct s
+    {
+        std::string expression;
+        std::vector<std::string> values;
+    };
+
+    std::vector<s> inputs = {
+        {"$", {to_json(JSONParser(store).get_tree())}},
+        {"$.expensive", {"10"}},
+        {"$.store.bicycle.color", {"\"red\""}},
+        {"$['store']['bicycle']['color']", {"\"red\""}},
+        {R"($["odd \"key\""][1])", {"2"}},
+        {"$.store.book[*].author",
+         {"\"Nigel Rees\"", "\"Evelyn Waugh\"", "\"Herman Melville\"", "\"J. R. R. Tolkien\""}},
+        {"$..author",
+         {"\"Nigel Rees\"", "\"Evelyn Waugh\"", "\"Herman Melville\"", "\"J. R. R. Tolkien\""}},
+        {"$.store.*.color", {"\"red\""}},
+        {"$.store..price", {"19.95", "8.95", "12.99", "8.99", "22"}},
+        {"$..book[2].title", {"\"Moby Dick\""}},
+        {"$..book[-1].title", {"\"The Lord of the Rings\""}},
+        {"$..book[0,1].title", {"\"Sayings of the Century\"", "\"Sword of Honour\""}},
+        {"$..book[:2].price", {"8.95", "12.99"}},
+        {"$..book[1:].price", {"12.99", "8.99", "22"}},
+        {"$..book[::2].price", {"8.95", "8.99"}},
+        {"$..book[-2:].price", {"8.99", "22"}},
+        {"$..book[5]", {}},
+        {"$..book[?(@.isbn)].title", {"\"Moby Dick\"", "\"The Lord of the Rings\""}},
+        {"$..book[?(@.price < 10)].title", {"\"Sayings of the Century\"", "\"Moby Dick\""}},
+        {"$..book[?(@.price >= 12.99 && @.category == 'fiction')].price", {"12.99", "22"}},
+        {"$..book[?(@.price == 22)].author", {"\"J. R. R. Tolkien\""}},
+        {"$..book[?(!(@.category == \"fiction\") || @.author == 'Evelyn Waugh')].price",
+         {"8.95", "12.99"}},
+        {"$..book[?(@.missing != 1)].price", {"8.95", "12.99", "8.99", "22"}},
+        {"$..book[?(@.missing < 1)]", {}},
+        {"$..book[?(@.title > 'S')].price", {"8.95", "12.99", "22"}},
+        {"$.store.bicycle[?(@ == 'red')]", {"\"red\""}},
+        {"$['odd \"key\"'][?(@ > 1)]", {"2"}},
+        {"$.store.book[?(@.author == 'Nigel Rees')]['title', 'price']",
+         {"8.95", "\"Sayings of the Century\""}},
+        {"$..*[?(@.color)].price", {"19.95"}},
+    };
+    for (auto &input : inputs)
+    {
+        auto values = query(input.expression, store);
+        std::sort(values.begin(), values.end());
+        auto expected = input.values;
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(values, expected) << input.expression;
+    }
+
+    JSONPath descendants("$..*");
+    ASSERT_EQ(descendants.select(JSONParser(store).get_tree()).size(), 31);
+    ASSERT_EQ(descendants.select_text(store).size(), 31);
+}
+
+TEST(JSONPath, Unions)
+{
+    // A union selects each member or element once, in the order of the container
+    struct s
+    {
+        std::string expression;
+        std::string document;
+        std::vector<std::string> values;
+    };
+
+    std::vector<s> inputs = {
+        {"$[0,-1,0]", "[3]", {"3"}},
+        {"$[2,0,-1,-3]", "[1, 2, 3]", {"1", "3"}},
+        {"$['a','a']", R"({"a": 1})", {"1"}},
+        {"$['b','a','b']", R"({"a": 1, "b": 2})", {"1", "2"}},
+        {"$..['a','b','a']", R"({"a": {"b": 2}})", {R"({"b":2})", "2"}},
+    };
+    for (auto &input : inputs)
+    {
+        JSONPath path(input.expression);
+        JSONParser parser(input.document);
+        std::vector<std::string> from_tree;
+        for (auto value : path.select(parser.get_tree()))
+            from_tree.push_back(to_json(*value));
+        std::vector<std::string> from_text;
+        for (auto &value : path.select_text(input.document))
+            from_text.push_back(to_json(value));
+        ASSERT_EQ(from_tree, input.values) << input.expression;
+        ASSERT_EQ(from_text, input.values) << input.expression;
+    }
+}
+
+TEST(JSONPath, SkipsUnmatched)
+{
+    // Only the matched values are parsed, so a query over a large document touches little of it
+    JSONPath path("$.wanted");
+    auto values =
+        path.select_text(R"({"skipped": [{"a": "]}\"[{"}, 1e5, null], "wanted": {"x": 1}})");
+    ASSERT_EQ(values.size(), 1);
+    ASSERT_EQ(to_json(values[0]), R"({"x":1})");
+
+    // Errors in matched values are reported with their offset in the document
+    try
+    {
+        path.select_text(R"({"other": 1, "wanted": [1, 2,]})");
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 29);
+    }
+    ASSERT_THROW(path.select_text(R"({"wanted": [1, 2)"), json_parse_error);
+}
+
+TEST(JSONPath, CompileErrors)
+{
+    std::vector<std::string> invalid = {
+        "",        "store",   "$.",      "$[",      "$['a'",    "$[1:2:0]",         "$[?(@.a ==)]",
+        "$[?(1)]", "$[?(@.a", "$..",     "$.a b",   "$['a]",    "$[?(@.a > [1])]",  "$[a]",
+        "$[?(@.a == tru)]",
+    };
+    for (auto &expression : invalid)
+        ASSERT_THROW(JSONPath{expression}, json_parse_error) << expression;
+
+    try
+    {
+        JSONPath path("$.store[?(@.a == )]");
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 17);
+    }
+    ASSERT_EQ(JSONPath("$.a").expression(), "$.a");
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,303 @@
+#include "json_canonical.hpp"
+#include "json_parser.hpp"
+#include "json_writer.hpp"
+#include "gtest/gtest.h"
+#include <fstream>
+#include <sstream>
+
+TEST(JSONWriter, Minify)
+{
+    struct s
+    {
+        std::string input;
+        std::string minified;
+    };
+
+    std::vector<s> inputs = {
+        {" null ", "null"},
+        {"[ 1 , 2.50 , -0e5 , 007 ]", "[1,2.50,-0e5,007]"},
+        {"{ \"a b\" : \"c \\\" d\" ,\n\t\"e\" : [ ] , \"f\" : { } }",
+         "{\"a b\":\"c \\\" d\",\"e\":[],\"f\":{}}"},
+        {"[\"\\u00e9 \xC3\xA9\", true, false]", "[\"\\u00e9 \xC3\xA9\",true,false]"},
+        {"[[[ ]], {\"x\": [{}]}]", "[[[]],{\"x\":[{}]}]"},
+    };
+    for (auto &input : inputs)
+    {
+        std::string out = "prefix ";
+        minify(input.input, out);
+        ASSERT_EQ(out, "prefix " + input.minified);
+    }
+}
+
+TEST(JSONWriter, Prettify)
+{
+    std::string out;
+    prettify(R"({"a": 1, "b": [true, {"c": null}, [], {}], "d": {"e": "f"}})", out, 2);
+    ASSERT_EQ(out, "{\n"
+                   "  \"a\": 1,\n"
+                   "  \"b\": [\n"
+                   "    true,\n"
+                   "    {\n"
+                   "      \"c\": null\n"
+                   "    },\n"
+                   "    [],\n"
+                   "    {}\n"
+                   "  ],\n"
+                   "  \"d\": {\n"
+                   "    \"e\": \"f\"\n"
+                   "  }\n"
+                   "}");
+
+    out.clear();
+    prettify("[1,[2]]", out, 0);
+    ASSERT_EQ(out, "[\n1,\n[\n2\n]\n]");
+
+    out.clear();
+    prettify(" \"scalar\" ", out);
+    ASSERT_EQ(out, "\"scalar\"");
+}
+
+TEST(JSONWriter, ReformatKeepsValues)
+{
+    for (int i = 1; i <= 3; i++)
+    {
+        std::ifstream ifs("tests/json_tests/pass" + std::to_string(i) + ".json");
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        auto expected = to_json(JSONParser(ss.str()).get_tree());
+
+        std::string minified;
+        minify(ss.str(), minified);
+        ASSERT_EQ(to_json(JSONParser(minified).get_tree()), expected);
+
+        std::string pretty;
+        prettify(ss.str(), pretty);
+        ASSERT_EQ(to_json(JSONParser(pretty).get_tree()), expected);
+
+        // Minifying the prettified text gives the same text as minifying the input
+        std::string again;
+        minify(pretty, again);
+        ASSERT_EQ(again, minified);
+
+        std::ostringstream stream;
+        prettify(ss.str(), stream);
+        ASSERT_EQ(stream.str(), pretty);
+    }
+
+    // Output larger than the blocks written to streams
+    std::string large = "[";
+    for (int i = 0; i < 20000; i++)
+        large += (i ? ", " : "") + std::to_string(i);
+    large += "]";
+    std::string minified;
+    minify(large, minified);
+    std::ostringstream stream;
+    minify(large, stream);
+    ASSERT_EQ(stream.str(), minified);
+    ASSERT_EQ(minified.size(), large.size() - 19999);
+}
+
+// Keeps what is written to it, and the size of the largest single write
+class RecordingBuffer : public std::streambuf
+{
+  public:
+    std::string data;
+    size_t largest = 0;
+
+  protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        data.append(s, static_cast<size_t>(n));
+        largest = std::max(largest, static_cast<size_t>(n));
+        return n;
+    }
+
+    int overflow(int c) override
+    {
+        if (c != traits_type::eof())
+            data.push_back(static_cast<char>(c));
+        return c;
+    }
+};
+
+TEST(JSONWriter, ReformatStreamsBlocks)
+{
+    // Containers and keys only, with no scalar in between
+    std::string arrays = "[";
+    std::string objects = "{";
+    for (int i = 0; i < 50000; i++)
+    {
+        arrays += i ? ", [[], {}]" : "[[], {}]";
+        objects += (i ? ", \"" : "\"") + std::to_string(i) + "\": {\"a\": {}}";
+    }
+    arrays += "]";
+    objects += "}";
+    for (auto &input : {arrays, objects})
+    {
+        for (bool pretty : {false, true})
+        {
+            std::string expected;
+            RecordingBuffer buffer;
+            std::ostream stream(&buffer);
+            if (pretty)
+            {
+                prettify(input, expected);
+                prettify(input, stream);
+            }
+            else
+            {
+                minify(input, expected);
+                minify(input, stream);
+            }
+            ASSERT_EQ(buffer.data, expected);
+            ASSERT_GT(expected.size(), 4 * 65536);
+            ASSERT_LE(buffer.largest, 65536 + 64);
+        }
+    }
+}
+
+TEST(JSONWriter, ReformatErrors)
+{
+    std::vector<std::string> invalid = {"", "[1,]", "{\"a\" 1}", "[1 2]", "nul", "[\"\\q\"]",
+                                        "{\"a\": [}", "1e", "[1] 2"};
+    for (auto &input : invalid)
+    {
+        std::string out = "kept";
+        EXPECT_THROW(minify(input, out), json_parse_error) << input;
+        ASSERT_EQ(out, "kept");
+        EXPECT_THROW(prettify(input, out), json_parse_error) << input;
+        ASSERT_EQ(out, "kept");
+    }
+
+    try
+    {
+        std::string out;
+        minify("{\"a\": [1, 2,, 3]}", out);
+        FAIL() << "Expected json_parse_error";
+    }
+    catch (const json_parse_error &e)
+    {
+        ASSERT_EQ(e.offset(), 12);
+        ASSERT_NE(e.excerpt().find("2,, 3"), std::string::npos);
+    }
+}
+
+TEST(JSONWriter, Canonical)
+{
+    JSONParser parser;
+    // Example from RFC 8785, section 3.2.3
+    parser.parse(R"({
+        "numbers": [333333333.33333329, 1E30, 4.50, 2e-3, 0.000000000000000000000000001],
+        "string": "\u20ac$\u000F\u000aA'\u0042\u0022\u005c\\\"\/",
+        "literals": [null, true, false]
+    })");
+    ASSERT_EQ(to_canonical_json(parser.get_tree()),
+              R"({"literals":[null,true,false],)"
+              R"("numbers":[333333333.3333333,1e+30,4.5,0.002,1e-27],)"
+              R"("string":")"
+              "\xE2\x82\xAC"
+              R"($\u000f\nA'B\"\\\\\"/"})");
+
+    // Keys are sorted by UTF-16 code units, which differs from UTF-8 order from U+E000 upwards
+    parser.parse(R"({"€": "euro", "\r": "cr", "דּ": "dalet", "1": "one",
+                     "😀": "emoji", "\u0080": "control", "ö": "o"})");
+    auto text = to_canonical_json(parser.get_tree());
+    std::vector<std::string> order = {"cr", "one", "control", "o", "euro", "emoji", "dalet"};
+    size_t position = 0;
+    for (auto &value : order)
+    {
+        auto found = text.find("\"" + value + "\"");
+        ASSERT_NE(found, std::string::npos) << value;
+        ASSERT_GT(found, position) << value;
+        position = found;
+    }
+
+    parser.parse(R"({"b": {"z": 1, "y": [{}, []]}, "a": "x", "": 0})");
+    ASSERT_EQ(to_canonical_json(parser.get_tree()), R"({"":0,"a":"x","b":{"y":[{},[]],"z":1}})");
+}
+
+TEST(JSONWriter, CanonicalNumbers)
+{
+    struct s
+    {
+        double value;
+        std::string text;
+    };
+
+    // Test vectors from RFC 8785, appendix B, and the boundaries of the ECMAScript formats
+    std::vector<s> inputs = {
+        {0.0, "0"},
+        {-0.0, "0"},
+        {5e-324, "5e-324"},
+        {-5e-324, "-5e-324"},
+        {1.7976931348623157e+308, "1.7976931348623157e+308"},
+        {9007199254740992.0, "9007199254740992"},
+        {9007199254740994.0, "9007199254740994"},
+        {295147905179352830000.0, "295147905179352830000"},
+        {1e+21, "1e+21"},
+        {1e+23, "1e+23"},
+        {100000000000000000000.0, "100000000000000000000"},
+        {0.000001, "0.000001"},
+        {1e-7, "1e-7"},
+        {4.5, "4.5"},
+        {-1.5e-9, "-1.5e-9"},
+        {123.456, "123.456"},
+    };
+    for (auto &input : inputs)
+    {
+        std::string out;
+        json_write_es_number(out, input.value);
+        ASSERT_EQ(out, input.text);
+    }
+
+    std::string out;
+    ASSERT_THROW(json_write_es_number(out, std::numeric_limits<double>::infinity()),
+                 json_access_error);
+    ASSERT_THROW(json_write_es_number(out, std::numeric_limits<double>::quiet_NaN()),
+                 json_access_error);
+
+    // Integers are written as the double nearest to them
+    ASSERT_EQ(to_canonical_json(JSONObject(static_cast<int64_t>(9007199254740993))),
+              "9007199254740992");
+    ASSERT_EQ(to_canonical_json(JSONObject(static_cast<int64_t>(-42))), "-42");
+}
+
+TEST(JSONWriter, CanonicalSink)
+{
+    JSONObject ob(JSONObjectType::ARRAY);
+    for (int64_t i = 0; i < 5000; i++)
+    {
+        JSONObject element;
+        element["value"] = JSONObject(i);
+        element["name"] = JSONObject(std::string("element ") + std::to_string(i));
+        ob.as_vector().push_back(element);
+    }
+    auto expected = to_canonical_json(ob);
+
+    // Hashes the output as it is produced, which must match hashing the whole text
+    auto fnv1a = [](uint64_t hash, const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ULL;
+        return hash;
+    };
+    std::string text;
+    size_t blocks = 0;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    json_write_canonical(ob,
+                         [&](const char *data, size_t size)
+                         {
+                             text.append(data, size);
+                             hash = fnv1a(hash, data, size);
+                             blocks++;
+                         });
+    ASSERT_EQ(text, expected);
+    ASSERT_EQ(hash, fnv1a(0xCBF29CE484222325ULL, expected.data(), expected.size()));
+    ASSERT_GT(blocks, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}